@@ -1,3 +1,5 @@
+#include <vector>
+#include <cstring>
 #include <stdint.h>
 #include <xs/lib.h>
 #include <panda/lib.h>
@@ -6,6 +8,17 @@
 using namespace panda::lib;
 using namespace xs::lib;
 
+static merge_plan* _merge_plan (SV* self) {
+    if (!sv_isobject(self) || !sv_derived_from(self, "Panda::Lib::MergePlan")) croak("Panda::Lib::MergePlan: invalid object");
+    return INT2PTR(merge_plan*, SvIV(SvRV(self)));
+}
+
+// integer value of <sv> (as perl sees it) in decimal
+static inline char* _sv2dec (SV* sv, char* buf) {
+    IV val = SvIV(sv);
+    return SvIsUV(sv) ? utoa((UV)val, buf) : itoa(val, buf);
+}
+
 MODULE = Panda::Lib                PACKAGE = Panda::Lib
 PROTOTYPES: DISABLE
 
@@ -21,14 +34,90 @@ uint32_t string_hash32 (SV* source) {
     RETVAL = string_hash32(str, len);
 }
 
-SV* crypt_xor (SV* source_string, SV* key_string) {
+uint64_t hash64 (SV* source, uint64_t seed = 0) {
+    STRLEN len;
+    const char* str = SvPV(source, len);
+    RETVAL = hash64(str, len, seed);
+}
+
+SV* hash64_batch (AV* strings, uint64_t seed = 0) {
+    const size_t CHUNK = 64;
+    const char* strs[CHUNK];
+    size_t      lens[CHUNK];
+    size_t cnt = av_len(strings) + 1;
+    RETVAL = newSV(cnt * sizeof(uint64_t) + 1);
+    SvPOK_on(RETVAL);
+    SvCUR_set(RETVAL, cnt * sizeof(uint64_t));
+    *SvEND(RETVAL) = 0;
+    uint64_t* dest = (uint64_t*)SvPVX(RETVAL);
+    for (size_t i = 0; i < cnt; i += CHUNK) {
+        size_t n = cnt - i < CHUNK ? cnt - i : CHUNK;
+        for (size_t j = 0; j < n; ++j) {
+            SV** elem = av_fetch(strings, i + j, 0);
+            STRLEN len = 0;
+            strs[j] = elem ? SvPV(*elem, len) : "";
+            lens[j] = len;
+        }
+        hash64(strs, lens, n, dest + i, seed);
+    }
+}
+
+SV* crypt_xor (SV* source_string, SV* key_string, size_t koff = 0) {
     STRLEN slen, klen;
     char* str = SvPV(source_string, slen);
     char* key = SvPV(key_string, klen);
     RETVAL = newSV(slen+1);
     SvPOK_on(RETVAL);
     SvCUR_set(RETVAL, slen);
-    crypt_xor(str, slen, key, klen, SvPVX(RETVAL));
+    crypt_xor(str, SvPVX(RETVAL), slen, key, klen, koff);
+    *SvEND(RETVAL) = 0;
+}
+
+size_t crypt_xor_inplace (SV* string, SV* key_string, size_t koff = 0) {
+    STRLEN slen, klen;
+    char* str = SvPV_force(string, slen); // detach from shared (COW) buffer
+    char* key = SvPV(key_string, klen);
+    RETVAL = crypt_xor(str, str, slen, key, klen, koff);
+    SvSETMAGIC(string);
+}
+
+bool is_ascii (SV* string) {
+    STRLEN len;
+    const char* str = SvPV(string, len);
+    RETVAL = is_ascii(str, len);
+}
+
+bool utf8_validate (SV* string) {
+    STRLEN len;
+    const char* str = SvPV(string, len);
+    RETVAL = utf8_validate(str, len);
+}
+
+size_t utf8_length (SV* string) {
+    STRLEN len;
+    const char* str = SvPV(string, len);
+    RETVAL = (panda::lib::utf8_length)(str, len);
+}
+
+void timeout (SV* sub, double timeout = 0) {
+    if (!timeout) timeout = 1;
+    deadline_stack& deadlines = deadline_stack::instance();
+    deadlines.push(timeout <= 0 ? 0 : timeout < 1e9 ? uint64_t(timeout * 1e9) : deadline_stack::NONE);
+    PUSHMARK(SP);
+    PUTBACK;
+    call_sv(sub, G_VOID | G_DISCARD | G_EVAL);
+    SPAGAIN;
+    if (deadlines.pop() && SvTRUE(ERRSV)) XSRETURN_EMPTY; // our deadline: swallow, errors for outer ones are rethrown
+    if (SvTRUE(ERRSV)) croak(NULL);
+    XSRETURN_IV(1);
+}
+
+void _on_deadline (...) {
+    if (deadline_stack::instance().fire()) croak("Panda::Lib::timeout: deadline exceeded\n");
+}
+
+const char* _deadline_signal () {
+    RETVAL = PL_sig_name[deadline_stack::signo];
 }
 
 SV* hash_merge (HV* dest, HV* source, int flags = 0) {
@@ -45,14 +134,140 @@ SV* merge (SV* dest, SV* source, int flags = 0) {
     if (RETVAL == dest) SvREFCNT_inc_simple_void_NN(RETVAL);
 }
 
-SV* clone (SV* source) : ALIAS(fclone = 1) {
-    RETVAL = clone(source, ix == 1 ? true : false);
+SV* hash_merge_many (HV* dest, AV* sources, int flags = 0) {
+    SSize_t cnt = av_len(sources) + 1;
+    std::vector<HV*> hvs;
+    hvs.reserve(cnt);
+    for (SSize_t i = 0; i < cnt; ++i) {
+        SV** elem = av_fetch(sources, i, 0);
+        if (!elem || !SvOK(*elem)) continue;
+        if (!SvROK(*elem) || SvTYPE(SvRV(*elem)) != SVt_PVHV) croak("hash_merge_many: sources must be hash references");
+        hvs.push_back((HV*)SvRV(*elem));
+    }
+    HV* result = hash_merge(dest, hvs.empty() ? NULL : &hvs[0], hvs.size(), flags);
+    if (result == dest) { // hash not changed - return the same RV for speed
+        RETVAL = ST(0);
+        SvREFCNT_inc_simple_void_NN(RETVAL);
+    }
+    else RETVAL = newRV_noinc((SV*)result);
+}
+
+SV* merge_many (SV* dest, AV* sources, int flags = 0) {
+    SSize_t cnt = av_len(sources) + 1;
+    std::vector<SV*> svs(cnt > 0 ? cnt : 1);
+    for (SSize_t i = 0; i < cnt; ++i) {
+        SV** elem = av_fetch(sources, i, 0);
+        svs[i] = elem ? *elem : NULL;
+    }
+    RETVAL = merge(dest, &svs[0], cnt, flags);
+    if (RETVAL == dest) SvREFCNT_inc_simple_void_NN(RETVAL);
+}
+
+SV* clone (SV* source, int flags = 0) : ALIAS(fclone = 1) {
+    RETVAL = clone(source, ix == 1 ? flags | CLONE_CROSS : flags);
+}
+
+void clone_many (AV* sources, int flags = 0) : ALIAS(fclone_many = 1) {
+    if (ix == 1) flags |= CLONE_CROSS;
+    SSize_t cnt = av_len(sources) + 1;
+    if (cnt <= 0) XSRETURN_EMPTY;
+    std::vector<SV*> svs(cnt * 2);
+    for (SSize_t i = 0; i < cnt; ++i) {
+        SV** elem = av_fetch(sources, i, 0);
+        svs[i] = elem ? *elem : &PL_sv_undef;
+    }
+    clone(&svs[0], cnt, &svs[cnt], flags);
+    EXTEND(SP, cnt);
+    for (SSize_t i = 0; i < cnt; ++i) mPUSHs(svs[cnt + i]);
+}
+
+void clone_times (SV* source, size_t count, int flags = 0) : ALIAS(fclone_times = 1) {
+    if (ix == 1) flags |= CLONE_CROSS;
+    if (!count) XSRETURN_EMPTY;
+    std::vector<SV*> svs(count);
+    clone(source, count, &svs[0], flags);
+    EXTEND(SP, (SSize_t)count);
+    for (size_t i = 0; i < count; ++i) mPUSHs(svs[i]);
 }
 
 bool compare (SV* first, SV* second) {
     RETVAL = sv_compare(first, second);
 }
 
-char* itoa (IV i) {
-    RETVAL = itoa(i);
-}
\ No newline at end of file
+uint64_t fingerprint (SV* data) {
+    RETVAL = sv_fingerprint(data);
+}
+
+void encode_utf8_struct (SV* data) {
+    encode_utf8_struct(data);
+}
+
+void decode_utf8_struct (SV* data) {
+    decode_utf8_struct(data);
+}
+
+SV* itoa (SV* value) {
+    char buf[MAX_INT_CHARS];
+    RETVAL = newSVpvn(buf, _sv2dec(value, buf) - buf);
+}
+
+SV* itoa_batch (AV* numbers) {
+    char buf[MAX_INT_CHARS];
+    size_t cnt = av_len(numbers) + 1;
+    AV* list = newAV();
+    av_extend(list, cnt);
+    for (size_t i = 0; i < cnt; ++i) {
+        SV** elem = av_fetch(numbers, i, 0);
+        av_push(list, elem ? newSVpvn(buf, _sv2dec(*elem, buf) - buf) : newSVpvs("0"));
+    }
+    RETVAL = newRV_noinc((SV*)list);
+}
+
+SV* itoa_join (AV* numbers, SV* separator = NULL) {
+    STRLEN slen = 1;
+    const char* sep = separator ? SvPV(separator, slen) : ",";
+    size_t cnt = av_len(numbers) + 1;
+    RETVAL = newSV(cnt * (MAX_INT_CHARS + slen) + 1);
+    SvPOK_on(RETVAL);
+    char* p = SvPVX(RETVAL);
+    for (size_t i = 0; i < cnt; ++i) {
+        if (i) {
+            std::memcpy(p, sep, slen);
+            p += slen;
+        }
+        SV** elem = av_fetch(numbers, i, 0);
+        if (elem) p = _sv2dec(*elem, p);
+        else *p++ = '0';
+    }
+    *p = 0;
+    SvCUR_set(RETVAL, p - SvPVX(RETVAL));
+    if (SvLEN(RETVAL) > 2 * SvCUR(RETVAL) + 16) SvPV_shrink_to_cur(RETVAL);
+    if (separator && SvUTF8(separator)) SvUTF8_on(RETVAL);
+}
+
+SV* atoi (SV* string) {
+    STRLEN len;
+    const char* str = SvPV(string, len);
+    int64_t ival;
+    uint64_t uval;
+    if (atoi(str, len, ival) == str + len) RETVAL = newSViv(ival);
+    else if (atou(str, len, uval) == str + len) RETVAL = newSVuv(uval);
+    else XSRETURN_UNDEF;
+}
+
+
+MODULE = Panda::Lib                PACKAGE = Panda::Lib::MergePlan
+PROTOTYPES: DISABLE
+
+SV* new (const char* CLASS, HV* tmpl, int flags = 0) {
+    RETVAL = sv_setref_pv(newSV(0), CLASS, new merge_plan(tmpl, flags));
+}
+
+SV* merge (SV* self, HV* source = NULL) {
+    RETVAL = newRV_noinc((SV*)_merge_plan(self)->merge(source));
+}
+
+void DESTROY (SV* self) {
+    delete _merge_plan(self);
+}
+
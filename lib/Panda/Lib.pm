@@ -1,8 +1,6 @@
 package Panda::Lib;
 use parent 'Panda::Export';
 use 5.012;
-use Encode();
-use Time::HiRes();
 
 =head1 NAME
 
@@ -17,7 +15,10 @@ use Panda::Export
     MERGE_LAZY         => 8,
     MERGE_SKIP_UNDEF   => 16,
     MERGE_DELETE_UNDEF => 32,
-    MERGE_COPY_SOURCE  => 64;
+    MERGE_COPY_SOURCE  => 64,
+    CLONE_CROSS        => 1,
+    CLONE_NO_COW       => 2,
+    CLONE_SHARED       => 4;
 use Panda::Export
     MERGE_COPY => MERGE_COPY_DEST | MERGE_COPY_SOURCE;
     
@@ -28,52 +29,18 @@ Panda::XSLoader::bootstrap();
 
 *hash_cmp = *compare; # for compability
 
-sub timeout {
-    my ($sub, $timeout) = @_;
-    my ($ok, $alarm);
-    local $SIG{ALRM} = sub {$alarm = 1; die "ALARM!"};
-    Time::HiRes::alarm($timeout || 1);
-    eval {
-        $ok = eval { $sub->(); 1 };
-        die $@ if !$ok and !$alarm;
-        Time::HiRes::alarm(0);
+sub Panda::Lib::MergePlan::CLONE_SKIP { 1 } # C++ object is owned by the interpreter which created it
+
+# timeout() watchdog notifies about expired deadlines with a realtime signal, nobody else uses it. Without realtime signals
+# it's ALRM, which is taken only while timeout() runs
+if (_deadline_signal() ne 'ALRM') { $SIG{_deadline_signal()} = \&_on_deadline }
+else {
+    my $xs_timeout = \&timeout;
+    no warnings 'redefine';
+    *timeout = sub {
+        local $SIG{ALRM} = \&_on_deadline;
+        return $xs_timeout->(@_);
     };
-    return if $alarm;
-    die $@ if !$ok;
-    return 1;
-}
-
-sub encode_utf8_struct {
-    my $data = shift;
-    if (ref($data) eq 'HASH') {
-        foreach my $v (values %$data) {
-            if (ref $v) { encode_utf8_struct($v) }
-            elsif (utf8::is_utf8($v)) { $v = Encode::encode_utf8($v) }
-        }
-    }
-    elsif (ref($data) eq 'ARRAY') {
-        map {
-            if (ref $_) { encode_utf8_struct($_) }
-            elsif (utf8::is_utf8($_)) { $_ = Encode::encode_utf8($_) }
-        } @$data;
-    }
-}
-
-
-sub decode_utf8_struct {
-    my $data = shift;
-    if (ref($data) eq 'HASH') {
-        foreach my $v (values %$data) {
-            if (ref $v) { decode_utf8_struct($v) }
-            elsif (!utf8::is_utf8($v)) { $v = Encode::decode_utf8($v) }
-        }
-    }
-    elsif (ref($data) eq 'ARRAY') {
-        map {
-            if (ref $_) { decode_utf8_struct($_) }
-            elsif (!utf8::is_utf8($_)) { $_ = Encode::decode_utf8($_) }
-        } @$data;
-    }
 }
 
 =head1 DESCRIPTION
@@ -83,7 +50,7 @@ Also it contains several C++ classes.
 
 =head1 SYNOPSIS
 
-    use Panda::Lib qw/ hash_merge merge compare clone fclone crypt_xor string_hash string_hash32 /;
+    use Panda::Lib qw/ hash_merge merge compare clone fclone clone_many crypt_xor string_hash string_hash32 /;
                        
     $result = hash_merge($dest, $source, $flags);
     $result = merge($dest, $source, $flags);
@@ -91,6 +58,7 @@ Also it contains several C++ classes.
     $is_equal = compare($array1, $array2);
     $cloned = clone($data);
     $cloned = fclone($data);
+    @cloned = clone_many(\@list);
     $crypted = crypt_xor($data, $key);
     $val = string_hash($str);
     $val = string_hash32($str);
@@ -196,6 +164,13 @@ Moreover, even primitive values are not copied, instead they get aliased for spe
 
 If you enable this flag, replacing values from source will be copied (references - deep copied).
 
+References are copied like with C<fclone>, once per merge call for all sources: data referenced several times from sources
+is copied once and stays shared in the result, cyclic structures are copied with their cycles.
+
+    my $shared = [1,2];
+    my $res = hash_merge({}, {a => $shared, b => $shared}, MERGE_COPY_SOURCE);
+    say $res->{a} == $res->{b} ? 'same' : 'different'; # prints 'same', and $res->{a} is not $shared
+
 =item MERGE_COPY
 
 It is MERGE_COPY_DEST + MERGE_COPY_SOURCE
@@ -217,6 +192,20 @@ Empty hashref is created, merged with $source and returned.
 
 =back
 
+=head4 hash_merge_many (\%dest, \@sources, [$flags])
+
+Merges all hashes from @sources into $dest in order, i.e. the same as
+
+    $dest = hash_merge($dest, $_, $flags) for @sources;
+
+but in one call: with MERGE_COPY_DEST $dest is copied only once (instead of copying the result of every previous merge), and
+$dest is presized for the combined key count. Undefined sources are skipped.
+
+Because of that, with MERGE_COPY_DEST but without MERGE_COPY_SOURCE, values aliased from one source may be modified by merging
+subsequent sources (consecutive hash_merge calls would copy them on the next call). Use MERGE_COPY to keep sources intact.
+
+    my $config = hash_merge_many($defaults, [$system, $user, $local, $cmdline], MERGE_COPY);
+
 =head4 merge ($dest, $source, [$flags])
 
 Acts much like 'hash_merge', but receives any scalar as $dest and $source, not only hashrefs.
@@ -235,12 +224,52 @@ And so on.
 However there is one difference: if $dest and $source are primitive scalars, instead of creating an alias, the $source variable
 is copied to $dest (or new result). If MERGE_COPY_SOURCE is disabled, copying is not deep, like $dest = $source.
 
-=head4 clone ($source)
+=head4 merge_many ($dest, \@sources, [$flags])
+
+Same as 'hash_merge_many' for 'merge'.
+
+=head4 Panda::Lib::MergePlan->new (\%template, [$flags])
+
+Precompiles merging of hashes into a template hash (for example request parameters into defaults). The plan's C<merge> method
+returns the same as C<hash_merge($template, $source, $flags | MERGE_COPY_DEST)>, but faster:
+
+    my $plan = Panda::Lib::MergePlan->new(\%defaults, MERGE_SKIP_UNDEF);
+    my $params = $plan->merge($request_params); # new hash, %defaults is unchanged
+
+The plan keeps template's key list with precomputed hashes and nested plans for nested plain hashes. Template values are copied only
+if source doesn't replace them, keys of source which are absent in template are merged in a generic way. Template is copied
+when plan is created, so changing it later doesn't affect the plan.
+
+Plans are not copied to new perl threads (they become undef there), create them in the thread which uses them.
+
+=head4 merge ([\%source])
+
+Returns new hashref. If $source is undef, returns a copy of template.
+
+=head4 clone ($source, [$flags])
 
 Makes a deep copy of $source and returns it.
 
+String values are not copied: cloned strings share buffers with the source ones via perl's copy-on-write (perl 5.20+), the buffer
+is copied by perl when either side is modified. This makes cloning structures with big strings nearly free. Flags:
+
+=over
+
+=item CLONE_NO_COW
+
+Copy string buffers right away.
+
+=item CLONE_CROSS
+
+Handle cross-references, same as 'fclone'.
+
+=back
+
 Does not handle cross-references: references to the same data will be different references.
-If cycled reference presents in $source, it will croak.
+If cycled reference presents in $source, it will croak. Cycles are detected precisely, but only deeper than 1000 nested
+references, so a cycle is followed up to that depth before croaking.
+
+Cloning is iterative, so there is no limit on the depth of data (long linked lists, deep trees) and no risk of C stack overflow.
 
 Handles CODEREFs and IOREFs, but doesn't clone it, just copies pointer to the same CODE and IO into new reference. All other
 data types are cloned normally.
@@ -258,11 +287,29 @@ You can call clone($self) again from 'CLONE' callback if you need to, for exampl
 
 In this case second 'clone' call won't call CLONE callback on $self and will clone $self in a standart manner.
 
-=head4 fclone ($source)
+=head4 fclone ($source, [$flags])
 
 Same as 'clone' but handles cross-references: references to the same data will be the same references.
 If cycled reference presents in $source, it will remain cycled in cloned data.
 
+Already cloned references are tracked in a flat open addressing table (see L</"panda::lib::ptr_map">) which is reused
+between calls in the same thread, so fclone's overhead over clone is small.
+
+=head4 clone_many (\@sources, [$flags]), fclone_many (\@sources, [$flags])
+
+Clones every element of @sources and returns the list of clones, in one call and with one internal state.
+
+    my @copies = fclone_many(\@records);
+
+Each element is cloned independently, like with separate clone/fclone calls. With CLONE_SHARED flag (implies CLONE_CROSS)
+data shared between different elements stays shared between their clones, as if the list was cloned as a whole.
+
+=head4 clone_times ($source, $count, [$flags]), fclone_times ($source, $count, [$flags])
+
+Returns the list of $count independent clones of $source.
+
+    my @sessions = clone_times($session_template, 1000);
+
 =head4 compare ($data1, $data2)
 
 Performs deep comparison and returns true if every element of $data1 is equal to corresponding element of $data2.
@@ -316,12 +363,73 @@ Equal if perl's 'eq' or '==' (depending on data type) returns true.
 
 =back
 
-=head4 crypt_xor ($string, $key)
+Cyclic structures are supported: they are equal if their infinite unfoldings are equal. Deep or big structures are compared with
+a memo of already compared pairs, so parts shared by many paths (DAGs) are compared only once.
+Compare is iterative, so there is no limit on the depth of data and no risk of C stack overflow.
+
+=head4 fingerprint ($data)
+
+Returns deep 64-bit hash of $data (as unsigned integer). Data equal by C<compare> have equal fingerprints, so it's enough to keep
+a fingerprint of data to find out later whether it has changed, instead of keeping a full copy to compare against.
+
+    my $fp = fingerprint($config);
+    ...
+    reload() if fingerprint($config) != $fp;
+
+Hash keys order doesn't matter, cyclic and shared data is supported (shared parts are hashed once). Scalars are hashed by their
+string form, so numbers equal by '==' but not by 'eq' (like big integers compared to floats) have different fingerprints.
+Objects are hashed by class and data, even if class overloads '=='. Code refs and globs are hashed by address, the rest is stable
+between processes.
+
+=head4 encode_utf8_struct ($data), decode_utf8_struct ($data)
+
+Converts in place all string values in hashes and arrays reachable from $data, as C<Encode::encode_utf8> / C<Encode::decode_utf8>
+would do with each of them. Hash keys, objects and references to scalars are not touched. Shared and cyclic data is converted once.
+
+    my $request = JSON::XS->new->decode($body);
+    ...
+    encode_utf8_struct($response);
+
+Unlike Encode, decode_utf8_struct leaves strings which are not valid UTF-8 as is (instead of replacing bad bytes), pure ASCII strings
+are not marked as characters, and numbers are not stringified.
+
+=head4 is_ascii ($string)
+
+Returns true if $string has no bytes with high bit set (is the same in any encoding).
+
+=head4 utf8_validate ($string)
+
+Returns true if bytes of $string are well-formed UTF-8 as defined by RFC 3629: no overlong forms, surrogates or code points above
+U+10FFFF. This is stricter than C<utf8::decode> (which accepts surrogates and more) and doesn't change $string.
+
+    die "bad input" unless utf8_validate($body);
+
+=head4 utf8_length ($string)
+
+Returns number of characters in UTF-8 bytes of $string without decoding it. Result is meaningless for invalid UTF-8.
+
+All three look at bytes of $string, i.e. for character strings they check its internal UTF-8 representation. They are vectorized
+(see C<panda::lib::utf8_validate>) and are several times faster than doing the same via C<utf8::decode> or Encode.
+
+=head4 crypt_xor ($string, $key, [$key_offset = 0])
 
 Performs round-robin XOR $string with $key. Algorithm is symmetric, i.e.:
 
     crypt_xor(crypt_xor($string, $key), $key) eq $string
     
+If $key_offset is given, XOR starts from this position in $key. It allows to process large data chunk by chunk: the offset for
+the next chunk is C<($key_offset + length($chunk)) % length($key)>.
+
+=head4 crypt_xor_inplace ($string, $key, [$key_offset = 0])
+
+Same as crypt_xor, but modifies $string in place, without creating a new string. Returns key offset for the next chunk:
+
+    my $koff = 0;
+    while (sysread($fh, my $chunk, 65536)) {
+        $koff = crypt_xor_inplace($chunk, $key, $koff);
+        syswrite($out, $chunk);
+    }
+
 =head4 string_hash ($string)
 
 Calculates 64-bit hash value for $string. Currently uses MurMurHash64A algorithm (very fast).
@@ -330,13 +438,79 @@ Calculates 64-bit hash value for $string. Currently uses MurMurHash64A algorithm
 
 Calculates 32-bit hash value for $string. Currently uses jenkins_one_at_a_time_hash algorithm.
 
+=head4 hash64 ($string, [$seed = 0])
+
+Calculates seeded 64-bit hash value for $string. Uses wyhash algorithm, which is several times faster than string_hash for long
+strings and has better quality. string_hash and string_hash32 results are kept unchanged for compatibility.
+
+=head4 hash64_batch (\@strings, [$seed = 0])
+
+Calculates hash64 for every string in array in one call and returns them packed as native 64-bit integers:
+
+    my @hashes = unpack 'Q*', Panda::Lib::hash64_batch(\@keys);
+
+=head4 itoa ($number)
+
+Returns decimal representation of integer value of $number (floats are truncated, as with C<int>).
+
+=head4 itoa_batch (\@numbers)
+
+Formats all numbers in array at once, returns reference to array of strings. Unlike C<"$_" for @numbers> it doesn't
+stringify (and grow) the original values.
+
+=head4 itoa_join (\@numbers, [$separator = ','])
+
+Same as C<join($separator, map { int } @numbers)>, but faster and without stringifying @numbers.
+
+    print $fh itoa_join(\@ids, "\n"), "\n";
+
+=head4 atoi ($string)
+
+Strictly parses integer: the whole $string must be decimal digits with optional sign, no spaces. Returns the number or undef if
+$string is not an integer or doesn't fit into 64 bits (unsigned numbers up to 2**64-1 are allowed).
+
+=head4 timeout (\&sub, [$seconds = 1])
+
+Runs sub and interrupts it if it doesn't finish in $seconds (fractional). Returns 1 if sub finished, empty list if it was interrupted.
+Exceptions from sub are rethrown.
+
+    Panda::Lib::timeout(sub { $result = $client->request(...) }, 0.5) or warn "request timed out";
+
+Timeouts nest: inner timeout() returns false when its own deadline expires and passes the interruption through if it's the outer one's.
+Deadlines are watched by a background thread (see panda::lib::deadline_stack) which signals only when one expires, with signal
+RTMIN, so C<alarm> and C<$SIG{ALRM}> stay free. Guarded call costs no syscalls. On systems without realtime signals it's ALRM,
+and C<$SIG{ALRM}> is localized for the duration of timeout() (so alarm can't be used inside it there).
+Like with alarm, sub is interrupted between perl ops, and an C<eval> inside it may catch the interruption (its message is
+"Panda::Lib::timeout: deadline exceeded\n").
+
 =head1 C FUNCTIONS
 
 =head4 HV* xs::lib::hash_merge (HV* dest, HV* source, IV flags)
 
 =head4 SV* xs::lib::merge (SV* dest, SV* source, IV flags)
 
-=head4 SV* xs::lib::clone (SV* source, bool cross_references)
+=head4 HV* xs::lib::hash_merge (HV* dest, HV* const* sources, size_t cnt, IV flags)
+
+=head4 SV* xs::lib::merge (SV* dest, SV* const* sources, size_t cnt, IV flags)
+
+Merge several sources in order (NULLs are skipped), copying dest (with MERGE_COPY_DEST) only once.
+
+=head4 xs::lib::merge_plan (HV* tmpl, IV flags = 0)
+
+=head4 HV* xs::lib::merge_plan::merge (HV* source) const
+
+C++ class behind Panda::Lib::MergePlan. merge() returns new hash with refcnt 1.
+
+=head4 SV* xs::lib::clone (SV* source, int flags = 0)
+
+Flags are xs::lib::CLONE_CROSS (fclone) and xs::lib::CLONE_NO_COW.
+
+=head4 void xs::lib::clone (SV* const* sources, size_t cnt, SV** dest, int flags = 0)
+
+=head4 void xs::lib::clone (SV* source, size_t cnt, SV** dest, int flags = 0)
+
+Batch versions: clone 'cnt' sources (or the same source 'cnt' times) into new SVs stored to 'dest'. xs::lib::CLONE_SHARED flag
+keeps data shared between sources shared between clones.
 
 =head4 bool xs::lib::hv_compare (HV*, HV*)
 
@@ -344,6 +518,12 @@ Calculates 32-bit hash value for $string. Currently uses jenkins_one_at_a_time_h
 
 =head4 bool xs::lib::sv_compare (SV*, SV*)
 
+=head4 uint64_t xs::lib::sv_fingerprint (SV*)
+
+=head4 void xs::lib::encode_utf8_struct (SV* data)
+
+=head4 void xs::lib::decode_utf8_struct (SV* data)
+
 =head4 uint64_t panda::lib::string_hash (const char* str, size_t len)
 
 =head4 uint64_t panda::lib::string_hash (const char* str)
@@ -352,13 +532,83 @@ Calculates 32-bit hash value for $string. Currently uses jenkins_one_at_a_time_h
 
 =head4 uint32_t panda::lib::string_hash32 (const char* str)
 
+=head4 uint64_t panda::lib::hash64 (const char* str, size_t len, uint64_t seed = 0)
+
+=head4 uint64_t panda::lib::hash64 (const char* str)
+
+=head4 void panda::lib::hash64 (const char* const* strs, const size_t* lens, size_t cnt, uint64_t* dest, uint64_t seed = 0)
+
+Batch version: calculates hashes of 'cnt' strings into 'dest'.
+
+=head4 panda::lib::hasher64
+
+Incremental hash64 for data that arrives in chunks. Result is the same as hash64 of the whole data.
+
+    panda::lib::hasher64 h(seed);
+    while (...) h.update(chunk, chunk_len);
+    uint64_t hash = h.digest();
+
 All functions above behaves like its perl equivalents. See PERL FUNCTIONS docs.
 
+=head4 const char* panda::lib::find_bytes (const char* haystack, size_t hlen, const char* needle, size_t nlen)
+
+=head4 const char* panda::lib::rfind_bytes (const char* haystack, size_t hlen, const char* needle, size_t nlen)
+
+=head4 const char* panda::lib::rfind_char (const char* str, size_t len, char c)
+
+=head4 const char* panda::lib::find_first_of (const char* str, size_t len, const char* set, size_t setlen)
+
+=head4 const char* panda::lib::find_last_of (const char* str, size_t len, const char* set, size_t setlen)
+
+=head4 const char* panda::lib::find_first_not_of (const char* str, size_t len, const char* set, size_t setlen)
+
+=head4 const char* panda::lib::find_last_not_of (const char* str, size_t len, const char* set, size_t setlen)
+
+Search kernels used by panda::string's find/rfind/find_*_of methods. They respect lengths (embedded NULs are ok) and use
+SSE2/AVX2 (chosen at runtime by CPU capabilities) when available. Return pointer to what is found or NULL.
+
+=head4 char* panda::lib::itoa (int64_t val, char* buf)
+
+=head4 char* panda::lib::utoa (uint64_t val, char* buf)
+
+Write decimal representation of 'val' into 'buf' which must have room for panda::lib::MAX_INT_CHARS (20) chars. Result is
+not null-terminated, returns pointer past the last written char. Reentrant, produce two digits per step via lookup table.
+
+=head4 const char* panda::lib::atoi (const char* str, size_t len, int64_t& val)
+
+=head4 const char* panda::lib::atou (const char* str, size_t len, uint64_t& val)
+
+Parse decimal integer (optional sign and digits) at the beginning of 'str' into 'val'. Return pointer past the last digit or NULL if
+there are no digits or value is out of range. Parse 8 digits at a time.
+
+=head4 char* panda::lib::itoa (int64_t i)
+
+Deprecated. Returns null-terminated string in a thread-local buffer which is overwritten by the next call.
+
+=head4 bool panda::lib::is_ascii (const char* str, size_t len)
+
+=head4 bool panda::lib::utf8_validate (const char* str, size_t len)
+
+=head4 size_t panda::lib::utf8_length (const char* str, size_t len)
+
+Byte classification kernels behind is_ascii/utf8_validate/utf8_length. Use AVX2 or SSE2 (chosen at runtime) when available, scalar
+code (8 bytes at a time) otherwise. AVX2 validation uses the lookup algorithm by Keiser and Lemire, ASCII blocks are skipped.
+Perl headers define utf8_length() macro, so call it as C<(panda::lib::utf8_length)(str, len)> where they are included.
+
 =head4 char* panda::lib::crypt_xor (const char* source, size_t slen, const char* key, size_t klen, char* dest = NULL)
 
 Performs XOR crypt. If 'dest' is null, mallocs and returns new buffer. Buffer must be freed by user manually via 'free'. If 'dest'
 is not null, places result into this buffer. It must have enough space to hold the result.
 
+Result is null-terminated, so 'dest' must have space for slen + 1 bytes.
+
+=head4 size_t panda::lib::crypt_xor (const char* source, char* dest, size_t len, const char* key, size_t klen, size_t koff = 0)
+
+XORs 'len' bytes from 'source' into 'dest' starting from key offset 'koff', returns key offset for the next chunk. 'dest' may be
+the same as 'source' for in-place processing. Result is not null-terminated.
+
+Both use SSE2/AVX2 when CPU supports it: key is pre-expanded into a pattern, so that a whole vector of data is XORed at once.
+
 =head4 panda::string xs::lib::sv2string (SV* svstr, panda::string::ref_t ref = panda::string::COPY)
 
 Creates panda::string from SV string. If 'ref' is COPY then content of SV is copied to string. If 'ref' is REF, then returned
@@ -378,6 +628,22 @@ Panda::Lib installs a typemap for panda::string, so it is okay to receive it in
         str.retain(); // it ok now to change ST(0), as str is detached from original string.
         ...
 
+=head4 panda::string xs::lib::sv2string_shared (SV* svstr)
+
+Creates panda::string sharing SV's buffer without copying, which is still safe to use after SV is changed or freed.
+A private perl copy of SV is made using perl's copy-on-write (so usually the buffer itself is not copied) and the string holds a
+reference to it until the last string sharing the buffer is gone. Strings made this way are read-only views: modifying them
+detaches (copies) them as usual. Short strings (up to MAX_SSO_CHARS) are just copied.
+
+Such strings must be destroyed in the perl thread that created them, even for panda::atomic_string.
+
+=head4 SV* xs::lib::string2sv (panda::string& str)
+
+Returns new SV with the content of 'str' and makes 'str' empty. If 'str' exclusively owns its heap buffer, the buffer is handed
+over to SV without allocation (data is moved to the beginning of the buffer), so that SV is a regular perl string.
+If 'str' shares buffer of a perl string (see C<sv2string_shared>), new SV shares it too via perl's copy-on-write.
+Otherwise the content is copied.
+
 =head1 C++ CLASSES
 
 =head2 panda::string
@@ -410,6 +676,15 @@ creating a string from literal: string("mystring"), or myhash["mykey"]
 
 panda::string is converted into std::string on demand. Also it can be used in ostream's and istream's << >> operators.
 
+Strings up to C<panda::string::MAX_SSO_CHARS> bytes (15 on 64-bit platforms) are stored inline in the string object itself
+and never allocate memory. Heap buffer with reference counter and COW is used only for longer strings. The string object is 32 bytes
+on 64-bit platforms (24 before 0.2.0), so code compiled against older headers must be rebuilt.
+
+Substrings (C<substr>, C<assign(str, pos, len)>, C<string(str, pos, len)>) of a heap string are not copied, they share the same
+buffer (its reference counter is increased) and point to a window inside it. Such a string is detached (copied) only when
+it is modified. Short substrings (up to MAX_SSO_CHARS) are copied inline instead, so that a small piece doesn't hold a large buffer.
+Removing characters from the beginning or from the end of a heap string (erase) also just narrows the window.
+
 =head3 METHODS
 
 Only new methods or methods with additional params are listed. All other methods have the same syntax and meaning as in std::string.
@@ -444,16 +719,197 @@ Common case: parse something directly into string:
     // fill buf
     str.resize(actual_length);
     
+=head4 const char* c_str ()
+
+Unlike 'data', guarantees null-terminated result for strings holding inline or heap buffer. If the string is a window
+into a shared buffer, it gets detached to terminate it. Strings in COW mode with external pointer are returned as is.
+
 =head4 string& retain ()
 
 Detaches string if it's in COW mode. Does nothing otherwise. Returns the string itself.
 
+=head4 size_t capacity ()
+
+Returns MAX_SSO_CHARS for inline strings, buffer size for heap strings and 0 for strings in COW mode with external pointer
+or sharing external memory.
+
 =head4 string& assign (const char* p, ref_t ref = REF)
 
 =head4 string& assign (const char* p, size_t len, ref_t ref = REF)
 
 'ref' has the same meaning as in constructor.
 
+=head4 string (const char* p, size_t len, release_fn release, void* ctx)
+
+=head4 string& assign (const char* p, size_t len, release_fn release, void* ctx)
+
+Shares external memory 'p' owned by someone else (typedef void (*release_fn) (const char* p, void* ctx)). The memory is never
+modified by strings (they detach on modification) and 'release(p, ctx)' is called when the last string sharing it is gone.
+
+=head4 uint64_t hash () const
+
+Returns hash64 of the string. For heap strings it is computed once and memoized in the shared buffer, so all copies of the string
+(and substrings starting at the beginning of the buffer with the same length) get it without rehashing. Memo is reset when the
+buffer is modified.
+
+=head4 string& append_int (int64_t val), string& append_uint (uint64_t val)
+
+Append decimal representation of 'val' (via panda::lib::itoa/utoa). string_builder has the same methods.
+
+=head4 bool is_ascii () const, bool utf8_validate () const, size_t utf8_chars () const
+
+Run panda::lib::is_ascii/utf8_validate/utf8_length on the string. The last one is named differently because of perl macro.
+
+=head4 void* external_context (release_fn release) const
+
+Returns 'ctx' of external memory this string shares, if it was shared with the same 'release' function, NULL otherwise.
+
+=head4 void* release_buffer (size_t& offset, size_t& size)
+
+If string exclusively owns a heap buffer allocated by malloc (no custom allocator), gives it away and becomes empty.
+Returns the beginning of memory block, which must be freed via free(), sets 'offset' to the position of (null-terminated)
+string data in it and 'size' to its size. Otherwise returns NULL and leaves the string untouched.
+
+=head2 panda::atomic_string
+
+Exactly the same as panda::string, but reference counter of shared buffer is atomic. So that copies of the same string
+(or its substrings) can be passed to and used in different threads without deep copying. The usual rules apply: different
+string objects sharing a buffer can be used concurrently, the same object cannot.
+
+Both are instantiations of C<panda::basic_string E<lt>RefcntE<gt>> template with C<plain_refcnt> and C<atomic_refcnt> policies.
+They don't share buffers with each other, convert via C<atomic_string(str.data(), str.length(), atomic_string::COPY)>.
+
+Don't pass strings allocated in arena_allocator to other threads.
+
+=head2 panda::string_map, panda::string_set
+
+    #include <panda/string_map.h>
+
+    panda::string_map<int> map;
+    map[key] = 10;
+    panda::string_map<int>::iterator it = map.find(panda::string(ptr, len)); // REF mode, no copying
+    if (it != map.end()) cout << it->first << "=" << it->second;
+
+    panda::string_set set;
+    set.insert(key);
+
+Open addressing hash table (linear probing, max load factor 0.8, no tombstones) keyed by panda::string (C<string_map E<lt>V, String = stringE<gt>>,
+C<atomic_string_set> for panda::atomic_string keys). Full 64-bit hashes are stored in a separate compact array, so that probing
+touches only it and keys are compared only when hashes match; growing doesn't need to rehash keys. Key hashes are taken from
+C<string::hash()>, i.e. memoized in string buffers. There is no per-element allocation.
+
+Supports subset of std::unordered_map API: C<begin, end, find, count, insert, erase, operator[], size, empty, capacity,
+reserve, clear>. Inserting or erasing invalidates iterators.
+
+=head2 panda::lib::ptr_map
+
+    #include <panda/lib/ptr_map.h>
+
+    panda::lib::ptr_map<SV*> seen(estimate);
+    bool inserted;
+    SV** val = seen.insert(ptr, sv, inserted);
+    if (!inserted) ...; // *val is the value inserted before for ptr
+
+Open addressing map from pointers to small trivially copyable values, for tracking identity of objects while walking graphs.
+Keys and values are stored together in one array (linear probing, fibonacci hashing, max load factor 0.75), NULL key is not allowed.
+C<clear()> keeps allocated memory, so the map can be reused for many walks without reallocation.
+
+Methods: C<V* find (const void* key)> (NULL if absent), C<V* insert (const void* key, const V& value, bool& inserted)>,
+C<bool insert (const void* key, const V& value)>, C<operator[]>, C<erase>, C<reserve>, C<clear>, C<size>, C<empty>, C<capacity>.
+
+=head2 panda::lib::deadline_stack
+
+    #include <panda/lib/deadline.h>
+
+    panda::lib::deadline_stack& deadlines = panda::lib::deadline_stack::instance(); // of this thread
+    deadlines.push(timeout_ns);
+    ... // on deadline_stack::signo: if (deadlines.fire()) abort the work
+    bool fired = deadlines.pop();
+
+Deadlines of nested sections of each thread, all watched by one watchdog thread sleeping until the earliest of them. When a deadline
+expires, the owner thread gets signal C<deadline_stack::signo> (SIGRTMIN or SIGALRM); its handler calls C<fire()>, which marks the
+outermost expired section and returns its depth (0 if the signal is late and the section is already left). Push and pop are a few
+memory writes: the watchdog is woken only when a new deadline is earlier than its wakeup time. Survives fork.
+
+=head2 panda::string_builder
+
+    #include <panda/string_builder.h>
+
+    panda::string_builder out;
+    out << "HTTP/1.1 200 OK\r\n" << headers << "\r\n";
+    out.append(body); // long string is linked, not copied
+    
+    panda::string response = out.str(); // flattened once
+    // or without flattening
+    struct iovec v[IOV_MAX];
+    for (size_t from = 0, cnt; (cnt = out.iov(v, IOV_MAX, from)); from += cnt) writev(fd, v, cnt);
+
+Append-only string accumulator for building large outputs from many small pieces. Data is written into a chain of chunks,
+each new chunk is twice as big as the previous one (from MIN_CHUNK = 256 up to MAX_CHUNK = 1MB), so data is never moved and
+reallocated while appending. Strings of LINK_MIN (512) bytes or longer are added to the chain as is, sharing their buffer
+(the usual panda::string rules apply, i.e. strings in COW mode with external pointer must stay valid).
+
+C<panda::atomic_string_builder> is the same for panda::atomic_string.
+
+=head4 string_builder (size_t reserve = 0)
+
+Size of the first chunk, if you know the approximate size of result.
+
+=head4 string_builder& append (...), operator+= (...), operator<< (...)
+
+Appends panda::string, const char* (with or without length), or a char (n times).
+
+=head4 string str () const
+
+Returns the concatenation of all chunks. If there is only one chunk, it is returned without copying.
+
+=head4 size_t iov (struct iovec* v, size_t cnt, size_t from = 0) const
+
+Fills at most 'cnt' iovec structures with the chunks starting from chunk 'from', returns the number of filled structures.
+
+=head4 size_t length () const, size_t chunks () const, const string& chunk (size_t i) const, void clear ()
+
+=head2 panda::lib::allocator
+
+Memory allocator interface used by panda::string for its heap buffers.
+
+    class allocator {
+        virtual void* allocate   (size_t size) = 0;
+        virtual void* reallocate (void* ptr, size_t old_size, size_t new_size); // allocate + memcpy + deallocate by default
+        virtual void  deallocate (void* ptr, size_t size) = 0;
+    };
+
+Each heap buffer remembers allocator it was created with and returns memory to it, regardless of what allocator is
+installed at that moment. Allocators must throw std::bad_alloc on failure.
+
+=head4 void panda::lib::set_string_allocator (allocator* alloc)
+
+=head4 allocator* panda::lib::get_string_allocator ()
+
+Sets/gets allocator for new panda::string buffers in current thread. NULL (the default) means std::malloc.
+
+=head4 panda::lib::string_allocator_guard (allocator* alloc)
+
+Sets string allocator for current thread until the guard goes out of scope, then restores previous one.
+
+=head3 panda::lib::pool_allocator
+
+Size-class pool (32 bytes .. 8Kb, power of 2 classes) with thread-local free lists, so that allocation and deallocation
+don't take any locks. Bigger blocks go directly to malloc. Use C<pool_allocator::instance()>.
+
+    panda::lib::set_string_allocator(panda::lib::pool_allocator::instance());
+
+=head3 panda::lib::arena_allocator
+
+Bump-pointer arena: memory is carved from big chunks and released all at once, either by C<reset()> or by destructor.
+Strings created in arena must not outlive it. Not thread-safe.
+
+    void handle_request (...) {
+        panda::lib::arena_allocator arena;
+        panda::lib::string_allocator_guard guard(&arena);
+        ... // all string buffers are allocated from arena and freed in bulk at the end of request
+    }
+
 =head1 TYPEMAPS
 
 =head4 panda::string
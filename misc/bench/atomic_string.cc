@@ -0,0 +1,34 @@
+// panda::atomic_string benchmark against panda::string (concurrency stress test is t/cpp/atomic_string.cc)
+// build: g++ -O2 -pthread -Isrc misc/bench/atomic_string.cc src/panda/lib/memory.cc -o atomic_string_bench && ./atomic_string_bench
+#include <panda/string.h>
+#include <cstdio>
+#include <ctime>
+
+using panda::string;
+using panda::atomic_string;
+
+static double now () {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+template <class String>
+static void bench_copy (const char* name) {
+    String src(1000, 'a');
+    const int iters = 20000000;
+    double start = now();
+    size_t total = 0;
+    for (int i = 0; i < iters; ++i) {
+        String copy(src);
+        total += copy.length();
+    }
+    std::printf("%-36s %8.2f Mops/s (%lu)\n", name, iters / (now() - start) / 1e6, (unsigned long)total);
+}
+
+int main () {
+    std::printf("copy+destroy of shared 1000 bytes string\n");
+    bench_copy<string>("  panda::string");
+    bench_copy<atomic_string>("  panda::atomic_string");
+    return 0;
+}
@@ -0,0 +1,75 @@
+#!/usr/bin/perl
+# clone/fclone benchmark on big shared (DAG), cyclic and flat structures
+# run: perl -Mblib misc/bench/clone.pl [nodes] [iterations]
+use strict;
+use warnings;
+use Time::HiRes qw/time/;
+use Panda::Lib qw/clone fclone clone_many clone_times fclone_many CLONE_NO_COW/;
+
+my $nodes = shift || 100000;
+my $iters = shift || 10;
+
+# DAG: every leaf is shared by 4 nodes
+my @leaves = map { {id => $_, data => [$_, "leaf$_"]} } 1..$nodes/4;
+my $dag = [map { {id => $_, name => "node$_", left => $leaves[$_ % @leaves], right => $leaves[($_ * 7) % @leaves]} } 1..$nodes];
+
+# cyclic: 3-level tree, every node refers to its parent and root
+my $width = int($nodes ** (1/3)) || 1;
+my $cyclic = {name => 'root'};
+for my $i (1..$width) {
+    my $l1 = {name => "l$i", parent => $cyclic, root => $cyclic};
+    push @{$cyclic->{children}}, $l1;
+    for my $j (1..$width) {
+        my $l2 = {name => "l$i.$j", parent => $l1, root => $cyclic};
+        push @{$l1->{children}}, $l2;
+        push @{$l2->{children}}, {name => "l$i.$j.$_", parent => $l2, root => $cyclic} for 1..$width;
+    }
+}
+
+# flat: nothing is shared, fclone's map overhead vs clone
+my $flat = [map { {id => $_, name => "item$_", tags => [1, 2, 3]} } 1..$nodes];
+
+# big hash, like configs
+my $config = {map { ("key$_" => "value$_") } 1..$nodes/10};
+
+# big strings, shared via copy-on-write or copied
+my $blobs = [map { {id => $_, body => chr(65 + $_ % 26) x 65536} } 1..$nodes/100];
+
+# small records and template, one by one vs batch
+my $template = {id => 0, name => 'template', opts => {a => 1, b => [1, 2]}};
+my $records  = [map { {id => $_, name => "rec$_", opts => {a => $_}} } 1..$nodes/10];
+
+sub untangle {
+    my @queue = (shift);
+    while (my $node = shift @queue) {
+        push @queue, @{$node->{children} || []};
+        %$node = ();
+    }
+}
+
+sub bench {
+    my ($name, $sub, $cleanup) = @_;
+    my $total = 0;
+    for (1..$iters) {
+        my $start = time;
+        my $ret = $sub->();
+        $total += time - $start;
+        $cleanup->($ret) if $cleanup;
+    }
+    printf "%-16s %8.2f ms\n", $name, $total / $iters * 1000;
+}
+
+print "$nodes nodes, $iters iterations\n";
+bench(dag_fclone    => sub { fclone($dag) });
+bench(cyclic_fclone => sub { fclone($cyclic) }, \&untangle); # cycles are not timed
+bench(flat_fclone   => sub { fclone($flat) });
+bench(flat_clone    => sub { clone($flat) });
+bench(hash_clone    => sub { clone($config) });
+bench(blobs_clone   => sub { clone($blobs) });
+bench(blobs_nocow   => sub { clone($blobs, CLONE_NO_COW) });
+bench(records_each  => sub { [map { fclone($_) } @$records] });
+bench(records_many  => sub { [fclone_many($records)] });
+bench(template_each => sub { [map { clone($template) } 1..@$records] });
+bench(template_many => sub { [clone_times($template, scalar @$records)] });
+
+untangle($cyclic);
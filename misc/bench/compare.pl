@@ -0,0 +1,46 @@
+#!/usr/bin/perl
+# compare/fingerprint benchmark on plain, shared (DAG) and cyclic structures
+# run: perl -Mblib misc/bench/compare.pl [nodes] [iterations]
+use strict;
+use warnings;
+use Time::HiRes qw/time/;
+use Panda::Lib qw/compare fingerprint fclone/;
+
+my $nodes = shift || 10000;
+my $iters = shift || 20;
+
+# small config, compared very often - must stay cheap
+my $small = {name => 'config', opts => {a => 1, b => [1, 2, 3]}, list => [map { {id => $_} } 1..10]};
+
+# plain data without sharing
+my $plain = {map { ("key$_" => {id => $_, name => "name$_", tags => [1, 2, 3]}) } 1..$nodes};
+
+# DAG: 20 levels, every node refers to the next level twice - 2^20 paths
+my $dag = {leaf => [map { {id => $_} } 1..$nodes / 100]};
+$dag = {left => $dag, right => $dag, level => $_} for 1..20;
+
+# cyclic: records referring to their neighbours and to the root
+my $root = {name => 'root'};
+my @records = map { {id => $_, root => $root} } 1..$nodes;
+$records[$_]{next} = $records[($_ + 1) % @records] for 0..$#records;
+$root->{first} = $records[0];
+
+my %pairs = (small => [$small, fclone($small)], plain => [$plain, fclone($plain)], dag => [$dag, fclone($dag)],
+             cyclic => [$root, fclone($root)]);
+
+sub bench {
+    my ($name, $iters, $sub) = @_;
+    my $start = time;
+    $sub->() for 1..$iters;
+    printf "%-20s %10.2f us\n", $name, (time - $start) / $iters * 1e6;
+}
+
+print "$nodes nodes, $iters iterations\n";
+for my $shape (qw/small plain dag cyclic/) {
+    my ($first, $second) = @{$pairs{$shape}};
+    my $cnt = $shape eq 'small' ? $iters * 10000 : $iters;
+    bench("compare_$shape", $cnt, sub { compare($first, $second) or die "not equal" });
+    bench("fingerprint_$shape", $cnt, sub { fingerprint($first) });
+}
+
+%$_ = () for $root, @records, $pairs{cyclic}[1];
@@ -0,0 +1,48 @@
+#!/usr/bin/perl
+# Compares two result files of micro/suite.pl (JSON lines), e.g. of previous and current release.
+# Exits with status 1 if any benchmark became slower by more than --threshold percent (10 by default).
+# If a file has several results of one benchmark (appended runs), the best one is used.
+# run: perl misc/bench/diff.pl [--threshold=PCT] [--all] base.json new.json
+use strict;
+use warnings;
+use Getopt::Long;
+use JSON::PP;
+
+my ($threshold, $all) = (10, 0);
+GetOptions('threshold=f' => \$threshold, 'all' => \$all) && @ARGV == 2
+    or die "usage: $0 [--threshold=PCT] [--all] base.json new.json\n";
+my ($base, $new) = map { load($_) } @ARGV;
+
+sub load {
+    my $file = shift;
+    open my $fh, '<', $file or die "$file: $!\n";
+    my (%res, @order);
+    while (my $line = <$fh>) {
+        next unless $line =~ /\S/;
+        my $r = decode_json($line);
+        my $key = "$r->{suite}:$r->{name}";
+        push @order, $key unless exists $res{$key};
+        $res{$key} = $r->{ns_per_op} if !exists $res{$key} or $r->{ns_per_op} < $res{$key};
+    }
+    return {res => \%res, order => \@order};
+}
+
+my $regressions = 0;
+printf "%-40s %12s %12s %8s\n", 'benchmark', 'base ns/op', 'new ns/op', 'change';
+for my $key (@{$new->{order}}) {
+    my $was = $base->{res}{$key};
+    my $now = $new->{res}{$key};
+    unless (defined $was) {
+        printf "%-40s %12s %12.2f %8s\n", $key, '-', $now, 'new' if $all;
+        next;
+    }
+    my $change = $was ? ($now - $was) / $was * 100 : 0;
+    my $slower = $change > $threshold;
+    $regressions++ if $slower;
+    next unless $all or $slower or $change < -$threshold;
+    printf "%-40s %12.2f %12.2f %+7.1f%%%s\n", $key, $was, $now, $change, $slower ? '  REGRESSION' : '';
+}
+exists $new->{res}{$_} or print "$_: missing in new results\n" for @{$base->{order}};
+
+print $regressions ? "$regressions regression(s) over $threshold%\n" : "no regressions over $threshold%\n";
+exit($regressions ? 1 : 0);
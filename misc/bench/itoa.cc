@@ -0,0 +1,88 @@
+// integer formatting/parsing: panda::lib::itoa/utoa/atoi vs snprintf/strtoll and former digit-per-division itoa
+// build: g++ -O2 -Isrc misc/bench/itoa.cc src/panda/lib/*.cc -o itoa_bench && ./itoa_bench
+#include <panda/lib/itoa.h>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <stdint.h>
+
+static double now () {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char* old_itoa (int64_t i, char* buf) { // former implementation, writing into given buffer
+    char* p = buf + 21;
+    if (i >= 0) do { *--p = '0' + (i % 10); i /= 10; } while (i != 0);
+    else {
+        do { *--p = '0' - (i % 10); i /= 10; } while (i != 0);
+        *--p = '-';
+    }
+    return p;
+}
+
+static const int ROUNDS = 20;
+
+template <class F>
+static void bench (const char* name, const std::vector<int64_t>& nums, F f) {
+    char buf[32];
+    size_t sum = 0;
+    double start = now();
+    for (int n = 0; n < ROUNDS; ++n)
+        for (size_t i = 0; i < nums.size(); ++i) sum += f(nums[i], buf) - buf + buf[0];
+    double t = now() - start;
+    std::printf("%-28s %7.2f ns/number  (%lu)\n", name, t / (nums.size() * ROUNDS) * 1e9, (unsigned long)sum);
+}
+
+static char* snprintf_fmt (int64_t v, char* buf) { return buf + std::snprintf(buf, 32, "%lld", (long long)v); }
+static char* panda_itoa   (int64_t v, char* buf) { return panda::lib::itoa(v, buf); }
+static char* panda_utoa   (int64_t v, char* buf) { return panda::lib::utoa(v, buf); }
+
+int main () {
+    const size_t N = 1000000;
+    srand(1);
+    const char* names[] = {"small (0..999)", "ids (32-bit)", "wide (mixed widths)"};
+    for (int kind = 0; kind < 3; ++kind) {
+        std::vector<int64_t> nums(N);
+        for (size_t i = 0; i < N; ++i) {
+            uint64_t r = (uint64_t)rand() << 32 ^ rand();
+            nums[i] = kind == 0 ? r % 1000 : kind == 1 ? r % 4294967296ULL : r >> (r % 64);
+        }
+        std::printf("%s\n", names[kind]);
+        bench("snprintf", nums, snprintf_fmt);
+        bench("old itoa", nums, old_itoa);
+        bench("panda::lib::itoa", nums, panda_itoa);
+        bench("panda::lib::utoa", nums, panda_utoa);
+
+        std::vector<char> text;
+        std::vector<size_t> offs;
+        char buf[32];
+        for (size_t i = 0; i < N; ++i) {
+            offs.push_back(text.size());
+            text.insert(text.end(), buf, panda::lib::itoa(nums[i], buf));
+        }
+        offs.push_back(text.size());
+        int64_t sum = 0;
+        double start = now();
+        for (int n = 0; n < ROUNDS; ++n)
+            for (size_t i = 0; i < N; ++i) {
+                std::memcpy(buf, &text[offs[i]], offs[i+1] - offs[i]);
+                buf[offs[i+1] - offs[i]] = 0;
+                sum += std::strtoll(buf, NULL, 10);
+            }
+        std::printf("%-28s %7.2f ns/number  (%lld)\n", "strtoll", (now() - start) / (N * ROUNDS) * 1e9, (long long)sum);
+        sum = 0;
+        start = now();
+        for (int n = 0; n < ROUNDS; ++n)
+            for (size_t i = 0; i < N; ++i) {
+                int64_t v = 0;
+                panda::lib::atoi(&text[offs[i]], offs[i+1] - offs[i], v);
+                sum += v;
+            }
+        std::printf("%-28s %7.2f ns/number  (%lld)\n", "panda::lib::atoi", (now() - start) / (N * ROUNDS) * 1e9, (long long)sum);
+    }
+    return 0;
+}
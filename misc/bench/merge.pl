@@ -0,0 +1,49 @@
+#!/usr/bin/perl
+# hash_merge benchmark: config layering, request parameters over defaults
+# run: perl -Mblib misc/bench/merge.pl [keys] [iterations]
+use strict;
+use warnings;
+use Time::HiRes qw/time/;
+use Panda::Lib qw/hash_merge hash_merge_many :const/;
+
+my $keys  = shift || 200;
+my $iters = shift || 2000;
+
+sub section { my ($n, $tag) = @_; return {map { ("${tag}_$_" => $_, "common_$_" => "$tag$_") } 1..$n} }
+
+# defaults with nested sections, 6 layers overriding parts of them and adding their own keys
+my $defaults = {map { ("section$_" => section($keys / 10, 'default')) } 1..10};
+$defaults->{$_} = $_ for 1..$keys;
+my @layers = map {
+    my $layer = $_;
+    my $h = {map { ("section$_" => section($keys / 40, "layer$layer")) } 1..10};
+    $h->{"layer${layer}_$_"} = $_ for 1..$keys / 4;
+    $h;
+} 1..6;
+
+# request defaults and parameters of the same shape: params override some of defaults and add a few keys
+my $req_defaults = {map { ("param$_" => "default$_") } 1..30};
+$req_defaults->{paging} = {page => 1, limit => 20, order => 'id'};
+$req_defaults->{filter} = {map { ("f$_" => undef) } 1..10};
+my @params = map { {param1 => $_, param5 => "v$_", paging => {page => $_}, filter => {f1 => $_}, extra => $_} } 1..100;
+my $plan = Panda::Lib::MergePlan->new($req_defaults);
+
+# DAG-shaped source: many items referring to a few shared lookup tables, copied into result
+my @tables = map { {id => $_, rows => [map { {n => $_, name => "row$_"} } 1..20]} } 1..10;
+my $dag = {map { ("item$_" => {id => $_, table => $tables[$_ % @tables], rows => $tables[$_ % @tables]{rows}}) } 1..$keys};
+
+sub bench {
+    my ($name, $sub) = @_;
+    my $start = time;
+    $sub->() for 1..$iters;
+    printf "%-24s %8.2f us\n", $name, (time - $start) / $iters * 1e6;
+}
+
+print "$keys keys, ", scalar(@layers), " layers, $iters iterations\n";
+bench(sequential_copy      => sub { my $r = $defaults; $r = hash_merge($r, $_, MERGE_COPY) for @layers; });
+bench(many_copy            => sub { hash_merge_many($defaults, \@layers, MERGE_COPY) });
+bench(sequential_copy_dest => sub { my $r = $defaults; $r = hash_merge($r, $_, MERGE_COPY_DEST) for @layers; });
+bench(many_copy_dest       => sub { hash_merge_many($defaults, \@layers, MERGE_COPY_DEST) }); # merges later layers into earlier ones' sections
+bench(params_hash_merge    => sub { hash_merge($req_defaults, $_, MERGE_COPY_DEST) for @params });
+bench(params_plan          => sub { $plan->merge($_) for @params });
+bench(dag_copy_source      => sub { hash_merge({}, $dag, MERGE_COPY_SOURCE) });
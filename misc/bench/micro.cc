@@ -0,0 +1,212 @@
+// Microbenchmarks of panda::lib functions and panda::string operations behind the XS entry points.
+// Each benchmark is calibrated to run for --time/REPEATS seconds, repeated REPEATS times, median ns/op is reported.
+// --json prints JSON lines ({"suite":"micro","name":...,"ns_per_op":...,"iterations":...}) instead of a table,
+// --out=FILE also appends them to FILE; compare two result files with misc/bench/diff.pl.
+// build: g++ -O2 -Isrc misc/bench/micro.cc src/panda/lib/*.cc -o micro -lpthread && ./micro [--json] [--out=FILE] [--time=SEC] [filter]
+#include <panda/lib.h>
+#include <panda/string.h>
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+using panda::string;
+using namespace panda::lib;
+
+typedef uint64_t (*bench_fn) (size_t iters); // returns checksum, so that the work can't be optimized out
+
+static double now () {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char   text[8192 + 64];   // printable pseudo-random bytes
+static string str_large, str_haystack, str_copy;
+static std::vector<int64_t> ints_small, ints_wide;
+static std::vector<string>  ints_text;
+static const size_t NUMS = 1024; // power of 2
+
+// inputs are shifted by (i & 7) so that calls are not loop invariant
+template <size_t LEN> static uint64_t b_string_hash   (size_t n) { uint64_t r = 0; for (size_t i = 0; i < n; ++i) r += string_hash(text + (i & 7), LEN); return r; }
+template <size_t LEN> static uint64_t b_string_hash32 (size_t n) { uint64_t r = 0; for (size_t i = 0; i < n; ++i) r += string_hash32(text + (i & 7), LEN); return r; }
+template <size_t LEN> static uint64_t b_hash64        (size_t n) { uint64_t r = 0; for (size_t i = 0; i < n; ++i) r += hash64(text + (i & 7), LEN); return r; }
+
+template <size_t LEN> static uint64_t b_crypt_xor (size_t n) {
+    static char dest[LEN];
+    uint64_t r = 0;
+    for (size_t i = 0; i < n; ++i) r += crypt_xor(text + (i & 7), dest, LEN, "secret key", 10, i % 10) + dest[i % LEN];
+    return r;
+}
+
+static uint64_t b_itoa_small (size_t n) {
+    char buf[MAX_INT_CHARS];
+    uint64_t r = 0;
+    for (size_t i = 0; i < n; ++i) r += itoa(ints_small[i & (NUMS - 1)], buf) - buf + buf[0];
+    return r;
+}
+
+static uint64_t b_itoa_wide (size_t n) {
+    char buf[MAX_INT_CHARS];
+    uint64_t r = 0;
+    for (size_t i = 0; i < n; ++i) r += itoa(ints_wide[i & (NUMS - 1)], buf) - buf + buf[0];
+    return r;
+}
+
+static uint64_t b_atoi (size_t n) {
+    uint64_t r = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const string& s = ints_text[i & (NUMS - 1)];
+        int64_t val = 0;
+        atoi(s.data(), s.length(), val);
+        r += val;
+    }
+    return r;
+}
+
+static uint64_t b_string_ctor_small (size_t n) { uint64_t r = 0; for (size_t i = 0; i < n; ++i) { string s(text + (i & 7), 10, string::COPY); r += s.length() + s[9]; } return r; }
+static uint64_t b_string_ctor_large (size_t n) { uint64_t r = 0; for (size_t i = 0; i < n; ++i) { string s(text + (i & 7), 200, string::COPY); r += s.length() + s[199]; } return r; }
+static uint64_t b_string_copy       (size_t n) { uint64_t r = 0; for (size_t i = 0; i < n; ++i) { string s(str_large); r += s.length() + s.data()[i & 7]; } return r; }
+static uint64_t b_string_substr     (size_t n) { uint64_t r = 0; for (size_t i = 0; i < n; ++i) { string s = str_large.substr(i & 7, 100); r += s.length() + s[0]; } return r; }
+static uint64_t b_string_compare    (size_t n) { uint64_t r = 0; for (size_t i = 0; i < n; ++i) r += str_large.compare(i & 1 ? str_copy : str_large) == 0; return r; }
+static uint64_t b_string_hash_memo  (size_t n) { uint64_t r = 0; for (size_t i = 0; i < n; ++i) r += str_large.hash(); return r; }
+
+static uint64_t b_string_append (size_t n) { // builds 1 KB of 16-byte pieces
+    uint64_t r = 0;
+    for (size_t i = 0; i < n; ++i) {
+        string s;
+        for (int j = 0; j < 64; ++j) s.append(text + j, 16);
+        r += s.length() + s[i & 1023];
+    }
+    return r;
+}
+
+static uint64_t b_string_append_int (size_t n) {
+    uint64_t r = 0;
+    for (size_t i = 0; i < n; ++i) {
+        string s;
+        for (int j = 0; j < 64; ++j) s.append_int(ints_wide[(i + j) & (NUMS - 1)]).append(',');
+        r += s.length();
+    }
+    return r;
+}
+
+static uint64_t b_string_find (size_t n) {
+    uint64_t r = 0;
+    for (size_t i = 0; i < n; ++i) r += str_haystack.find(i & 1 ? "needle" : "needlf");
+    return r;
+}
+
+static uint64_t b_utf8_validate (size_t n) { uint64_t r = 0; for (size_t i = 0; i < n; ++i) r += utf8_validate(text + (i & 7), 4096); return r; }
+
+struct bench_t {
+    const char* name;
+    bench_fn    fn;
+};
+
+static const bench_t benches[] = {
+    {"string_hash/8",        b_string_hash<8>},
+    {"string_hash/64",       b_string_hash<64>},
+    {"string_hash/1024",     b_string_hash<1024>},
+    {"string_hash32/8",      b_string_hash32<8>},
+    {"string_hash32/64",     b_string_hash32<64>},
+    {"string_hash32/1024",   b_string_hash32<1024>},
+    {"hash64/8",             b_hash64<8>},
+    {"hash64/64",            b_hash64<64>},
+    {"hash64/1024",          b_hash64<1024>},
+    {"crypt_xor/64",         b_crypt_xor<64>},
+    {"crypt_xor/4096",       b_crypt_xor<4096>},
+    {"itoa/small",           b_itoa_small},
+    {"itoa/wide",            b_itoa_wide},
+    {"atoi/wide",            b_atoi},
+    {"string/ctor_small",    b_string_ctor_small},
+    {"string/ctor_large",    b_string_ctor_large},
+    {"string/copy",          b_string_copy},
+    {"string/substr",        b_string_substr},
+    {"string/compare",       b_string_compare},
+    {"string/hash",          b_string_hash_memo},
+    {"string/append_1k",     b_string_append},
+    {"string/append_int_64", b_string_append_int},
+    {"string/find_4k",       b_string_find},
+    {"utf8_validate/4096",   b_utf8_validate},
+};
+
+static const int REPEATS = 5;
+static volatile uint64_t sink;
+
+static double measure (bench_fn fn, double run_time, size_t& iters) {
+    iters = 1;
+    for (;;) { // calibration: grow until a run takes long enough to time reliably
+        double start = now();
+        sink = fn(iters);
+        double elapsed = now() - start;
+        if (elapsed >= run_time / 4) {
+            iters = size_t(iters * run_time / elapsed) + 1;
+            break;
+        }
+        if (iters >= (size_t(1) << 40)) break; // optimized out, nothing to measure
+        iters *= elapsed > 0 && run_time / 4 / elapsed < 10 ? 2 : 10;
+    }
+    double results[REPEATS];
+    for (int r = 0; r < REPEATS; ++r) {
+        double start = now();
+        sink = fn(iters);
+        results[r] = (now() - start) / iters * 1e9;
+    }
+    std::sort(results, results + REPEATS);
+    return results[REPEATS / 2];
+}
+
+static void init () {
+    uint64_t seed = 42;
+    for (size_t i = 0; i < sizeof(text); ++i) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        text[i] = 'a' + (seed >> 33) % 26;
+    }
+    str_large.assign(text, 200, string::COPY);
+    str_copy.assign(text, 200, string::COPY);
+    str_haystack.assign(text, 4096, string::COPY).append("needle");
+    for (size_t i = 0; i < NUMS; ++i) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        ints_small.push_back(seed % 1000);
+        ints_wide.push_back(int64_t(seed >> (seed % 64)) * (seed & 1 ? 1 : -1));
+        ints_text.push_back(string().append_int(ints_wide.back()));
+    }
+}
+
+int main (int argc, char** argv) {
+    bool json = false;
+    const char* out    = NULL;
+    const char* filter = NULL;
+    double total_time  = 0.5;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--json")) json = true;
+        else if (!std::strncmp(argv[i], "--out=", 6)) out = argv[i] + 6;
+        else if (!std::strncmp(argv[i], "--time=", 7)) total_time = std::atof(argv[i] + 7);
+        else filter = argv[i];
+    }
+    FILE* outf = out && *out ? std::fopen(out, "a") : NULL;
+    if (out && *out && !outf) {
+        std::perror(out);
+        return 1;
+    }
+
+    init();
+    if (!json) std::printf("%-24s %12s %12s\n", "benchmark", "ns/op", "iterations");
+    for (size_t i = 0; i < sizeof(benches) / sizeof(*benches); ++i) {
+        if (filter && !std::strstr(benches[i].name, filter)) continue;
+        size_t iters;
+        double ns = measure(benches[i].fn, total_time / REPEATS, iters);
+        char line[256];
+        std::snprintf(line, sizeof(line), "{\"suite\":\"micro\",\"name\":\"%s\",\"ns_per_op\":%.3f,\"iterations\":%lu}\n",
+                      benches[i].name, ns, (unsigned long)iters);
+        if (json) std::fputs(line, stdout);
+        else      std::printf("%-24s %12.2f %12lu\n", benches[i].name, ns, (unsigned long)iters);
+        if (outf) std::fputs(line, outf);
+        std::fflush(stdout);
+    }
+    if (outf) std::fclose(outf);
+    return 0;
+}
@@ -0,0 +1,113 @@
+// panda::string vs std::string benchmark
+// build: g++ -O2 -Isrc misc/bench/string.cc src/panda/lib/memory.cc src/panda/lib/search.cc -o string_bench && ./string_bench
+#include <panda/string.h>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <ctime>
+
+extern "C" {
+    void* __libc_malloc  (size_t);
+    void* __libc_realloc (void*, size_t);
+}
+
+static unsigned long allocs = 0;
+static panda::lib::arena_allocator* request_arena = NULL; // emulates per-request arena: released after each iteration
+
+extern "C" void* malloc  (size_t size)            { ++allocs; return __libc_malloc(size); }
+extern "C" void* realloc (void* ptr, size_t size) { if (!ptr) ++allocs; return __libc_realloc(ptr, size); }
+
+static double now () {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+template <class String>
+static void bench (const char* name, const std::vector<std::string>& keys, int iters) {
+    unsigned long start_allocs = allocs;
+    double start = now();
+    size_t total = 0;
+    for (int i = 0; i < iters; ++i) {
+        for (size_t j = 0; j < keys.size(); ++j) {
+            String s(keys[j].data(), keys[j].length());
+            String copy = s;
+            copy += 'x';
+            total += copy.length();
+        }
+        if (request_arena) request_arena->reset();
+    }
+    double elapsed = now() - start;
+    unsigned long ops = (unsigned long)iters * keys.size();
+    std::printf("%-28s %8.2f Mops/s  %6.3f allocs/op  (%lu)\n", name, ops / elapsed / 1e6, double(allocs - start_allocs) / ops, (unsigned long)total);
+}
+
+struct panda_copy : panda::string {
+    panda_copy (const char* p, size_t len) : panda::string(p, len, COPY) {}
+};
+
+static void run (const char* title, size_t minlen, size_t maxlen) {
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < 1000; ++i) keys.push_back(std::string(minlen + i % (maxlen - minlen + 1), 'a' + i % 26));
+    std::printf("%s (%lu-%lu bytes)\n", title, (unsigned long)minlen, (unsigned long)maxlen);
+    bench<std::string>("  std::string", keys, 2000);
+    bench<panda_copy>("  panda::string(COPY)", keys, 2000);
+    {
+        panda::lib::string_allocator_guard guard(panda::lib::pool_allocator::instance());
+        bench<panda_copy>("  panda::string(COPY) pool", keys, 2000);
+    }
+    {
+        panda::lib::arena_allocator arena;
+        panda::lib::string_allocator_guard guard(&arena);
+        request_arena = &arena;
+        bench<panda_copy>("  panda::string(COPY) arena", keys, 2000);
+        request_arena = NULL;
+    }
+}
+
+template <class String>
+static void bench_substr (const char* name, const String& msg, size_t field_len, int iters) {
+    unsigned long start_allocs = allocs;
+    double start = now();
+    size_t total = 0;
+    unsigned long ops = 0;
+    for (int i = 0; i < iters; ++i) {
+        for (size_t pos = 0; pos + field_len <= msg.length(); pos += field_len, ++ops) {
+            String field = msg.substr(pos, field_len);
+            total += field.length();
+        }
+    }
+    double elapsed = now() - start;
+    std::printf("%-28s %8.2f Mops/s  %6.3f allocs/op  (%lu)\n", name, ops / elapsed / 1e6, double(allocs - start_allocs) / ops, (unsigned long)total);
+}
+
+template <class String>
+static void bench_find (const char* name, const std::string& src, int iters) {
+    String hay(src.data(), src.length());
+    double start = now();
+    size_t total = 0;
+    for (int i = 0; i < iters; ++i) {
+        total += hay.find("ERROR: disk", 0);
+        total += hay.rfind("request_id=", String::npos);
+        total += hay.find_first_of("\r\n\t", 0);
+    }
+    std::printf("%-28s %8.2f Mops/s  (%lu)\n", name, iters * 3 / (now() - start) / 1e6, (unsigned long)total);
+}
+
+int main () {
+    run("short keys", 1, panda::string::MAX_SSO_CHARS - 1);
+    run("long keys", 32, 128);
+
+    std::printf("substr of 1MB message (100 bytes fields)\n");
+    bench_substr("  std::string", std::string(1024*1024, 'x'), 100, 20);
+    bench_substr("  panda::string", panda::string(1024*1024, 'x'), 100, 20);
+
+    std::string log;
+    while (log.length() < 8192) log += "2014-10-31 12:00:00 INFO: request processed in 0.001s from 127.0.0.1 ";
+    log += "ERROR: disk full\nrequest_id=12345";
+    log += std::string(4096, ' ');
+    std::printf("find/rfind/find_first_of in 12KB log buffer\n");
+    bench_find<std::string>("  std::string", log, 20000);
+    bench_find<panda::string>("  panda::string", log, 20000);
+    return 0;
+}
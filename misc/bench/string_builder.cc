@@ -0,0 +1,126 @@
+// string_builder vs repeated append benchmark: builds ~8MB response from small pieces
+// build: g++ -O2 -Isrc misc/bench/string_builder.cc src/panda/lib/memory.cc src/panda/lib/search.cc -o string_builder_bench && ./string_builder_bench
+#include <panda/string_builder.h>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+
+extern "C" {
+    void* __libc_malloc  (size_t);
+    void* __libc_realloc (void*, size_t);
+}
+
+static unsigned long allocs   = 0;
+static unsigned long reallocs = 0;
+
+extern "C" void* malloc  (size_t size)            { ++allocs; return __libc_malloc(size); }
+extern "C" void* realloc (void* ptr, size_t size) { if (ptr) ++reallocs; else ++allocs; return __libc_realloc(ptr, size); }
+
+static double now () {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static std::vector<std::string> pieces;
+static panda::string            body; // large part, linked by builder instead of copying
+
+struct std_out {
+    std::string s;
+    void   add  (const std::string& p) { s += p; }
+    void   add_body ()                 { s.append(body.data(), body.length()); }
+    size_t done ()                     { return s.length(); }
+};
+
+struct panda_out {
+    panda::string s;
+    void   add  (const std::string& p) { s.append(p.data(), p.length()); }
+    void   add_body ()                 { s.append(body); }
+    size_t done ()                     { return s.length(); }
+};
+
+struct builder_out {
+    panda::string_builder b;
+    void   add  (const std::string& p) { b.append(p.data(), p.length()); }
+    void   add_body ()                 { b.append(body); }
+    size_t done ()                     { return b.str().length(); }
+};
+
+struct builder_iov_out {
+    panda::string_builder b;
+    void   add  (const std::string& p) { b.append(p.data(), p.length()); }
+    void   add_body ()                 { b.append(body); }
+    size_t done () {
+        static int fd = open("/dev/null", O_WRONLY);
+        struct iovec v[IOV_MAX];
+        size_t total = 0, cnt;
+        for (size_t from = 0; (cnt = b.iov(v, IOV_MAX, from)); from += cnt) total += writev(fd, v, cnt);
+        return total;
+    }
+};
+
+template <class Out>
+static void bench (const char* name, int iters) {
+    unsigned long start_allocs = allocs, start_reallocs = reallocs;
+    double start = now();
+    size_t total = 0;
+    for (int i = 0; i < iters; ++i) {
+        Out out;
+        for (size_t j = 0; j < pieces.size(); ++j) {
+            out.add(pieces[j]);
+            if (j % 10000 == 0) out.add_body();
+        }
+        total += out.done();
+    }
+    double elapsed = now() - start;
+    std::printf("%-28s %8.2f ms  %8.1f allocs  %8.1f reallocs  (%lu MB)\n", name, elapsed / iters * 1000,
+                double(allocs - start_allocs) / iters, double(reallocs - start_reallocs) / iters, (unsigned long)(total / iters >> 20));
+}
+
+template <class String>
+static void bench_line (const char* name, int iters) {
+    String key("content-length"), value("1234567"), ret;
+    unsigned long start_allocs = allocs;
+    double start = now();
+    size_t total = 0;
+    for (int i = 0; i < iters; ++i) {
+        ret = key + ": " + value + "\r\n" + key + ": " + value + "\r\n";
+        total += ret.length();
+    }
+    std::printf("%-28s %8.2f Mops/s  %6.3f allocs/op  (%lu)\n", name, iters / (now() - start) / 1e6, double(allocs - start_allocs) / iters, (unsigned long)total);
+}
+
+static void bench_line_builder (const char* name, int iters) {
+    panda::string key("content-length"), value("1234567"), ret;
+    unsigned long start_allocs = allocs;
+    double start = now();
+    size_t total = 0;
+    for (int i = 0; i < iters; ++i) {
+        panda::string_builder b;
+        b << key << ": " << value << "\r\n" << key << ": " << value << "\r\n";
+        ret = b.str();
+        total += ret.length();
+    }
+    std::printf("%-28s %8.2f Mops/s  %6.3f allocs/op  (%lu)\n", name, iters / (now() - start) / 1e6, double(allocs - start_allocs) / iters, (unsigned long)total);
+}
+
+int main () {
+    for (size_t i = 0; i < 200000; ++i) pieces.push_back(std::string(8 + i * 7 % 57, 'a' + i % 26));
+    body.assign(std::string(64 * 1024, 'b').c_str(), 64 * 1024, panda::string::COPY);
+
+    std::printf("200000 small appends + 20 x 64KB bodies\n");
+    bench<std_out>("  std::string +=", 20);
+    bench<panda_out>("  panda::string append", 20);
+    bench<builder_out>("  string_builder + str()", 20);
+    bench<builder_iov_out>("  string_builder + writev", 20);
+
+    std::printf("header line via operator+ vs builder\n");
+    bench_line<std::string>("  std::string operator+", 1000000);
+    bench_line<panda::string>("  panda::string operator+", 1000000);
+    bench_line_builder("  string_builder", 1000000);
+    return 0;
+}
@@ -0,0 +1,76 @@
+// panda::string_map vs std::unordered_map<std::string> benchmark
+// build: g++ -O2 -Isrc misc/bench/string_map.cc src/panda/lib/*.cc -o string_map_bench && ./string_map_bench
+#include <panda/string_map.h>
+#include <tr1/unordered_map>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <ctime>
+
+extern "C" {
+    void* __libc_malloc  (size_t);
+    void* __libc_calloc  (size_t, size_t);
+    void* __libc_realloc (void*, size_t);
+}
+
+static unsigned long allocs = 0;
+static unsigned long bytes  = 0;
+
+extern "C" void* malloc  (size_t size)            { ++allocs; bytes += size; return __libc_malloc(size); }
+extern "C" void* calloc  (size_t n, size_t size)  { ++allocs; bytes += n * size; return __libc_calloc(n, size); }
+extern "C" void* realloc (void* ptr, size_t size) { if (!ptr) ++allocs; bytes += size; return __libc_realloc(ptr, size); }
+
+static double now () {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const int LOOKUPS = 20;
+
+template <class Map, class Key>
+static void bench (const char* name, const std::vector<Key>& keys, const std::vector<Key>& probes) {
+    unsigned long start_allocs = allocs, start_bytes = bytes;
+    double start = now();
+    Map* map = new Map();
+    for (size_t i = 0; i < keys.size(); ++i) (*map)[keys[i]] = i;
+    double inserted = now();
+    unsigned long map_allocs = allocs - start_allocs, map_bytes = bytes - start_bytes;
+    size_t found = 0;
+    for (int n = 0; n < LOOKUPS; ++n)
+        for (size_t i = 0; i < probes.size(); ++i) found += map->find(probes[i]) != map->end();
+    double looked = now();
+    delete map;
+    std::printf("%-36s insert %6.2f Mops/s  lookup %6.2f Mops/s  %7lu allocs  %5.1f bytes/key allocated  (%lu)\n", name,
+                keys.size() / (inserted - start) / 1e6, probes.size() * LOOKUPS / (looked - inserted) / 1e6,
+                map_allocs, double(map_bytes) / keys.size(), (unsigned long)found);
+}
+
+struct panda_hash {
+    size_t operator() (const panda::string& s) const { return s.hash(); }
+};
+
+int main () {
+    const size_t N = 200000;
+    std::vector<std::string>   std_keys, std_probes;
+    std::vector<panda::string> keys, probes, copies;
+    for (size_t i = 0; i < N; ++i) {
+        char buf[64];
+        int len = std::sprintf(buf, "session:%08lx:user:%lu", (unsigned long)(i * 2654435761U), (unsigned long)i);
+        std_keys.push_back(std::string(buf, len));
+        keys.push_back(panda::string(buf, len, panda::string::COPY));
+    }
+    for (size_t i = 0; i < N; ++i) {
+        size_t j = i * 7919 % N;
+        std_probes.push_back(std_keys[j]);
+        probes.push_back(panda::string(std_keys[j].data(), std_keys[j].length(), panda::string::COPY)); // own buffers, hash is not memoized yet
+        copies.push_back(keys[j]); // share buffers (and memoized hashes) with inserted keys
+    }
+
+    std::printf("%lu keys, %d lookups each\n", (unsigned long)N, LOOKUPS);
+    bench<std::tr1::unordered_map<std::string, size_t> >("  unordered_map<std::string>", std_keys, std_probes);
+    bench<std::tr1::unordered_map<panda::string, size_t, panda_hash> >("  unordered_map<panda::string>", keys, probes);
+    bench<panda::string_map<size_t> >("  string_map", keys, probes);
+    bench<panda::string_map<size_t> >("  string_map (probes share keys)", keys, copies);
+    return 0;
+}
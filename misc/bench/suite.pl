@@ -0,0 +1,131 @@
+#!/usr/bin/perl
+# Benchmark of XS entry points on fixed data: clone/fclone/compare/merge on realistic shapes, then scalar functions.
+# Each benchmark is run by Benchmark::countit for --time/REPEATS CPU seconds (0.1 at least) REPEATS times, median ns/op is reported.
+# --json prints JSON lines ({"suite":"perl","name":...,"ns_per_op":...,"iterations":...}) instead of a table,
+# --out=FILE also appends them to FILE; compare two result files with misc/bench/diff.pl.
+# run: perl -Mblib misc/bench/suite.pl [--json] [--out=FILE] [--time=SEC] [filter]
+use strict;
+use warnings;
+use Benchmark qw/countit :hireswallclock/;
+use Getopt::Long;
+use List::Util qw/max/;
+use Panda::Lib qw/
+    clone fclone clone_many fclone_many clone_times compare fingerprint hash_merge merge hash_merge_many merge_many
+    string_hash string_hash32 hash64 hash64_batch crypt_xor is_ascii utf8_validate utf8_length itoa itoa_join atoi
+    encode_utf8_struct decode_utf8_struct :const
+/;
+
+use constant REPEATS => 3;
+
+my ($json, $out, $time) = (0, undef, 1);
+GetOptions('json' => \$json, 'out=s' => \$out, 'time=f' => \$time) or die "usage: $0 [--json] [--out=FILE] [--time=SEC] [filter]\n";
+my $filter = shift;
+
+srand(42); # same data on every run
+
+my $word = sub { join '', map { chr(97 + int rand 26) } 1..(3 + int rand 10) };
+
+# shapes
+my %shapes;
+
+# small nested config, the most common case
+$shapes{config} = {
+    name => 'app', debug => 0, version => '1.2.3',
+    db   => {host => 'localhost', port => 5432, user => 'app', opts => {timeout => 10, retries => [1, 2, 5]}},
+    log  => {level => 'info', targets => [{type => 'file', path => '/var/log/app.log'}, {type => 'syslog'}]},
+    map { ("opt$_" => $word->()) } 1..20,
+};
+
+# wide hash of scalars and small records
+$shapes{wide_hash} = {map { ("key$_" => $_ % 3 ? $word->() : {id => $_, tags => [$_, $_ + 1]}) } 1..10000};
+
+# deep tree: chain of 1000 levels, each with a few scalar siblings
+{
+    my $node = {leaf => 1};
+    $node = {level => $_, name => $word->(), child => $node, list => [$_, $_ * 2]} for 1..1000;
+    $shapes{deep_tree} = $node;
+}
+
+# DAG: 12 levels where both branches of a node refer to the same node of the level below (4096 paths, 12 nodes)
+{
+    my $node = {leaf => 'bottom', data => [1..10]};
+    $node = {level => $_, left => $node, right => $node, name => $word->()} for 1..12;
+    $shapes{dag} = $node;
+}
+
+# large array of records, wrapped in a hash so that it can be merged
+$shapes{large_array} = {items => [map { {id => $_, name => $word->(), score => rand(), flags => [$_ % 2, $_ % 3]} } 1..20000]};
+
+my @benches;
+sub bench { push @benches, [@_] }
+
+for my $shape (qw/config wide_hash deep_tree dag large_array/) {
+    my $data  = $shapes{$shape};
+    my $copy  = fclone($data);
+    # every other key changed, like a layer over defaults
+    my @keys  = sort keys %$data;
+    my $layer = {map { $_ => (ref $data->{$_} ? fclone($data->{$_}) : 'changed') } @keys[grep { !($_ % 2) } 0..$#keys]};
+    bench("clone/$shape",      sub { clone($data) });
+    bench("fclone/$shape",     sub { fclone($data) });
+    bench("compare/$shape",    sub { compare($data, $copy) or die });
+    bench("hash_merge/$shape", sub { hash_merge($data, $layer, MERGE_COPY_DEST) });
+    bench("merge/$shape",      sub { merge($data, $layer, MERGE_COPY) });
+}
+
+# batch and template interfaces
+{
+    my $cfg    = $shapes{config};
+    my @list   = map { fclone($cfg) } 1..100;
+    my @layers = map { {opt1 => $_, db => {port => $_}} } 1..10;
+    my $plan   = Panda::Lib::MergePlan->new($cfg);
+    bench('clone_many/config_x100',      sub { clone_many(\@list) });
+    bench('fclone_many/config_x100',     sub { fclone_many(\@list) });
+    bench('clone_times/config_x100',     sub { clone_times($cfg, 100) });
+    bench('hash_merge_many/config_x10',  sub { hash_merge_many($cfg, \@layers, MERGE_COPY_DEST) });
+    bench('merge_many/config_x10',       sub { merge_many($cfg, \@layers, MERGE_COPY_DEST) });
+    bench('merge_plan/config',           sub { $plan->merge($layers[0]) });
+    bench('fingerprint/large_array',     sub { fingerprint($shapes{large_array}) });
+}
+
+# scalar functions
+{
+    my $short = 'short key';
+    my $long  = join '', map { $word->() } 1..500;
+    my $utf8  = "\xd1\x82\xd0\xb5\xd0\xba\xd1\x81\xd1\x82 \xe2\x82\xac " x 400;
+    my @nums  = map { int(rand(2**40)) - 2**39 } 1..1000;
+    my @strs  = map { $word->() } 1..1000;
+    my $chars = {map { ("k$_" => "\x{442}\x{435}\x{441}\x{442} $_") } 1..1000};
+    bench('string_hash/short',      sub { string_hash($short) });
+    bench('string_hash/long',       sub { string_hash($long) });
+    bench('string_hash32/short',    sub { string_hash32($short) });
+    bench('string_hash32/long',     sub { string_hash32($long) });
+    bench('hash64/long',            sub { hash64($long) });
+    bench('hash64_batch/1000',      sub { hash64_batch(\@strs) });
+    bench('crypt_xor/long',         sub { crypt_xor($long, 'secret key') });
+    bench('is_ascii/long',          sub { is_ascii($long) });
+    bench('utf8_validate/utf8',     sub { utf8_validate($utf8) });
+    bench('utf8_length/utf8',       sub { utf8_length($utf8) });
+    bench('itoa',                   sub { itoa(-1234567890123) });
+    bench('itoa_join/1000',         sub { itoa_join(\@nums) });
+    bench('atoi',                   sub { atoi('-1234567890123') });
+    bench('utf8_struct/1000',       sub { encode_utf8_struct($chars); decode_utf8_struct($chars) });
+    bench('timeout',                sub { Panda::Lib::timeout(sub { 1 }, 1) });
+}
+
+my $fh;
+if (defined $out and length $out) { open $fh, '>>', $out or die "$out: $!\n" }
+
+printf "%-32s %12s %12s\n", 'benchmark', 'ns/op', 'iterations' unless $json;
+for my $bench (@benches) {
+    my ($name, $code) = @$bench;
+    next if defined $filter and index($name, $filter) < 0;
+    my @results = sort { $a->[0] <=> $b->[0] } map {
+        my $t = countit(max(0.1, $time / REPEATS), $code);
+        [$t->real / $t->iters * 1e9, $t->iters]; # cpu times are too coarse, 10ms ticks
+    } 1..REPEATS;
+    my ($ns, $iters) = @{$results[int(REPEATS / 2)]};
+    my $line = sprintf qq({"suite":"perl","name":"%s","ns_per_op":%.3f,"iterations":%d}\n), $name, $ns, $iters;
+    if ($json) { print $line }
+    else       { printf "%-32s %12.2f %12d\n", $name, $ns, $iters }
+    print $fh $line if $fh;
+}
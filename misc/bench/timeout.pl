@@ -0,0 +1,40 @@
+#!/usr/bin/perl
+# timeout() on many short guarded calls against former alarm-based implementation
+# run: perl -Mblib misc/bench/timeout.pl [calls]
+use strict;
+use warnings;
+use Time::HiRes qw/time/;
+use Panda::Lib;
+
+my $calls = shift || 100000;
+
+sub alarm_timeout {
+    my ($sub, $timeout) = @_;
+    my ($ok, $alarm);
+    local $SIG{ALRM} = sub {$alarm = 1; die "ALARM!"};
+    Time::HiRes::alarm($timeout || 1);
+    eval {
+        $ok = eval { $sub->(); 1 };
+        die $@ if !$ok and !$alarm;
+        Time::HiRes::alarm(0);
+    };
+    return if $alarm;
+    die $@ if !$ok;
+    return 1;
+}
+
+my $x = 0;
+my $work = sub { $x += $_ for 1..10 };
+
+sub bench {
+    my ($name, $sub) = @_;
+    my $start = time;
+    $sub->() for 1..$calls;
+    printf "%-24s %8.2f us/call\n", $name, (time - $start) / $calls * 1e6;
+}
+
+print "$calls calls\n";
+bench('unguarded',      sub { $work->() });
+bench('alarm_timeout',  sub { alarm_timeout($work, 1) });
+bench('timeout',        sub { Panda::Lib::timeout($work, 1) });
+bench('timeout_nested', sub { Panda::Lib::timeout(sub { Panda::Lib::timeout($work, 0.5) }, 1) });
@@ -0,0 +1,35 @@
+#!/usr/bin/perl
+# is_ascii/utf8_validate/utf8_length vs perl built-ins
+# run: perl -Mblib misc/bench/utf8.pl [size] [iterations]
+use strict;
+use warnings;
+use Time::HiRes qw/time/;
+use Encode();
+use Panda::Lib qw/is_ascii utf8_validate utf8_length/;
+
+my $size  = shift || 1_000_000;
+my $iters = shift || 200;
+
+my %data = (ascii => 'a' x $size, mixed => substr("lorem ipsum \xd1\x82\xd0\xb5\xd0\xba\xd1\x81\xd1\x82 \xe2\x82\xac " x $size, 0, $size));
+$data{mixed} =~ s/[\x80-\xbf]+\z//;
+$data{mixed} =~ s/[\xc0-\xff]\z//;
+
+sub bench {
+    my ($name, $sub) = @_;
+    my $start = time;
+    $sub->() for 1..$iters;
+    my $t = (time - $start) / $iters;
+    printf "%-28s %10.2f us %8.2f GB/s\n", $name, $t * 1e6, $size / $t / 1e9;
+}
+
+print "$size bytes, $iters iterations\n";
+for my $kind (qw/ascii mixed/) {
+    my $str = $data{$kind};
+    bench("is_ascii_$kind",           sub { is_ascii($str) });
+    bench("regex_ascii_$kind",        sub { $str !~ /[\x80-\xff]/ });
+    bench("utf8_validate_$kind",      sub { utf8_validate($str) or die });
+    bench("utf8_decode_copy_$kind",   sub { my $c = $str; utf8::decode($c) or die });
+    bench("encode_strict_$kind",      sub { Encode::decode('UTF-8', $str, Encode::FB_CROAK | Encode::LEAVE_SRC) });
+    bench("utf8_length_$kind",        sub { utf8_length($str) });
+    bench("decode_length_$kind",      sub { my $c = $str; utf8::decode($c); length $c });
+}
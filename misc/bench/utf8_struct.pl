@@ -0,0 +1,69 @@
+#!/usr/bin/perl
+# encode_utf8_struct/decode_utf8_struct benchmark against former pure-perl implementation, on a JSON-like request
+# run: perl -Mblib misc/bench/utf8_struct.pl [records] [iterations]
+use strict;
+use warnings;
+use Time::HiRes qw/time/;
+use Encode qw/encode_utf8 decode_utf8/;
+use Storable qw/dclone/;
+use Panda::Lib;
+
+my $records = shift || 1000;
+my $iters   = shift || 100;
+
+sub perl_encode_utf8_struct {
+    my $data = shift;
+    if (ref($data) eq 'HASH') {
+        foreach my $v (values %$data) {
+            if (ref $v) { perl_encode_utf8_struct($v) }
+            elsif (utf8::is_utf8($v)) { $v = Encode::encode_utf8($v) }
+        }
+    }
+    elsif (ref($data) eq 'ARRAY') {
+        map {
+            if (ref $_) { perl_encode_utf8_struct($_) }
+            elsif (utf8::is_utf8($_)) { $_ = Encode::encode_utf8($_) }
+        } @$data;
+    }
+}
+
+sub perl_decode_utf8_struct {
+    my $data = shift;
+    if (ref($data) eq 'HASH') {
+        foreach my $v (values %$data) {
+            if (ref $v) { perl_decode_utf8_struct($v) }
+            elsif (!utf8::is_utf8($v)) { $v = Encode::decode_utf8($v) }
+        }
+    }
+    elsif (ref($data) eq 'ARRAY') {
+        map {
+            if (ref $_) { perl_decode_utf8_struct($_) }
+            elsif (!utf8::is_utf8($_)) { $_ = Encode::decode_utf8($_) }
+        } @$data;
+    }
+}
+
+# mostly ASCII with some non-ASCII text, as in typical requests
+my $text = encode_utf8("\x{41f}\x{440}\x{438}\x{432}\x{435}\x{442}, \x{43c}\x{438}\x{440}");
+my $bytes = {
+    id      => 12345,
+    action  => 'update',
+    records => [map { {id => $_, name => "name$_", title => $_ % 5 ? "title $_" : "$text $_", tags => ['a', 'b', "c$_"],
+                       props => {color => 'red', size => $_, note => $_ % 10 ? 'ok' : $text}} } 1..$records],
+};
+my $chars = dclone($bytes);
+Panda::Lib::decode_utf8_struct($chars);
+
+sub bench {
+    my ($name, $source, $sub) = @_;
+    my @copies = map { dclone($source) } 1..$iters; # conversion is in place, copies are not timed
+    my $start = time;
+    $sub->($_) for @copies;
+    printf "%-14s %10.2f us\n", $name, (time - $start) / $iters * 1e6;
+}
+
+print "$records records, $iters iterations\n";
+bench(perl_decode => $bytes, \&perl_decode_utf8_struct);
+bench(xs_decode   => $bytes, \&Panda::Lib::decode_utf8_struct);
+bench(perl_encode => $chars, \&perl_encode_utf8_struct);
+bench(xs_encode   => $chars, \&Panda::Lib::encode_utf8_struct);
@@ -1,2 +1,6 @@
 #pragma once
 #include <panda/lib/lib.h>
+#include <panda/lib/hash.h>
+#include <panda/lib/memory.h>
+#include <panda/lib/deadline.h>
+#include <panda/lib/utf8.h>
@@ -0,0 +1,125 @@
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <panda/lib/lib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define PANDA_CRYPT_X86
+#  include <immintrin.h>
+#endif
+
+namespace panda { namespace lib {
+
+// Kernels xor data with the key pre-expanded into a pattern (key repeated to klen + MAX_WIDTH bytes). For key offset k the next
+// W bytes of key stream are just pattern[k..k+W), after which k advances by W % klen - no division per byte.
+static const size_t MAX_WIDTH = 32;
+
+typedef size_t (*xor_fn) (const unsigned char* src, unsigned char* dst, size_t len, const unsigned char* pat, size_t klen, size_t k);
+
+static inline size_t xor_tail (const unsigned char* src, unsigned char* dst, size_t len, const unsigned char* pat, size_t klen, size_t k) {
+    for (size_t i = 0; i < len; ++i) {
+        dst[i] = src[i] ^ pat[k];
+        if (++k == klen) k = 0;
+    }
+    return k;
+}
+
+static size_t xor_scalar (const unsigned char* src, unsigned char* dst, size_t len, const unsigned char* pat, size_t klen, size_t k) {
+    const size_t step = 8 % klen;
+    for (; len >= 8; len -= 8, src += 8, dst += 8) {
+        uint64_t d, p;
+        std::memcpy(&d, src, 8);
+        std::memcpy(&p, pat + k, 8);
+        d ^= p;
+        std::memcpy(dst, &d, 8);
+        k += step;
+        if (k >= klen) k -= klen;
+    }
+    return xor_tail(src, dst, len, pat, klen, k);
+}
+
+#ifdef PANDA_CRYPT_X86
+
+__attribute__((target("sse2")))
+static size_t xor_sse2 (const unsigned char* src, unsigned char* dst, size_t len, const unsigned char* pat, size_t klen, size_t k) {
+    const size_t step = 16 % klen;
+    for (; len >= 16; len -= 16, src += 16, dst += 16) {
+        __m128i d = _mm_loadu_si128((const __m128i*)src);
+        __m128i p = _mm_loadu_si128((const __m128i*)(pat + k));
+        _mm_storeu_si128((__m128i*)dst, _mm_xor_si128(d, p));
+        k += step;
+        if (k >= klen) k -= klen;
+    }
+    return xor_tail(src, dst, len, pat, klen, k);
+}
+
+__attribute__((target("avx2")))
+static size_t xor_avx2 (const unsigned char* src, unsigned char* dst, size_t len, const unsigned char* pat, size_t klen, size_t k) {
+    const size_t step = 32 % klen;
+    for (; len >= 32; len -= 32, src += 32, dst += 32) {
+        __m256i d = _mm256_loadu_si256((const __m256i*)src);
+        __m256i p = _mm256_loadu_si256((const __m256i*)(pat + k));
+        _mm256_storeu_si256((__m256i*)dst, _mm256_xor_si256(d, p));
+        k += step;
+        if (k >= klen) k -= klen;
+    }
+    return xor_tail(src, dst, len, pat, klen, k);
+}
+
+static xor_fn select_kernel () {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return xor_avx2;
+    if (__builtin_cpu_supports("sse2")) return xor_sse2;
+    return xor_scalar;
+}
+
+#else
+
+static xor_fn select_kernel () { return xor_scalar; }
+
+#endif
+
+// on first call, so that crypt_xor works from static initializers of other translation units
+static xor_fn xor_impl () {
+    static const xor_fn fn = select_kernel();
+    return fn;
+}
+
+size_t crypt_xor (const char* source, char* dest, size_t len, const char* key, size_t klen, size_t koff) {
+    if (!klen) {
+        if (dest != source) std::memmove(dest, source, len);
+        return 0;
+    }
+    koff %= klen;
+    const unsigned char* src = (const unsigned char*)source;
+    unsigned char*       dst = (unsigned char*)dest;
+    if (len < 32) return xor_tail(src, dst, len, (const unsigned char*)key, klen, koff); // expanding the key costs more
+
+    unsigned char  stack_pat[256];
+    size_t         patlen = klen + MAX_WIDTH;
+    unsigned char* heap   = patlen <= sizeof(stack_pat) ? NULL : (unsigned char*)std::malloc(patlen);
+    if (patlen > sizeof(stack_pat) && !heap) throw std::bad_alloc();
+    unsigned char* pat    = heap ? heap : stack_pat;
+    for (size_t i = 0, k = 0; i < patlen; ++i) {
+        pat[i] = key[k];
+        if (++k == klen) k = 0;
+    }
+
+    koff = xor_impl()(src, dst, len, pat, klen, koff);
+    std::free(heap);
+    return koff;
+}
+
+char* crypt_xor (const char* source, size_t slen, const char* key, size_t klen, char* dest) {
+    char* buf = dest;
+    if (!buf) {
+        buf = (char*) std::malloc(slen+1); // space for '0'
+        if (!buf) throw std::bad_alloc();
+    }
+    crypt_xor(source, buf, slen, key, klen, 0);
+    buf[slen] = 0;
+    return buf;
+}
+
+}}
@@ -0,0 +1,176 @@
+#include <time.h>
+#include <signal.h>
+#include <stdexcept>
+#include <panda/lib/deadline.h>
+
+namespace panda { namespace lib {
+
+#ifdef SIGRTMIN
+const int deadline_stack::signo = SIGRTMIN; // not used by anyone else, doesn't interfere with alarm()
+#else
+const int deadline_stack::signo = SIGALRM;
+#endif
+
+uint64_t monotonic_ns () {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// watchdog state, guarded by mutex. <wakeup> is also read without it by owners: it's the time watchdog sleeps until, 0 while
+// it is awake and scanning (then it may miss new deadline and must be woken)
+static pthread_mutex_t               mutex   = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t                cond;
+static bool                          started = false;
+static uint64_t                      wakeup  = deadline_stack::NONE;
+static std::vector<deadline_stack*>* stacks; // never freed: watchdog may still run during global destruction
+static pthread_key_t                 key;
+static pthread_once_t                once    = PTHREAD_ONCE_INIT;
+
+void deadline_stack::_init () {
+    stacks = new std::vector<deadline_stack*>();
+    pthread_key_create(&key, _destroy);
+    pthread_atfork(_atfork_prepare, _atfork_parent, _atfork_child);
+}
+
+deadline_stack& deadline_stack::instance () {
+    pthread_once(&once, _init);
+    deadline_stack* self = static_cast<deadline_stack*>(pthread_getspecific(key));
+    if (!self) {
+        self = new deadline_stack();
+        pthread_setspecific(key, self);
+    }
+    return *self;
+}
+
+deadline_stack::deadline_stack () : _earliest(NONE), _signaled(NONE), _thread(pthread_self()) {
+    pthread_mutex_lock(&mutex);
+    stacks->push_back(this);
+    pthread_mutex_unlock(&mutex);
+}
+
+deadline_stack::~deadline_stack () {
+    pthread_mutex_lock(&mutex);
+    for (size_t i = 0; i < stacks->size(); ++i) if ((*stacks)[i] == this) {
+        stacks->erase(stacks->begin() + i);
+        break;
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+void deadline_stack::_destroy (void* stack) { delete static_cast<deadline_stack*>(stack); }
+
+void deadline_stack::push (uint64_t timeout_ns) {
+    uint64_t now = monotonic_ns();
+    frame f;
+    f.deadline = timeout_ns < NONE - now ? now + timeout_ns : NONE - 1;
+    f.earliest = _frames.empty() || f.deadline < _frames.back().earliest ? f.deadline : _frames.back().earliest;
+    f.fired    = false;
+    _frames.push_back(f);
+    _set_earliest(f.earliest);
+}
+
+bool deadline_stack::pop () {
+    bool fired = _frames.back().fired;
+    _frames.pop_back();
+    _set_earliest(_frames.empty() ? NONE : _frames.back().earliest);
+    return fired;
+}
+
+size_t deadline_stack::fire () {
+    uint64_t now = monotonic_ns();
+    for (size_t i = 0; i < _frames.size(); ++i) if (!_frames[i].fired && _frames[i].deadline <= now) {
+        _frames[i].fired = true;
+        return i + 1;
+    }
+    return 0;
+}
+
+// Owner writes its earliest deadline, then reads wakeup; watchdog sets wakeup to 0, then reads deadlines (all seq_cst). So either
+// watchdog sees the new deadline, or the owner sees that watchdog sleeps too long (or is scanning) and wakes it up.
+void deadline_stack::_set_earliest (uint64_t earliest) {
+    if (earliest == _earliest) return;
+    __atomic_store_n(&_earliest, earliest, __ATOMIC_SEQ_CST);
+    if (earliest == NONE) return; // no disarming, watchdog will find out
+    uint64_t next = __atomic_load_n(&wakeup, __ATOMIC_SEQ_CST);
+    if (next && next <= earliest) return;
+    pthread_mutex_lock(&mutex);
+    if (!started) {
+        try { _start(); }
+        catch (...) {
+            pthread_mutex_unlock(&mutex);
+            throw;
+        }
+    }
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+void deadline_stack::_start () {
+    pthread_condattr_t cattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond, &cattr);
+    pthread_condattr_destroy(&cattr);
+
+    // watchdog must not get any process-directed signals: handlers (perl's ones too) expect to run in their threads
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    int err = pthread_create(&thread, &attr, _watchdog, NULL);
+    pthread_attr_destroy(&attr);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (err) throw std::runtime_error("deadline_stack: can't start watchdog thread");
+    started = true;
+}
+
+void* deadline_stack::_watchdog (void*) {
+    pthread_mutex_lock(&mutex);
+    for (;;) {
+        __atomic_store_n(&wakeup, 0, __ATOMIC_SEQ_CST);
+        uint64_t now = monotonic_ns(), next = NONE;
+        for (size_t i = 0; i < stacks->size(); ++i) {
+            deadline_stack* stack = (*stacks)[i];
+            uint64_t earliest = __atomic_load_n(&stack->_earliest, __ATOMIC_SEQ_CST);
+            if (earliest == stack->_signaled) continue; // no deadlines or the owner already knows about this one
+            if (earliest <= now) {
+                stack->_signaled = earliest;
+                pthread_kill(stack->_thread, signo);
+            }
+            else if (earliest < next) next = earliest;
+        }
+        __atomic_store_n(&wakeup, next, __ATOMIC_SEQ_CST);
+        if (next == NONE) pthread_cond_wait(&cond, &mutex);
+        else {
+            timespec ts;
+            ts.tv_sec  = next / 1000000000;
+            ts.tv_nsec = next % 1000000000;
+            pthread_cond_timedwait(&cond, &mutex, &ts);
+        }
+    }
+    return NULL;
+}
+
+// state must not be forked in the middle of a change by another thread or the watchdog
+void deadline_stack::_atfork_prepare () { pthread_mutex_lock(&mutex); }
+void deadline_stack::_atfork_parent  () { pthread_mutex_unlock(&mutex); }
+
+// only the forking thread exists in the child, the watchdog will be restarted on demand
+void deadline_stack::_atfork_child () {
+    pthread_mutex_init(&mutex, NULL);
+    started = false;
+    wakeup  = NONE;
+    deadline_stack* self = static_cast<deadline_stack*>(pthread_getspecific(key));
+    stacks->clear();
+    if (self) {
+        self->_thread   = pthread_self();
+        self->_signaled = NONE;
+        stacks->push_back(self);
+    }
+}
+
+}}
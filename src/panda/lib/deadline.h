@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <pthread.h>
+
+namespace panda { namespace lib {
+
+uint64_t monotonic_ns ();
+
+// Deadlines of nested guarded sections of a thread. Deadlines of all threads are served by one watchdog thread which sleeps until
+// the earliest of them and sends deadline_stack::signo to the owner of an expired one. The owner is never signaled otherwise.
+// Entering and leaving a section costs no syscalls in the common case: watchdog is woken only if the new earliest deadline is
+// before its wakeup time, and a finished section needs no disarming - watchdog just recalculates when it wakes up.
+class deadline_stack {
+public:
+    static const uint64_t NONE = ~uint64_t(0);
+    static const int signo; // SIGRTMIN where available, SIGALRM otherwise
+
+    static deadline_stack& instance (); // of the current thread: created on first use, destroyed when the thread exits
+
+    void   push  (uint64_t timeout_ns); // enters a section which must be left in <timeout_ns>
+    bool   pop   ();                    // leaves the innermost section, returns true if it was fired
+    size_t depth () const { return _frames.size(); }
+
+    // To be called by the owner when it gets the signal: marks the outermost expired section as fired and returns its depth
+    // (1-based). Returns 0 if there is none, i.e. the signal is late and the section is already left.
+    size_t fire ();
+
+private:
+    struct frame {
+        uint64_t deadline;
+        uint64_t earliest; // of this and all outer sections
+        bool     fired;
+    };
+
+    std::vector<frame> _frames;
+    uint64_t           _earliest; // of all sections, read by watchdog
+    uint64_t           _signaled; // _earliest value the owner was signaled for, guarded by watchdog mutex
+    pthread_t          _thread;
+
+    deadline_stack ();
+    ~deadline_stack ();
+
+    void _set_earliest (uint64_t earliest);
+
+    static void  _init           ();
+    static void  _start          ();
+    static void  _destroy        (void* stack);
+    static void* _watchdog       (void*);
+    static void  _atfork_prepare ();
+    static void  _atfork_parent  ();
+    static void  _atfork_child   ();
+};
+
+}}
@@ -0,0 +1,160 @@
+#include <panda/lib/lib.h>
+#include <panda/lib/hash.h>
+
+namespace panda { namespace lib {
+
+static const uint64_t P0 = 0x2d358dccaa6c78a5ULL;
+static const uint64_t P1 = 0x8bb84b93962eacc9ULL;
+static const uint64_t P2 = 0x4b33a62ed433d4a3ULL;
+static const uint64_t P3 = 0x4d5a2da51de1aa47ULL;
+
+static inline void mum (uint64_t* a, uint64_t* b) { // 64x64 -> 128 multiplication, low half to a, high half to b
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 r = *a;
+    r *= *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t mix (uint64_t a, uint64_t b) {
+    mum(&a, &b);
+    return a ^ b;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+static inline uint64_t r8 (const unsigned char* p) { uint64_t v; std::memcpy(&v, p, 8); return __builtin_bswap64(v); }
+static inline uint64_t r4 (const unsigned char* p) { uint32_t v; std::memcpy(&v, p, 4); return __builtin_bswap32(v); }
+#else
+static inline uint64_t r8 (const unsigned char* p) { uint64_t v; std::memcpy(&v, p, 8); return v; }
+static inline uint64_t r4 (const unsigned char* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+#endif
+static inline uint64_t r3 (const unsigned char* p, size_t k) { return (uint64_t(p[0]) << 16) | (uint64_t(p[k >> 1]) << 8) | p[k - 1]; }
+
+static inline uint64_t seed_init (uint64_t seed) { return seed ^ mix(seed ^ P0, P1); }
+
+static inline uint64_t finish (uint64_t a, uint64_t b, uint64_t seed, size_t len) {
+    a ^= P1;
+    b ^= seed;
+    mum(&a, &b);
+    return mix(a ^ P0 ^ len, b ^ P1);
+}
+
+static inline uint64_t short_hash (const unsigned char* p, size_t len, uint64_t seed) { // len <= 16
+    uint64_t a, b;
+    if (len >= 4) {
+        a = (r4(p) << 32) | r4(p + ((len >> 3) << 2));
+        b = (r4(p + len - 4) << 32) | r4(p + len - 4 - ((len >> 3) << 2));
+    }
+    else if (len > 0) {
+        a = r3(p, len);
+        b = 0;
+    }
+    else a = b = 0;
+    return finish(a, b, seed, len);
+}
+
+static inline uint64_t _hash64 (const unsigned char* p, size_t len, uint64_t seed) { // seed is already initialized
+    if (likely(len <= 16)) return short_hash(p, len, seed);
+    size_t i = len;
+    if (unlikely(i >= 48)) {
+        uint64_t see1 = seed, see2 = seed;
+        do {
+            seed = mix(r8(p) ^ P1, r8(p + 8) ^ seed);
+            see1 = mix(r8(p + 16) ^ P2, r8(p + 24) ^ see1);
+            see2 = mix(r8(p + 32) ^ P3, r8(p + 40) ^ see2);
+            p += 48;
+            i -= 48;
+        } while (likely(i >= 48));
+        seed ^= see1 ^ see2;
+    }
+    while (unlikely(i > 16)) {
+        seed = mix(r8(p) ^ P1, r8(p + 8) ^ seed);
+        i -= 16;
+        p += 16;
+    }
+    return finish(r8(p + i - 16), r8(p + i - 8), seed, len);
+}
+
+uint64_t hash64 (const char* str, size_t len, uint64_t seed) {
+    return _hash64((const unsigned char*)str, len, seed_init(seed));
+}
+
+void hash64 (const char* const* strs, const size_t* lens, size_t cnt, uint64_t* dest, uint64_t seed) {
+    seed = seed_init(seed);
+    for (size_t i = 0; i < cnt; ++i) dest[i] = _hash64((const unsigned char*)strs[i], lens[i], seed);
+}
+
+void hasher64::reset (uint64_t seed) {
+    _seed   = _see1 = _see2 = seed_init(seed);
+    _total  = 0;
+    _blen   = 0;
+    _blocks = false;
+}
+
+void hasher64::_block (const unsigned char* p) {
+    _seed   = mix(r8(p) ^ P1, r8(p + 8) ^ _seed);
+    _see1   = mix(r8(p + 16) ^ P2, r8(p + 24) ^ _see1);
+    _see2   = mix(r8(p + 32) ^ P3, r8(p + 40) ^ _see2);
+    _blocks = true;
+}
+
+// A block is processed only when it's known that more data follows it, because one-shot version handles the last bytes
+// differently. Last HISTORY bytes of processed data are kept before the buffered data, as the final round may read them.
+hasher64& hasher64::update (const char* data, size_t len) {
+    const unsigned char* src = (const unsigned char*)data;
+    unsigned char* buf = _buf + HISTORY;
+    _total += len;
+    while (len) {
+        if (!_blen && len > BLOCK) { // directly from source
+            do {
+                _block(src);
+                src += BLOCK;
+                len -= BLOCK;
+            } while (len > BLOCK);
+            std::memcpy(_buf, src - HISTORY, HISTORY);
+        }
+        size_t n = sizeof(_buf) - HISTORY - _blen;
+        if (n > len) n = len;
+        std::memcpy(buf + _blen, src, n);
+        _blen += n;
+        src   += n;
+        len   -= n;
+        if (_blen > BLOCK) {
+            _block(buf);
+            _blen -= BLOCK;
+            std::memmove(_buf, _buf + BLOCK, HISTORY + _blen);
+        }
+    }
+    return *this;
+}
+
+uint64_t hasher64::digest () const {
+    const unsigned char* p = _buf + HISTORY;
+    if (_total <= 16) return short_hash(p, _total, _seed);
+    uint64_t seed = _seed, see1 = _see1, see2 = _see2;
+    size_t i = _blen;
+    if (i == BLOCK) {
+        seed = mix(r8(p) ^ P1, r8(p + 8) ^ seed);
+        see1 = mix(r8(p + 16) ^ P2, r8(p + 24) ^ see1);
+        see2 = mix(r8(p + 32) ^ P3, r8(p + 40) ^ see2);
+        p += BLOCK;
+        i = 0;
+    }
+    if (_blocks || p != _buf + HISTORY) seed ^= see1 ^ see2;
+    while (i > 16) {
+        seed = mix(r8(p) ^ P1, r8(p + 8) ^ seed);
+        i -= 16;
+        p += 16;
+    }
+    return finish(r8(p + i - 16), r8(p + i - 8), seed, _total);
+}
+
+}}
@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <cstring>
+
+namespace panda { namespace lib {
+
+// Seedable 64-bit hash (wyhash, final version 4). Several times faster than string_hash on long strings, has no alignment
+// requirements. Unlike string_hash its results are not guaranteed to stay the same between major versions.
+uint64_t hash64 (const char* str, size_t len, uint64_t seed = 0);
+inline uint64_t hash64 (const char* str) { return hash64(str, std::strlen(str)); }
+
+// hashes <cnt> strings at once into <dest>, seed initialization is done only once for all of them
+void hash64 (const char* const* strs, const size_t* lens, size_t cnt, uint64_t* dest, uint64_t seed = 0);
+
+// Incremental version of hash64 for data that arrives in chunks: gives exactly the same result as hash64 for the whole data
+class hasher64 {
+public:
+    hasher64 (uint64_t seed = 0) { reset(seed); }
+
+    void     reset  (uint64_t seed = 0);
+    hasher64& update (const char* data, size_t len);
+    uint64_t digest () const; // can be called at any moment, doesn't change the state
+
+    size_t length () const { return _total; }
+
+private:
+    static const size_t BLOCK   = 48;
+    static const size_t HISTORY = 16; // last bytes of previous block, final round may read them
+
+    uint64_t      _seed, _see1, _see2;
+    size_t        _total;
+    size_t        _blen;   // bytes buffered after history
+    bool          _blocks; // at least one block processed
+    unsigned char _buf[HISTORY + BLOCK + 16];
+
+    void _block (const unsigned char* p);
+};
+
+}}
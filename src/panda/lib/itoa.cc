@@ -0,0 +1,113 @@
+#include <cstring>
+#include <panda/lib/itoa.h>
+
+namespace panda { namespace lib {
+
+static const char DIGITS[] =
+    "00010203040506070809" "10111213141516171819" "20212223242526272829" "30313233343536373839" "40414243444546474849"
+    "50515253545556575859" "60616263646566676869" "70717273747576777879" "80818283848586878889" "90919293949596979899";
+
+static const uint64_t POW10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static inline size_t _digits (uint64_t val) {
+    if (val < 10) return 1;
+    size_t t = (64 - __builtin_clzll(val)) * 1233 >> 12; // log10(2) ~ 1233/4096, may be one less than needed
+    return t + (val >= POW10[t]);
+}
+
+template <class T>
+static inline void _write (T val, char* end) { // digits are written backwards, from <end>
+    while (val >= 100) {
+        const char* d = DIGITS + (val % 100) * 2;
+        val /= 100;
+        *--end = d[1];
+        *--end = d[0];
+    }
+    if (val >= 10) {
+        *--end = DIGITS[val * 2 + 1];
+        *--end = DIGITS[val * 2];
+    }
+    else *--end = '0' + val;
+}
+
+// the length is known in advance, so digits are written right into their places; 32-bit division is cheaper where it suffices
+char* utoa (uint64_t val, char* buf) {
+    char* end = buf + _digits(val);
+    if (val <= 0xFFFFFFFFULL) _write((uint32_t)val, end);
+    else if (val < 10000000000000000ULL) { // two 8-digit halves
+        _write((uint32_t)(val / 100000000), end - 8);
+        uint32_t low = val % 100000000;
+        for (char* p = end; p > end - 8; p -= 2, low /= 100) std::memcpy(p - 2, DIGITS + (low % 100) * 2, 2);
+    }
+    else _write(val, end);
+    return end;
+}
+
+char* itoa (int64_t val, char* buf) {
+    if (val >= 0) return utoa(val, buf);
+    *buf = '-';
+    return utoa(-(uint64_t)val, buf + 1);
+}
+
+static inline bool _is_digit (char c) { return (unsigned char)(c - '0') < 10; }
+
+// 8 digits at once (SWAR), bytes go in little-endian order
+static inline bool _eight_digits (const char* str, uint64_t& val) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t w;
+    std::memcpy(&w, str, 8);
+    if ((w & 0xF0F0F0F0F0F0F0F0ULL) != 0x3030303030303030ULL || ((w + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) != 0x3030303030303030ULL) return false;
+    w -= 0x3030303030303030ULL;
+    w = w * 10 + (w >> 8); // pairs of digits in every other byte
+    val = (((w & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) + (((w >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+    return true;
+#else
+    (void)str; (void)val;
+    return false;
+#endif
+}
+
+const char* atou (const char* str, size_t len, uint64_t& val) {
+    const char* end = str + len;
+    if (str < end && *str == '+') ++str;
+    const char* p = str;
+    uint64_t ret = 0, block;
+    // 16 digits always fit, the rest are checked for overflow one by one
+    if (end - p >= 8 && _eight_digits(p, block)) {
+        ret = block;
+        p += 8;
+        if (end - p >= 8 && _eight_digits(p, block)) {
+            ret = ret * 100000000 + block;
+            p += 8;
+        }
+    }
+    for (; p < end && _is_digit(*p); ++p) {
+        if (__builtin_mul_overflow(ret, 10, &ret) || __builtin_add_overflow(ret, (uint64_t)(*p - '0'), &ret)) return NULL;
+    }
+    if (p == str) return NULL;
+    val = ret;
+    return p;
+}
+
+const char* atoi (const char* str, size_t len, int64_t& val) {
+    const uint64_t MIN_ABS = (uint64_t)1 << 63;
+    bool neg = len && *str == '-';
+    if (neg && (len == 1 || str[1] == '+')) return NULL;
+    uint64_t u;
+    const char* ret = atou(neg ? str + 1 : str, neg ? len - 1 : len, u);
+    if (!ret || u > MIN_ABS - !neg) return NULL;
+    val = neg ? (int64_t)(0 - u) : (int64_t)u;
+    return ret;
+}
+
+char* itoa (int64_t i) {
+    static __thread char buf[MAX_INT_CHARS + 1];
+    *itoa(i, buf) = 0;
+    return buf;
+}
+
+}}
@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+namespace panda { namespace lib {
+
+const size_t MAX_INT_CHARS = 20; // "-9223372036854775808", "18446744073709551615"
+
+// Write decimal representation of <val> into <buf> (at least MAX_INT_CHARS bytes), without NUL-termination.
+// Return pointer past the last written char. Reentrant, two digits per step.
+char* itoa (int64_t val, char* buf);
+char* utoa (uint64_t val, char* buf);
+
+// Parse decimal integer at the beginning of [str, str+len): optional sign ('-' or '+' for atoi, '+' for atou) and digits.
+// Return pointer past the last digit and set <val>, or NULL (<val> untouched) if there are no digits or value is out of range.
+const char* atoi (const char* str, size_t len, int64_t& val);
+const char* atou (const char* str, size_t len, uint64_t& val);
+
+// Deprecated: returns NUL-terminated string in thread-local buffer, which is overwritten by the next call in the same thread
+char* itoa (int64_t i);
+
+}}
@@ -4,39 +4,20 @@
 
 namespace panda { namespace lib {
 
-char* itoa (int64_t i) {
-    const int INT_DIGITS = 19; /* enough for 64 bit integer */
-    static char buf[INT_DIGITS + 2]; /* Room for INT_DIGITS digits, - and '\0' */
-    char *p = buf + INT_DIGITS + 1;   /* points to terminating '\0' */
-    if (i >= 0) {
-        do {
-            *--p = '0' + (i % 10);
-            i /= 10;
-        } while (i != 0);
-        return p;
-    }
-    else {            /* i < 0 */
-        do {
-            *--p = '0' - (i % 10);
-            i /= 10;
-        } while (i != 0);
-        *--p = '-';
-    }
-    return p;
-}
-
 uint64_t string_hash (const char* str, size_t len) { // MurMurHash64A
     const uint64_t seed = 7;
     const uint64_t m = 0xc6a4a7935bd1e995LLU;
     const int r = 47;
 
-    const uint64_t * data = (const uint64_t *) str;
-    const uint64_t * end = data + (len/8);
+    const char * data = str;
+    const char * end = data + (len/8)*8;
     
     uint64_t h = seed ^ (len * m);
 
     while (data != end) {
-        uint64_t k = *data++;
+        uint64_t k;
+        std::memcpy(&k, data, 8); // no unaligned loads
+        data += 8;
         k *= m;
         k ^= k >> r;
         k *= m;
@@ -77,16 +58,4 @@ uint32_t string_hash32 (const char *key, size_t len) { // jenkins_one_at_a_time_
     return hash;
 }
 
-char* crypt_xor (const char* source, size_t slen, const char* key, size_t klen, char* dest) {
-    unsigned char* buf;
-    if (dest) buf = (unsigned char*) dest;
-    else {
-        buf = (unsigned char*) std::malloc(slen+1); // space for '0'
-        if (!buf) throw std::bad_alloc();
-    }
-    for (int i = 0; i < slen; ++i) dest[i] = ((unsigned char) source[i]) ^ ((unsigned char) key[i % klen]);
-    dest[slen] = 0;
-    return (char*) dest;
-}
-
 }}
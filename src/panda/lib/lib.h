@@ -2,6 +2,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <cstring>
+#include <panda/lib/itoa.h>
 
 #ifndef likely
 #  define likely(x)   __builtin_expect((x),1)
@@ -10,8 +11,6 @@
 
 namespace panda { namespace lib {
 
-char* itoa (int64_t i);
-
 uint64_t string_hash (const char* str, size_t len);
 inline uint64_t string_hash (const char* str) { return string_hash(str, std::strlen(str)); }
 
@@ -20,4 +19,8 @@ inline uint32_t string_hash32 (const char* str) { return string_hash32(str, std:
 
 char* crypt_xor (const char* source, size_t slen, const char* key, size_t klen, char* dest = NULL);
 
+// xors <len> bytes from <source> into <dest> (may be the same buffer) starting from key offset <koff>, no NUL-termination.
+// Returns key offset for the next chunk of the stream
+size_t crypt_xor (const char* source, char* dest, size_t len, const char* key, size_t klen, size_t koff = 0);
+
 }};
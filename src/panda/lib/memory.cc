@@ -0,0 +1,194 @@
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <panda/lib/lib.h>
+#include <panda/lib/memory.h>
+
+namespace panda { namespace lib {
+
+__thread allocator* _string_allocator = NULL;
+
+void* allocator::reallocate (void* ptr, size_t old_size, size_t new_size) {
+    void* ret = allocate(new_size);
+    std::memcpy(ret, ptr, old_size < new_size ? old_size : new_size);
+    deallocate(ptr, old_size);
+    return ret;
+}
+
+/* pool_allocator */
+
+static const int POOL_CLASSES = 9; // 32 .. 8192
+
+struct pool_block_t { pool_block_t* next; };
+
+struct pool_cache_t {
+    pool_block_t* list[POOL_CLASSES];
+    size_t        count[POOL_CLASSES];
+};
+
+static __thread pool_cache_t* pool_cache = NULL;
+static pthread_key_t          pool_cache_key;
+static pthread_once_t         pool_cache_once = PTHREAD_ONCE_INIT;
+
+static void pool_cache_destroy (void* cache) {
+    pool_cache_t* c = (pool_cache_t*)cache;
+    for (int i = 0; i < POOL_CLASSES; ++i) {
+        pool_block_t* block = c->list[i];
+        while (block) {
+            pool_block_t* next = block->next;
+            std::free(block);
+            block = next;
+        }
+        c->list[i] = NULL;
+        c->count[i] = 0;
+    }
+}
+
+static void pool_cache_thread_exit (void* cache) {
+    pool_cache_destroy(cache);
+    std::free(cache);
+    pool_cache = NULL;
+}
+
+static void pool_cache_key_create () { pthread_key_create(&pool_cache_key, pool_cache_thread_exit); }
+
+static inline pool_cache_t* pool_get_cache () {
+    if (likely(pool_cache != NULL)) return pool_cache;
+    pthread_once(&pool_cache_once, pool_cache_key_create);
+    pool_cache = (pool_cache_t*)std::calloc(1, sizeof(pool_cache_t));
+    if (!pool_cache) throw std::bad_alloc();
+    pthread_setspecific(pool_cache_key, pool_cache);
+    return pool_cache;
+}
+
+static inline int pool_class (size_t size) {
+    if (size <= pool_allocator::MIN_SIZE) return 0;
+    return 64 - __builtin_clzll((unsigned long long)(size - 1)) - 5; // log2 of size rounded up, minus log2(MIN_SIZE)
+}
+
+pool_allocator* pool_allocator::instance () {
+    static pool_allocator inst;
+    return &inst;
+}
+
+void* pool_allocator::allocate (size_t size) {
+    void* ret;
+    if (size > MAX_SIZE) ret = std::malloc(size);
+    else {
+        int idx = pool_class(size);
+        pool_cache_t* cache = pool_get_cache();
+        pool_block_t* block = cache->list[idx];
+        if (block) {
+            cache->list[idx] = block->next;
+            --cache->count[idx];
+            return block;
+        }
+        ret = std::malloc(MIN_SIZE << idx);
+    }
+    if (!ret) throw std::bad_alloc();
+    return ret;
+}
+
+void* pool_allocator::reallocate (void* ptr, size_t old_size, size_t new_size) {
+    if (old_size > MAX_SIZE && new_size > MAX_SIZE) {
+        void* ret = std::realloc(ptr, new_size);
+        if (!ret) throw std::bad_alloc();
+        return ret;
+    }
+    if (old_size <= MAX_SIZE && new_size <= MAX_SIZE && pool_class(old_size) == pool_class(new_size)) return ptr; // fits in the same block
+    return allocator::reallocate(ptr, old_size, new_size);
+}
+
+void pool_allocator::deallocate (void* ptr, size_t size) {
+    if (size > MAX_SIZE) {
+        std::free(ptr);
+        return;
+    }
+    int idx = pool_class(size);
+    pool_cache_t* cache = pool_get_cache();
+    if (cache->count[idx] >= MAX_CACHED) {
+        std::free(ptr);
+        return;
+    }
+    pool_block_t* block = (pool_block_t*)ptr;
+    block->next = cache->list[idx];
+    cache->list[idx] = block;
+    ++cache->count[idx];
+}
+
+void pool_allocator::flush () {
+    if (pool_cache) pool_cache_destroy(pool_cache);
+}
+
+/* arena_allocator */
+
+static const size_t ARENA_ALIGN = 16;
+
+static inline size_t arena_align (size_t size) { return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1); }
+
+static const size_t ARENA_HEADER = (sizeof(void*) * 2 + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+arena_allocator::arena_allocator (size_t chunk_size) :
+    _chunks(NULL), _cur(NULL), _end(NULL), _last(NULL), _chunk_size(chunk_size), _allocated(0) {}
+
+void* arena_allocator::allocate (size_t size) {
+    size = arena_align(size);
+    if (size_t(_end - _cur) < size) { // add new chunk to the head, the rest of current one is wasted
+        size_t csize = size + ARENA_HEADER > _chunk_size ? size + ARENA_HEADER : _chunk_size;
+        chunk_t* chunk = (chunk_t*)std::malloc(csize);
+        if (!chunk) throw std::bad_alloc();
+        chunk->size = csize;
+        chunk->next = _chunks;
+        _chunks = chunk;
+        _allocated += csize;
+        _cur = (char*)chunk + ARENA_HEADER;
+        _end = (char*)chunk + chunk->size;
+    }
+    _last = _cur;
+    _cur += size;
+    return _last;
+}
+
+void* arena_allocator::reallocate (void* ptr, size_t old_size, size_t new_size) {
+    if (ptr == _last && size_t(_end - _last) >= arena_align(new_size)) { // last allocation - grow/shrink in place
+        _cur = _last + arena_align(new_size);
+        return ptr;
+    }
+    void* ret = allocate(new_size);
+    std::memcpy(ret, ptr, old_size < new_size ? old_size : new_size);
+    return ret;
+}
+
+void arena_allocator::deallocate (void* ptr, size_t) {
+    if (ptr == _last) {
+        _cur = _last;
+        _last = NULL;
+    }
+}
+
+void arena_allocator::reset () { // keeps the most recent chunk
+    if (!_chunks) return;
+    chunk_t* chunk = _chunks->next;
+    while (chunk) {
+        chunk_t* next = chunk->next;
+        _allocated -= chunk->size;
+        std::free(chunk);
+        chunk = next;
+    }
+    _chunks->next = NULL;
+    _cur = (char*)_chunks + ARENA_HEADER;
+    _end = (char*)_chunks + _chunks->size;
+    _last = NULL;
+}
+
+arena_allocator::~arena_allocator () {
+    chunk_t* chunk = _chunks;
+    while (chunk) {
+        chunk_t* next = chunk->next;
+        std::free(chunk);
+        chunk = next;
+    }
+}
+
+}}
@@ -0,0 +1,78 @@
+#pragma once
+#include <stddef.h>
+
+namespace panda { namespace lib {
+
+class allocator {
+public:
+    virtual void* allocate   (size_t size) = 0;
+    virtual void* reallocate (void* ptr, size_t old_size, size_t new_size);
+    virtual void  deallocate (void* ptr, size_t size) = 0;
+    virtual ~allocator () {}
+};
+
+// Size-class pool with thread-local free lists. Blocks up to MAX_SIZE bytes are cached per thread and reused,
+// bigger ones go directly to malloc. Stateless, so that a single instance() is enough for the whole process.
+class pool_allocator : public allocator {
+public:
+    static const size_t MIN_SIZE    = 32;
+    static const size_t MAX_SIZE    = 8192;
+    static const size_t MAX_CACHED  = 256; // per size class per thread
+
+    static pool_allocator* instance ();
+
+    void* allocate   (size_t size);
+    void* reallocate (void* ptr, size_t old_size, size_t new_size);
+    void  deallocate (void* ptr, size_t size);
+
+    static void flush (); // frees all blocks cached by current thread
+};
+
+// Bump-pointer arena. Memory is carved from big chunks and released all at once by reset() or destructor, deallocate()
+// only rolls back the last allocation. Not thread-safe: use one arena per thread/request.
+class arena_allocator : public allocator {
+public:
+    arena_allocator (size_t chunk_size = 65536);
+
+    void* allocate   (size_t size);
+    void* reallocate (void* ptr, size_t old_size, size_t new_size);
+    void  deallocate (void* ptr, size_t size);
+
+    void   reset     ();                    // releases all memory allocated, keeps first chunk for reuse
+    size_t allocated () const { return _allocated; } // total bytes in chunks
+
+    ~arena_allocator ();
+
+private:
+    struct chunk_t {
+        chunk_t* next;
+        size_t   size;
+    };
+
+    chunk_t* _chunks;
+    char*    _cur;
+    char*    _end;
+    char*    _last; // last allocation - can be resized or freed in place
+    size_t   _chunk_size;
+    size_t   _allocated;
+
+    arena_allocator (const arena_allocator&);
+    arena_allocator& operator= (const arena_allocator&);
+};
+
+extern __thread allocator* _string_allocator;
+
+// allocator used for new panda::string heap buffers in current thread. NULL means std::malloc
+inline allocator* get_string_allocator ()             { return _string_allocator; }
+inline void       set_string_allocator (allocator* a) { _string_allocator = a; }
+
+// sets string allocator for current thread until the end of scope
+class string_allocator_guard {
+public:
+    string_allocator_guard (allocator* a) : _prev(_string_allocator) { _string_allocator = a; }
+    ~string_allocator_guard () { _string_allocator = _prev; }
+private:
+    allocator* _prev;
+};
+
+}}
@@ -0,0 +1,135 @@
+#pragma once
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace panda { namespace lib {
+
+// Flat open-addressing map from pointers to small trivially copyable values (pointers, integers), for identity tracking
+// while walking object graphs (visited/cycle maps). Keys and values are stored together in one array, so a lookup usually
+// touches a single cache line; linear probing, fibonacci hashing, NULL key is not allowed (marks empty slot).
+// clear() keeps allocated memory, so that the same map can be reused for many walks without reallocation.
+template <class V>
+class ptr_map {
+public:
+    struct entry {
+        const void* key;
+        V           value;
+    };
+
+    ptr_map (size_t reserve = 0) : _entries(NULL), _cap(0), _shift(64), _size(0) { if (reserve) this->reserve(reserve); }
+    ~ptr_map () { std::free(_entries); }
+
+    size_t size     () const { return _size; }
+    bool   empty    () const { return !_size; }
+    size_t capacity () const { return _cap; }
+
+    V* find (const void* key) const {
+        if (!_size) return NULL;
+        for (size_t i = _slot(key);; i = (i + 1) & (_cap - 1)) {
+            entry& e = _entries[i];
+            if (e.key == key) return &e.value;
+            if (!e.key) return NULL;
+        }
+    }
+
+    // inserts value if key is absent. Returns pointer to value in map and sets <inserted>
+    V* insert (const void* key, const V& value, bool& inserted) {
+        if ((_size + 1) * 4 > _cap * 3) _rehash(_cap ? _cap * 2 : 16); // max load factor 0.75
+        size_t i = _slot(key);
+        for (;; i = (i + 1) & (_cap - 1)) {
+            entry& e = _entries[i];
+            if (e.key == key) {
+                inserted = false;
+                return &e.value;
+            }
+            if (!e.key) break;
+        }
+        _entries[i].key   = key;
+        _entries[i].value = value;
+        ++_size;
+        inserted = true;
+        return &_entries[i].value;
+    }
+
+    bool insert (const void* key, const V& value) {
+        bool inserted;
+        insert(key, value, inserted);
+        return inserted;
+    }
+
+    V& operator[] (const void* key) {
+        bool inserted;
+        return *insert(key, V(), inserted);
+    }
+
+    bool erase (const void* key) {
+        if (!_size) return false;
+        size_t mask = _cap - 1, i = _slot(key);
+        for (;; i = (i + 1) & mask) {
+            if (_entries[i].key == key) break;
+            if (!_entries[i].key) return false;
+        }
+        _entries[i].key = NULL;
+        --_size;
+        for (size_t j = (i + 1) & mask; _entries[j].key; j = (j + 1) & mask) { // backward shift, no tombstones
+            size_t home = _slot(_entries[j].key);
+            if (i < j ? (home > i && home <= j) : (home > i || home <= j)) continue;
+            _entries[i] = _entries[j];
+            _entries[j].key = NULL;
+            i = j;
+        }
+        return true;
+    }
+
+    void reserve (size_t n) {
+        size_t cap = 16;
+        while (cap * 3 < n * 4) cap *= 2;
+        if (cap > _cap) _rehash(cap);
+    }
+
+    // removes all elements, keeps memory unless the table is much bigger than its content (to keep clear() cost proportional to size)
+    void clear () {
+        if (!_size) return;
+        if (_cap > 4096 && _size * 8 < _cap) {
+            std::free(_entries);
+            _entries = NULL;
+            _cap     = 0;
+            _shift   = 64;
+        }
+        else std::memset(_entries, 0, _cap * sizeof(entry));
+        _size = 0;
+    }
+
+private:
+    entry* _entries;
+    size_t _cap;
+    int    _shift;
+    size_t _size;
+
+    ptr_map (const ptr_map&);
+    ptr_map& operator= (const ptr_map&);
+
+    size_t _slot (const void* key) const { return size_t(((uint64_t)(uintptr_t)key * 0x9E3779B97F4A7C15ULL) >> _shift); }
+
+    void _rehash (size_t cap) {
+        entry* entries = (entry*)std::calloc(cap, sizeof(entry));
+        if (!entries) throw std::bad_alloc();
+        entry* old     = _entries;
+        size_t old_cap = _cap;
+        _entries = entries;
+        _cap     = cap;
+        _shift   = 64;
+        while (cap >>= 1) --_shift;
+        for (size_t i = 0; i < old_cap; ++i) if (old[i].key) {
+            size_t j = _slot(old[i].key);
+            while (_entries[j].key) j = (j + 1) & (_cap - 1);
+            _entries[j] = old[i];
+        }
+        std::free(old);
+    }
+};
+
+}}
@@ -0,0 +1,333 @@
+#include <cstring>
+#include <stdint.h>
+#include <panda/lib/lib.h>
+#include <panda/lib/search.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define PANDA_SEARCH_X86
+#  include <immintrin.h>
+#endif
+
+#ifndef PANDA_SEARCH_MAX_LEVEL // highest kernels used if CPU supports them: 0 - scalar, 1 - sse2, 2 - avx2. Tests build lower ones
+#  define PANDA_SEARCH_MAX_LEVEL 2
+#endif
+
+namespace panda { namespace lib {
+
+typedef const char* (*search_fn) (const char*, size_t, const char*, size_t);
+
+/* scalar kernels */
+
+static const char* find_bytes_scalar (const char* h, size_t hlen, const char* n, size_t nlen) {
+    if (nlen > hlen) return NULL;
+    const char* end = h + hlen - nlen + 1; // candidates are [h, end)
+    while (h < end) {
+        h = (const char*)std::memchr(h, n[0], end - h);
+        if (!h) return NULL;
+        if (std::memcmp(h + 1, n + 1, nlen - 1) == 0) return h;
+        ++h;
+    }
+    return NULL;
+}
+
+static const char* rfind_char_scalar (const char* s, size_t len, char c) {
+#ifdef __GLIBC__
+    return (const char*)memrchr(s, c, len);
+#else
+    for (const char* p = s + len; p-- != s;) if (*p == c) return p;
+    return NULL;
+#endif
+}
+
+static const char* rfind_bytes_scalar (const char* h, size_t hlen, const char* n, size_t nlen) {
+    if (nlen > hlen) return NULL;
+    size_t cand = hlen - nlen + 1; // candidates are [h, h + cand)
+    while (cand) {
+        const char* p = rfind_char_scalar(h, cand, n[0]);
+        if (!p) return NULL;
+        if (std::memcmp(p + 1, n + 1, nlen - 1) == 0) return p;
+        cand = p - h;
+    }
+    return NULL;
+}
+
+struct byteset {
+    uint64_t bits[4];
+    byteset (const char* set, size_t len) {
+        bits[0] = bits[1] = bits[2] = bits[3] = 0;
+        for (size_t i = 0; i < len; ++i) {
+            unsigned char c = set[i];
+            bits[c >> 6] |= uint64_t(1) << (c & 63);
+        }
+    }
+    bool has (unsigned char c) const { return bits[c >> 6] & (uint64_t(1) << (c & 63)); }
+};
+
+template <bool NOT>
+static const char* find_of_scalar (const char* s, size_t len, const char* set, size_t setlen) {
+    byteset bs(set, setlen);
+    for (const char* end = s + len; s != end; ++s) if (bs.has(*s) != NOT) return s;
+    return NULL;
+}
+
+template <bool NOT>
+static const char* rfind_of_scalar (const char* s, size_t len, const char* set, size_t setlen) {
+    byteset bs(set, setlen);
+    for (const char* p = s + len; p-- != s;) if (bs.has(*p) != NOT) return p;
+    return NULL;
+}
+
+#ifdef PANDA_SEARCH_X86
+
+/* SSE2/AVX2 kernels. Substring search compares first and last bytes of needle against a whole block of candidate
+ * positions at once and verifies only those positions where both match. */
+
+static inline int highest_bit (uint32_t mask) { return 31 - __builtin_clz(mask); }
+
+__attribute__((target("sse2")))
+static inline uint32_t sse2_match (const char* p, __m128i first, __m128i last, size_t lastpos) {
+    __m128i bf = _mm_loadu_si128((const __m128i*)p);
+    __m128i bl = _mm_loadu_si128((const __m128i*)(p + lastpos));
+    return _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(bf, first), _mm_cmpeq_epi8(bl, last)));
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t avx2_match (const char* p, __m256i first, __m256i last, size_t lastpos) {
+    __m256i bf = _mm256_loadu_si256((const __m256i*)p);
+    __m256i bl = _mm256_loadu_si256((const __m256i*)(p + lastpos));
+    return _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(bf, first), _mm256_cmpeq_epi8(bl, last)));
+}
+
+__attribute__((target("sse2")))
+static const char* find_bytes_sse2 (const char* h, size_t hlen, const char* n, size_t nlen) {
+    if (nlen > hlen) return NULL;
+    size_t lastpos = nlen - 1;
+    __m128i first = _mm_set1_epi8(n[0]), last = _mm_set1_epi8(n[lastpos]);
+    size_t i = 0;
+    for (; i + lastpos + 16 <= hlen; i += 16) {
+        uint32_t mask = sse2_match(h + i, first, last, lastpos);
+        while (mask) {
+            const char* p = h + i + __builtin_ctz(mask);
+            if (std::memcmp(p + 1, n + 1, nlen - 1) == 0) return p;
+            mask &= mask - 1;
+        }
+    }
+    return find_bytes_scalar(h + i, hlen - i, n, nlen);
+}
+
+__attribute__((target("avx2")))
+static const char* find_bytes_avx2 (const char* h, size_t hlen, const char* n, size_t nlen) {
+    if (nlen > hlen) return NULL;
+    size_t lastpos = nlen - 1;
+    __m256i first = _mm256_set1_epi8(n[0]), last = _mm256_set1_epi8(n[lastpos]);
+    size_t i = 0;
+    for (; i + lastpos + 32 <= hlen; i += 32) {
+        uint32_t mask = avx2_match(h + i, first, last, lastpos);
+        while (mask) {
+            const char* p = h + i + __builtin_ctz(mask);
+            if (std::memcmp(p + 1, n + 1, nlen - 1) == 0) return p;
+            mask &= mask - 1;
+        }
+    }
+    return find_bytes_scalar(h + i, hlen - i, n, nlen);
+}
+
+__attribute__((target("sse2")))
+static const char* rfind_bytes_sse2 (const char* h, size_t hlen, const char* n, size_t nlen) {
+    if (nlen > hlen) return NULL;
+    size_t lastpos = nlen - 1;
+    __m128i first = _mm_set1_epi8(n[0]), last = _mm_set1_epi8(n[lastpos]);
+    size_t cand = hlen - lastpos; // candidates left: [0, cand)
+    for (; cand >= 16; cand -= 16) {
+        const char* block = h + cand - 16;
+        uint32_t mask = sse2_match(block, first, last, lastpos);
+        while (mask) {
+            int bit = highest_bit(mask);
+            if (std::memcmp(block + bit + 1, n + 1, nlen - 1) == 0) return block + bit;
+            mask &= ~(uint32_t(1) << bit);
+        }
+    }
+    return rfind_bytes_scalar(h, cand + lastpos, n, nlen);
+}
+
+__attribute__((target("avx2")))
+static const char* rfind_bytes_avx2 (const char* h, size_t hlen, const char* n, size_t nlen) {
+    if (nlen > hlen) return NULL;
+    size_t lastpos = nlen - 1;
+    __m256i first = _mm256_set1_epi8(n[0]), last = _mm256_set1_epi8(n[lastpos]);
+    size_t cand = hlen - lastpos;
+    for (; cand >= 32; cand -= 32) {
+        const char* block = h + cand - 32;
+        uint32_t mask = avx2_match(block, first, last, lastpos);
+        while (mask) {
+            int bit = highest_bit(mask);
+            if (std::memcmp(block + bit + 1, n + 1, nlen - 1) == 0) return block + bit;
+            mask &= ~(uint32_t(1) << bit);
+        }
+    }
+    return rfind_bytes_scalar(h, cand + lastpos, n, nlen);
+}
+
+/* set search: block is compared with every char of the set (up to MAX_SIMD_SET chars), bigger sets use scalar bitmap */
+
+static const size_t MAX_SIMD_SET = 16;
+
+__attribute__((target("sse2")))
+static inline uint32_t sse2_set_mask (const char* p, const __m128i* set, size_t setlen) {
+    __m128i block = _mm_loadu_si128((const __m128i*)p);
+    __m128i acc = _mm_cmpeq_epi8(block, set[0]);
+    for (size_t i = 1; i < setlen; ++i) acc = _mm_or_si128(acc, _mm_cmpeq_epi8(block, set[i]));
+    return _mm_movemask_epi8(acc);
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t avx2_set_mask (const char* p, const __m256i* set, size_t setlen) {
+    __m256i block = _mm256_loadu_si256((const __m256i*)p);
+    __m256i acc = _mm256_cmpeq_epi8(block, set[0]);
+    for (size_t i = 1; i < setlen; ++i) acc = _mm256_or_si256(acc, _mm256_cmpeq_epi8(block, set[i]));
+    return _mm256_movemask_epi8(acc);
+}
+
+template <bool NOT>
+__attribute__((target("sse2")))
+static const char* find_of_sse2 (const char* s, size_t len, const char* set, size_t setlen) {
+    if (setlen > MAX_SIMD_SET) return find_of_scalar<NOT>(s, len, set, setlen);
+    __m128i vset[MAX_SIMD_SET];
+    for (size_t i = 0; i < setlen; ++i) vset[i] = _mm_set1_epi8(set[i]);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        uint32_t mask = sse2_set_mask(s + i, vset, setlen);
+        if (NOT) mask = ~mask & 0xFFFF;
+        if (mask) return s + i + __builtin_ctz(mask);
+    }
+    return find_of_scalar<NOT>(s + i, len - i, set, setlen);
+}
+
+template <bool NOT>
+__attribute__((target("avx2")))
+static const char* find_of_avx2 (const char* s, size_t len, const char* set, size_t setlen) {
+    if (setlen > MAX_SIMD_SET) return find_of_scalar<NOT>(s, len, set, setlen);
+    __m256i vset[MAX_SIMD_SET];
+    for (size_t i = 0; i < setlen; ++i) vset[i] = _mm256_set1_epi8(set[i]);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        uint32_t mask = avx2_set_mask(s + i, vset, setlen);
+        if (NOT) mask = ~mask;
+        if (mask) return s + i + __builtin_ctz(mask);
+    }
+    return find_of_scalar<NOT>(s + i, len - i, set, setlen);
+}
+
+template <bool NOT>
+__attribute__((target("sse2")))
+static const char* rfind_of_sse2 (const char* s, size_t len, const char* set, size_t setlen) {
+    if (setlen > MAX_SIMD_SET) return rfind_of_scalar<NOT>(s, len, set, setlen);
+    __m128i vset[MAX_SIMD_SET];
+    for (size_t i = 0; i < setlen; ++i) vset[i] = _mm_set1_epi8(set[i]);
+    for (; len >= 16; len -= 16) {
+        uint32_t mask = sse2_set_mask(s + len - 16, vset, setlen);
+        if (NOT) mask = ~mask & 0xFFFF;
+        if (mask) return s + len - 16 + highest_bit(mask);
+    }
+    return rfind_of_scalar<NOT>(s, len, set, setlen);
+}
+
+template <bool NOT>
+__attribute__((target("avx2")))
+static const char* rfind_of_avx2 (const char* s, size_t len, const char* set, size_t setlen) {
+    if (setlen > MAX_SIMD_SET) return rfind_of_scalar<NOT>(s, len, set, setlen);
+    __m256i vset[MAX_SIMD_SET];
+    for (size_t i = 0; i < setlen; ++i) vset[i] = _mm256_set1_epi8(set[i]);
+    for (; len >= 32; len -= 32) {
+        uint32_t mask = avx2_set_mask(s + len - 32, vset, setlen);
+        if (NOT) mask = ~mask;
+        if (mask) return s + len - 32 + highest_bit(mask);
+    }
+    return rfind_of_scalar<NOT>(s, len, set, setlen);
+}
+
+static int simd_level () { // 0 - none, 1 - sse2, 2 - avx2
+    __builtin_cpu_init();
+    if (PANDA_SEARCH_MAX_LEVEL >= 2 && __builtin_cpu_supports("avx2")) return 2;
+    if (PANDA_SEARCH_MAX_LEVEL >= 1 && __builtin_cpu_supports("sse2")) return 1;
+    return 0;
+}
+
+#  define PANDA_SEARCH_DISPATCH(name, targs) (level == 2 ? name##_avx2 targs : (level == 1 ? name##_sse2 targs : name##_scalar targs))
+
+#else
+
+static int simd_level () { return 0; }
+
+#  define PANDA_SEARCH_DISPATCH(name, targs) name##_scalar targs
+
+#endif
+
+struct kernels {
+    search_fn find_bytes;
+    search_fn rfind_bytes;
+    search_fn find_first_of;
+    search_fn find_first_not_of;
+    search_fn find_last_of;
+    search_fn find_last_not_of;
+};
+
+static kernels select_kernels () {
+    int level = simd_level();
+    (void)level; // unused without SIMD
+    kernels k = {
+        PANDA_SEARCH_DISPATCH(find_bytes, ),
+        PANDA_SEARCH_DISPATCH(rfind_bytes, ),
+        PANDA_SEARCH_DISPATCH(find_of, <false>),
+        PANDA_SEARCH_DISPATCH(find_of, <true>),
+        PANDA_SEARCH_DISPATCH(rfind_of, <false>),
+        PANDA_SEARCH_DISPATCH(rfind_of, <true>),
+    };
+    return k;
+}
+
+// resolved on first call, not by a static initializer: functions may be called from other static initializers
+static const kernels& impl () {
+    static const kernels k = select_kernels();
+    return k;
+}
+
+const char* find_bytes (const char* haystack, size_t hlen, const char* needle, size_t nlen) {
+    if (nlen == 1) return (const char*)std::memchr(haystack, needle[0], hlen);
+    if (nlen == 0) return haystack;
+    return impl().find_bytes(haystack, hlen, needle, nlen);
+}
+
+const char* rfind_bytes (const char* haystack, size_t hlen, const char* needle, size_t nlen) {
+    if (nlen == 1) return rfind_char_scalar(haystack, hlen, needle[0]);
+    if (nlen == 0) return haystack + hlen;
+    return impl().rfind_bytes(haystack, hlen, needle, nlen);
+}
+
+const char* rfind_char (const char* str, size_t len, char c) {
+    return rfind_char_scalar(str, len, c);
+}
+
+const char* find_first_of (const char* str, size_t len, const char* set, size_t setlen) {
+    if (setlen == 1) return (const char*)std::memchr(str, set[0], len);
+    if (setlen == 0) return NULL;
+    return impl().find_first_of(str, len, set, setlen);
+}
+
+const char* find_last_of (const char* str, size_t len, const char* set, size_t setlen) {
+    if (setlen == 1) return rfind_char_scalar(str, len, set[0]);
+    if (setlen == 0) return NULL;
+    return impl().find_last_of(str, len, set, setlen);
+}
+
+const char* find_first_not_of (const char* str, size_t len, const char* set, size_t setlen) {
+    if (setlen == 0) return len ? str : NULL;
+    return impl().find_first_not_of(str, len, set, setlen);
+}
+
+const char* find_last_not_of (const char* str, size_t len, const char* set, size_t setlen) {
+    if (setlen == 0) return len ? str + len - 1 : NULL;
+    return impl().find_last_not_of(str, len, set, setlen);
+}
+
+}}
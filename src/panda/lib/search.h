@@ -0,0 +1,18 @@
+#pragma once
+#include <stddef.h>
+
+namespace panda { namespace lib {
+
+// Length-aware (embedded NULs are ok) search kernels. Use SSE2/AVX2 when CPU supports it, scalar code otherwise.
+// All of them return pointer to the found byte/substring or NULL.
+
+const char* find_bytes  (const char* haystack, size_t hlen, const char* needle, size_t nlen); // first occurence of needle
+const char* rfind_bytes (const char* haystack, size_t hlen, const char* needle, size_t nlen); // last occurence of needle
+const char* rfind_char  (const char* str, size_t len, char c);
+
+const char* find_first_of     (const char* str, size_t len, const char* set, size_t setlen);
+const char* find_last_of      (const char* str, size_t len, const char* set, size_t setlen);
+const char* find_first_not_of (const char* str, size_t len, const char* set, size_t setlen);
+const char* find_last_not_of  (const char* str, size_t len, const char* set, size_t setlen);
+
+}}
@@ -0,0 +1,294 @@
+#include <cstring>
+#include <stdint.h>
+#include <panda/lib/utf8.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define PANDA_UTF8_X86
+#  include <immintrin.h>
+#endif
+
+namespace panda { namespace lib {
+
+typedef bool   (*check_fn)  (const unsigned char* s, size_t len);
+typedef size_t (*length_fn) (const unsigned char* s, size_t len);
+
+static const uint64_t HIGH_BITS = 0x8080808080808080ULL;
+
+static bool ascii_scalar (const unsigned char* s, size_t len) {
+    for (; len >= 32; len -= 32, s += 32) { // 4 words per check, so that long non-ASCII data is rejected early
+        uint64_t w[4];
+        std::memcpy(w, s, 32);
+        if ((w[0] | w[1] | w[2] | w[3]) & HIGH_BITS) return false;
+    }
+    uint64_t acc = 0;
+    for (; len >= 8; len -= 8, s += 8) {
+        uint64_t w;
+        std::memcpy(&w, s, 8);
+        acc |= w;
+    }
+    for (; len; --len) acc |= *s++;
+    return !(acc & HIGH_BITS);
+}
+
+// validates one character at <s> (not ASCII), returns pointer past it or NULL if it's invalid
+static inline const unsigned char* validate_char (const unsigned char* s, const unsigned char* end) {
+    unsigned c = *s;
+    if (c < 0xC2) return NULL; // continuation byte or overlong 2-byte form
+    if (c < 0xE0) {
+        if (end - s < 2 || (s[1] & 0xC0) != 0x80) return NULL;
+        return s + 2;
+    }
+    if (c < 0xF0) {
+        if (end - s < 3 || (s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80) return NULL;
+        if ((c == 0xE0 && s[1] < 0xA0) || (c == 0xED && s[1] >= 0xA0)) return NULL; // overlong, surrogate
+        return s + 3;
+    }
+    if (c < 0xF5) {
+        if (end - s < 4 || (s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80 || (s[3] & 0xC0) != 0x80) return NULL;
+        if ((c == 0xF0 && s[1] < 0x90) || (c == 0xF4 && s[1] >= 0x90)) return NULL; // overlong, above U+10FFFF
+        return s + 4;
+    }
+    return NULL;
+}
+
+static bool validate_scalar (const unsigned char* s, size_t len) {
+    const unsigned char* end = s + len;
+    while (s < end) {
+        if (end - s >= 8) { // skip ASCII a word at a time
+            uint64_t w;
+            std::memcpy(&w, s, 8);
+            if (!(w & HIGH_BITS)) {
+                s += 8;
+                continue;
+            }
+        }
+        if (*s < 0x80) ++s;
+        else if (!(s = validate_char(s, end))) return false;
+    }
+    return true;
+}
+
+static size_t length_scalar (const unsigned char* s, size_t len) {
+    size_t cnt = len;
+    for (; len >= 8; len -= 8, s += 8) {
+        uint64_t w;
+        std::memcpy(&w, s, 8);
+        cnt -= __builtin_popcountll(w & ~(w << 1) & HIGH_BITS); // continuation bytes 10______: bit 7 set, bit 6 clear
+    }
+    for (; len; --len) cnt -= (*s++ & 0xC0) == 0x80;
+    return cnt;
+}
+
+#ifdef PANDA_UTF8_X86
+
+__attribute__((target("sse2")))
+static bool ascii_sse2 (const unsigned char* s, size_t len) {
+    for (; len >= 64; len -= 64, s += 64) {
+        __m128i a = _mm_or_si128(_mm_loadu_si128((const __m128i*)s),        _mm_loadu_si128((const __m128i*)(s + 16)));
+        __m128i b = _mm_or_si128(_mm_loadu_si128((const __m128i*)(s + 32)), _mm_loadu_si128((const __m128i*)(s + 48)));
+        if (_mm_movemask_epi8(_mm_or_si128(a, b))) return false;
+    }
+    for (; len >= 16; len -= 16, s += 16) if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)s))) return false;
+    return ascii_scalar(s, len);
+}
+
+// skips ASCII 16 bytes at a time, runs of non-ASCII characters are validated one by one
+__attribute__((target("sse2")))
+static bool validate_sse2 (const unsigned char* s, size_t len) {
+    const unsigned char* end = s + len;
+    while (end - s >= 16) {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)s));
+        if (!mask) {
+            s += 16;
+            continue;
+        }
+        s += __builtin_ctz(mask);
+        while (s < end && *s >= 0x80) if (!(s = validate_char(s, end))) return false;
+    }
+    return validate_scalar(s, end - s);
+}
+
+// counts bytes greater than 0xBF as signed (ASCII and lead bytes) in byte-wide counters, summed up every 255 blocks
+__attribute__((target("sse2")))
+static size_t length_sse2 (const unsigned char* s, size_t len) {
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128i limit = _mm_set1_epi8(-65);
+    size_t cnt = 0;
+    while (len >= 16) {
+        size_t blocks = len / 16 > 255 ? 255 : len / 16;
+        __m128i acc = zero;
+        for (size_t i = 0; i < blocks; ++i, s += 16) acc = _mm_sub_epi8(acc, _mm_cmpgt_epi8(_mm_loadu_si128((const __m128i*)s), limit));
+        __m128i sum = _mm_sad_epu8(acc, zero);
+        cnt += _mm_cvtsi128_si32(sum) + _mm_extract_epi16(sum, 4);
+        len -= blocks * 16;
+    }
+    return cnt + length_scalar(s, len);
+}
+
+__attribute__((target("avx2")))
+static bool ascii_avx2 (const unsigned char* s, size_t len) {
+    for (; len >= 128; len -= 128, s += 128) {
+        __m256i a = _mm256_or_si256(_mm256_loadu_si256((const __m256i*)s),        _mm256_loadu_si256((const __m256i*)(s + 32)));
+        __m256i b = _mm256_or_si256(_mm256_loadu_si256((const __m256i*)(s + 64)), _mm256_loadu_si256((const __m256i*)(s + 96)));
+        if (_mm256_movemask_epi8(_mm256_or_si256(a, b))) return false;
+    }
+    for (; len >= 32; len -= 32, s += 32) if (_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)s))) return false;
+    return ascii_scalar(s, len);
+}
+
+// Lookup algorithm by Keiser and Lemire ("Validating UTF-8 In Less Than One Instruction Per Byte"). Every error is a combination
+// of the high nibble of previous byte, its low nibble and the high nibble of current byte: each of them is mapped via 16-byte
+// table to the set of error kinds it allows, and the byte pair is bad if all three agree on some kind. Missing or extra 3rd/4th
+// continuation bytes are found by comparing bytes 2 and 3 positions back with 3- and 4-byte lead bytes.
+static const char TOO_SHORT  = 1 << 0; // lead or ASCII byte followed by lead byte
+static const char TOO_LONG   = 1 << 1; // ASCII followed by continuation
+static const char OVERLONG_3 = 1 << 2;
+static const char TOO_LARGE  = 1 << 3; // above U+10FFFF
+static const char SURROGATE  = 1 << 4;
+static const char OVERLONG_2 = 1 << 5;
+static const char OVERLONG_4 = 1 << 6; // also TOO_LARGE with 1000____ second byte, they never meet after the same lead byte
+static const char TWO_CONTS  = (char)(1 << 7);
+static const char CARRY      = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+#define PANDA_UTF8_TABLE(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+// previous <n> bytes: last bytes of prev followed by first bytes of input
+#define PANDA_UTF8_PREV(input, prev, n) _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - (n))
+
+__attribute__((target("avx2")))
+static inline __m256i utf8_errors_avx2 (__m256i input, __m256i prev_input) {
+    const __m256i byte1_high = PANDA_UTF8_TABLE(
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, // 0_______ ASCII
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,                                     // 10______ continuation
+        TOO_SHORT | OVERLONG_2,                                                         // 1100____
+        TOO_SHORT,                                                                      // 1101____
+        TOO_SHORT | OVERLONG_3 | SURROGATE,                                             // 1110____
+        TOO_SHORT | TOO_LARGE | OVERLONG_4                                              // 1111____
+    );
+    const __m256i byte1_low = PANDA_UTF8_TABLE(
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4, // ____0000
+        CARRY | OVERLONG_2,                           // ____0001
+        CARRY, CARRY,                                 // ____001_
+        CARRY | TOO_LARGE,                            // ____0100
+        CARRY | TOO_LARGE | OVERLONG_4,               // ____0101, OVERLONG_4 here means TOO_LARGE_1000
+        CARRY | TOO_LARGE | OVERLONG_4, CARRY | TOO_LARGE | OVERLONG_4,
+        CARRY | TOO_LARGE | OVERLONG_4, CARRY | TOO_LARGE | OVERLONG_4,
+        CARRY | TOO_LARGE | OVERLONG_4, CARRY | TOO_LARGE | OVERLONG_4,
+        CARRY | TOO_LARGE | OVERLONG_4,
+        CARRY | TOO_LARGE | OVERLONG_4 | SURROGATE,   // ____1101
+        CARRY | TOO_LARGE | OVERLONG_4, CARRY | TOO_LARGE | OVERLONG_4
+    );
+    const __m256i byte2_high = PANDA_UTF8_TABLE(
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, // 0_______
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | OVERLONG_4,                            // 1000____
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,                             // 1001____
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE  | TOO_LARGE,                             // 101_____
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE  | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT                                              // 11______
+    );
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+    __m256i prev1 = PANDA_UTF8_PREV(input, prev_input, 1);
+    __m256i special = _mm256_and_si256(
+        _mm256_and_si256(_mm256_shuffle_epi8(byte1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                         _mm256_shuffle_epi8(byte1_low, _mm256_and_si256(prev1, nibble))),
+        _mm256_shuffle_epi8(byte2_high, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble))
+    );
+
+    __m256i prev2 = PANDA_UTF8_PREV(input, prev_input, 2);
+    __m256i prev3 = PANDA_UTF8_PREV(input, prev_input, 3);
+    __m256i third  = _mm256_subs_epu8(prev2, _mm256_set1_epi8(0xE0 - 0x80)); // only 111_____ get high bit
+    __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xF0 - 0x80)); // only 1111____ get high bit
+    __m256i must_be_cont = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(TWO_CONTS));
+    return _mm256_xor_si256(must_be_cont, special); // 2 continuations are an error unless required by 3/4-byte lead
+}
+
+__attribute__((target("avx2")))
+static bool validate_avx2 (const unsigned char* s, size_t len) {
+    if (len < 32) return validate_scalar(s, len);
+    // lead bytes in the last 3 positions which need more bytes than left in the block
+    const __m256i incomplete_max = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                                    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)0xEF, (char)0xDF, (char)0xBF);
+    __m256i error      = _mm256_setzero_si256();
+    __m256i prev_input = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+
+    for (; len >= 32; len -= 32, s += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i*)s);
+        if (!_mm256_movemask_epi8(input)) error = _mm256_or_si256(error, incomplete);
+        else {
+            error = _mm256_or_si256(error, utf8_errors_avx2(input, prev_input));
+            incomplete = _mm256_subs_epu8(input, incomplete_max);
+            if (!_mm256_testz_si256(error, error)) return false;
+        }
+        prev_input = input;
+    }
+    if (len) { // tail padded with NULs: character cut by the end is followed by ASCII - an error
+        unsigned char buf[32] = {0};
+        std::memcpy(buf, s, len);
+        __m256i input = _mm256_loadu_si256((const __m256i*)buf);
+        error = _mm256_or_si256(error, utf8_errors_avx2(input, prev_input));
+        incomplete = _mm256_setzero_si256();
+    }
+    error = _mm256_or_si256(error, incomplete);
+    return _mm256_testz_si256(error, error);
+}
+
+#undef PANDA_UTF8_TABLE
+#undef PANDA_UTF8_PREV
+
+__attribute__((target("avx2")))
+static size_t length_avx2 (const unsigned char* s, size_t len) {
+    const __m256i zero  = _mm256_setzero_si256();
+    const __m256i limit = _mm256_set1_epi8(-65);
+    size_t cnt = 0;
+    while (len >= 32) {
+        size_t blocks = len / 32 > 255 ? 255 : len / 32;
+        __m256i acc = zero;
+        for (size_t i = 0; i < blocks; ++i, s += 32) acc = _mm256_sub_epi8(acc, _mm256_cmpgt_epi8(_mm256_loadu_si256((const __m256i*)s), limit));
+        __m256i sum = _mm256_sad_epu8(acc, zero);
+        cnt += _mm256_extract_epi64(sum, 0) + _mm256_extract_epi64(sum, 1) + _mm256_extract_epi64(sum, 2) + _mm256_extract_epi64(sum, 3);
+        len -= blocks * 32;
+    }
+    return cnt + length_scalar(s, len);
+}
+
+#endif
+
+struct kernels {
+    check_fn  ascii;
+    check_fn  validate;
+    length_fn length;
+};
+
+static kernels select_kernels () {
+    kernels k = {ascii_scalar, validate_scalar, length_scalar};
+#ifdef PANDA_UTF8_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        k.ascii    = ascii_avx2;
+        k.validate = validate_avx2;
+        k.length   = length_avx2;
+    }
+    else if (__builtin_cpu_supports("sse2")) {
+        k.ascii    = ascii_sse2;
+        k.validate = validate_sse2;
+        k.length   = length_sse2;
+    }
+#endif
+    return k;
+}
+
+// lazily: initialization order of statics in different translation units is unspecified
+static const kernels& impl () {
+    static const kernels k = select_kernels();
+    return k;
+}
+
+bool is_ascii (const char* str, size_t len) { return impl().ascii((const unsigned char*)str, len); }
+
+bool utf8_validate (const char* str, size_t len) { return impl().validate((const unsigned char*)str, len); }
+
+size_t utf8_length (const char* str, size_t len) { return impl().length((const unsigned char*)str, len); }
+
+}}
@@ -0,0 +1,17 @@
+#pragma once
+#include <stddef.h>
+
+namespace panda { namespace lib {
+
+// Byte classification kernels. Use AVX2/SSE2 when CPU supports it (chosen once, on first call), scalar code otherwise.
+
+bool is_ascii (const char* str, size_t len); // no bytes with high bit set
+
+// well-formed UTF-8 as defined by RFC 3629: no overlong forms, surrogates (U+D800..U+DFFF) or code points above U+10FFFF
+bool utf8_validate (const char* str, size_t len);
+
+// number of code points in valid UTF-8 (count of bytes which are not continuation bytes); for invalid input - count of lead bytes.
+// Name is parenthesized because perl headers define utf8_length() macro; callers which may see them do the same.
+size_t (utf8_length) (const char* str, size_t len);
+
+}}
@@ -12,31 +12,133 @@
 #include <algorithm> // min,max
 #include <stdexcept>
 #include <panda/iterator.h>
+#include <panda/lib/memory.h>
+#include <panda/lib/search.h>
+#include <panda/lib/hash.h>
+#include <panda/lib/utf8.h>
+#include <panda/lib/itoa.h>
 
 namespace panda {
 
 using std::size_t;
 
-class string {
+// buffer reference counter policies for basic_string
+struct plain_refcnt {
+    static size_t get (const size_t& cnt) { return cnt; }
+    static void   inc (size_t& cnt)       { ++cnt; }
+    static size_t dec (size_t& cnt)       { return --cnt; }
+};
+
+struct atomic_refcnt {
+    static size_t get (const size_t& cnt) { return __atomic_load_n(&cnt, __ATOMIC_ACQUIRE); }
+    static void   inc (size_t& cnt)       { __atomic_add_fetch(&cnt, 1, __ATOMIC_RELAXED); }
+    static size_t dec (size_t& cnt)       { return __atomic_sub_fetch(&cnt, 1, __ATOMIC_ACQ_REL); }
+};
+
+template <class Refcnt>
+class basic_string {
+public:
+    static const size_t MAX_SSO_CHARS = sizeof(void*) * 2 - 1; // strings up to this length are stored inline, without heap allocation
+
+    typedef void (*release_fn) (const char* ptr, void* ctx); // releases external memory shared by strings
+
 private:
+    struct buf_t {
+        size_t          refcnt;
+        size_t          capacity;
+        lib::allocator* alloc; // NULL for std::malloc
+        char*           data;  // right after header, or external read-only memory
+        uint64_t        hash;     // memoized hash64 of the first hash_len bytes
+        size_t          hash_len; // 0 - not memoized, HASH_BUSY - being memoized
+        char* start    ()       { return data; }
+        bool  external () const { return data != reinterpret_cast<const char*>(this + 1); }
+    };
+
+    struct ext_buf_t : buf_t {
+        release_fn release;
+        void*      ctx;
+    };
+
     union {
-        char*       buf; // heap pointer (possibly shared)
+        char*       buf; // writable pointer (inline storage or heap buffer, possibly with offset - substring window)
         const char* ptr; // external pointer
     } _u;
-    size_t _capacity; // _u.buf capacity. external pointer mode if capacity == 0
-    size_t _length;   // external/buffer string length
+    size_t _length; // external/inline/buffer basic_string length
+    union {
+        buf_t* _buf;                     // heap buffer (possibly shared). NULL in external pointer mode
+        char   _sso[MAX_SSO_CHARS + 1]; // inline storage. inline mode if _u.ptr == _sso
+    };
 
-    size_t* _buf_refcnt_ptr () { return (size_t*)(_u.buf - sizeof(size_t)); }
-    size_t  _buf_refcnt     () { return *_buf_refcnt_ptr(); }
-    size_t  _buf_refcnt_dec () { return --*_buf_refcnt_ptr(); }
-    size_t  _buf_refcnt_inc () { return ++*_buf_refcnt_ptr(); }
-    void    _buf_release    () { if (_capacity && _buf_refcnt_dec() <= 0) free(_buf_refcnt_ptr()); }
+    bool _is_sso  () const { return _u.ptr == _sso; }
+    bool _is_heap () const { return !_is_sso() && _buf; }
+    bool _is_own  (const char* p, size_t n) const { return p >= _u.ptr && p + n <= _u.ptr + _length; } // [p, p+n) is a part of our data, which may move
+    bool _in_buf  (const char* p) const { // <p> points into our heap buffer, maybe outside of our window: it may be moved or freed by reserve
+        return _is_heap() && p >= _buf->data && p <= _buf->data + _buf->capacity;
+    }
+
+    void _init () {
+        _u.ptr  = "";
+        _length = 0;
+        _buf    = NULL;
+    }
+
+    static const size_t HASH_BUSY = size_t(-1);
+
+    static void _buf_free (buf_t* heap) {
+        if (heap->external()) {
+            ext_buf_t* ext = static_cast<ext_buf_t*>(heap);
+            ext->release(ext->data, ext->ctx);
+            std::free(ext);
+        }
+        else if (heap->alloc) heap->alloc->deallocate(heap, sizeof(buf_t) + heap->capacity + 1);
+        else std::free(heap);
+    }
+
+    void _buf_release () { if (_is_heap() && Refcnt::dec(_buf->refcnt) == 0) _buf_free(_buf); }
+
+    // creates a new non-shared storage for <size> bytes and moves current data there. Current storage must be released by caller
+    void _new_storage (size_t size) {
+        const char* old = _u.ptr;
+        if (size <= MAX_SSO_CHARS) {
+            if (_length) std::memcpy(_sso, old, _length); // old data is never inline here, but _buf gets overwritten - caller must save it
+            _u.buf = _sso;
+        }
+        else {
+            lib::allocator* alloc = lib::get_string_allocator();
+            buf_t* heap;
+            if (alloc) heap = (buf_t*)alloc->allocate(sizeof(buf_t) + size + 1);
+            else if (!(heap = (buf_t*)std::malloc(sizeof(buf_t) + size + 1))) throw std::bad_alloc();
+            heap->refcnt = 1;
+            heap->capacity = size;
+            heap->alloc = alloc;
+            heap->hash_len = 0;
+            heap->data = reinterpret_cast<char*>(heap + 1);
+            if (_length) std::memcpy(heap->start(), old, _length);
+            _buf = heap;
+            _u.buf = heap->start();
+        }
+        _u.buf[_length] = 0;
+    }
+
+    // makes room for <size> bytes in non-shared heap buffer. If basic_string is a window with offset, data is moved to the beginning first.
+    void _unique_reserve (size_t size) {
+        char* start = _buf->start();
+        if (size_t(_u.buf - start) + size <= _buf->capacity) return;
+        if (_u.buf != start) {
+            std::memmove(start, _u.buf, _length);
+            _u.buf = start;
+        }
+        if (_buf->capacity < size) _realloc(size);
+    }
 
     void _realloc (size_t size) {
-        char* heap = (char*)std::realloc(_u.buf - sizeof(size_t), size + sizeof(size_t) + 1);
-        if (!heap) throw std::bad_alloc();
-        _u.buf = heap + sizeof(size_t);
-        _capacity = size;
+        buf_t* heap;
+        if (_buf->alloc) heap = (buf_t*)_buf->alloc->reallocate(_buf, sizeof(buf_t) + _buf->capacity + 1, sizeof(buf_t) + size + 1);
+        else if (!(heap = (buf_t*)std::realloc(_buf, sizeof(buf_t) + size + 1))) throw std::bad_alloc();
+        heap->capacity = size;
+        heap->data = reinterpret_cast<char*>(heap + 1);
+        _buf = heap;
+        _u.buf = heap->start();
     }
 
 public:
@@ -48,26 +150,37 @@ public:
     enum ref_t { REF = 0, COPY = 1 };
     static const size_t npos = std::basic_string<char>::npos;
 
-    string ()                                               : _capacity(0), _length(0)  { _u.ptr = ""; }
-    string (size_t n, char c)                               : _capacity(0) { assign(n, c); }
-    string (const char* p, ref_t ref = REF)                 : _capacity(0) { assign(p, ref); }
-    string (const char* p, size_t len, ref_t ref = REF)     : _capacity(0) { assign(p, len, ref); }
-    string (const string& s)                                : _capacity(0) { assign(s); }
-    string (const string& s, size_t pos, size_t len = npos) : _capacity(0) { assign(s, pos, len); }
-    explicit string (size_t n)                              : _capacity(0), _length(0) { reserve(n); }
+    basic_string ()                                               { _init(); }
+    basic_string (size_t n, char c)                               { _init(); assign(n, c); }
+    basic_string (const char* p, ref_t ref = REF)                 { _init(); assign(p, ref); }
+    basic_string (const char* p, size_t len, ref_t ref = REF)     { _init(); assign(p, len, ref); }
+    basic_string (const basic_string& s)                                { _init(); assign(s); }
+    basic_string (const basic_string& s, size_t pos, size_t len = npos) { _init(); assign(s, pos, len); }
+    basic_string (const char* p, size_t len, release_fn release, void* ctx) { _init(); assign(p, len, release, ctx); }
+    explicit basic_string (size_t n)                              { _init(); reserve(n); }
 
     size_t      size     () const { return _length; }
     size_t      length   () const { return _length; }
-    size_t      capacity () const { return _capacity; }
+    size_t      capacity () const { return _is_sso() ? MAX_SSO_CHARS : (_buf && !_buf->external() ? _buf->capacity - (_u.ptr - _buf->start()) : 0); }
     bool        empty    () const { return _length == 0; }
     const char* data     () const { return _u.ptr; }
-    const char* c_str    () const { return _u.ptr; }
+
+    const char* c_str () const {
+        if (_is_heap() && _u.ptr[_length]) { // substring window - terminate it (logically const)
+            basic_string* self = const_cast<basic_string*>(this);
+            if (Refcnt::get(_buf->refcnt) == 1 && !_buf->external()) self->_u.buf[_length] = 0;
+            else self->reserve(_length);
+        }
+        return _u.ptr;
+    }
     char*       buf      ()       { retain(); return _u.buf; }
 
-    void dump () {
+    void dump () const {
         std::printf(
-            "STRDUMP: DYN=%lu, LEN=%lu, CAP=%lu, DATA='%s', SA/BA=%lu/%lu\n",
-            _capacity ? _buf_refcnt() : 0, _length, _capacity, _u.ptr, (unsigned long)this, _capacity ? (unsigned long)_u.buf : 0
+            "STRDUMP: MODE=%s, DYN=%lu, LEN=%lu, CAP=%lu, OFFSET=%lu, DATA='%.*s', SA/BA=%lu/%lu\n",
+            _is_sso() ? "SSO" : (_buf ? (_buf->external() ? "SHARED" : "HEAP") : "EXT"), _is_heap() ? (unsigned long)Refcnt::get(_buf->refcnt) : 0, (unsigned long)_length,
+            (unsigned long)capacity(), _is_heap() ? (unsigned long)(_u.ptr - _buf->start()) : 0, (int)_length, _u.ptr,
+            (unsigned long)this, _is_heap() ? (unsigned long)_buf : 0
         );
     }
 
@@ -84,25 +197,26 @@ public:
     const_reverse_iterator crend   () const { return const_reverse_iterator(cbegin()); }
     const_reverse_iterator rend    () const { return crend(); }
 
-    string& retain () {
+    basic_string& retain () {
         reserve(_length);
         return *this;
     }
 
     char* reserve (size_t size) {
-        if (size == 0) size++; // zero _capacity (malloced = _capacity + 1) leads to memleaks
-        if (!_capacity || (_buf_refcnt() > 1 && _buf_refcnt_dec())) {
-            if (size < _length) size = _length;
-            char* heap = (char*)std::malloc(size + sizeof(size_t) + 1);
-            if (!heap) throw std::bad_alloc();
-            *(size_t*)heap = 1; // refcnt = 1
-            char* newbuf = heap + sizeof(size_t);
-            if (_length) std::memcpy(newbuf, _u.buf, _length);
-            newbuf[_length] = 0;
-            _u.buf = newbuf;
-            _capacity = size;
+        if (size < _length) size = _length;
+        if (_is_sso()) {
+            if (size > MAX_SSO_CHARS) _new_storage(size);
+        }
+        else if (!_buf) _new_storage(size);       // external pointer - detach
+        else if (Refcnt::get(_buf->refcnt) > 1 || _buf->external()) { // shared or read-only buffer - detach
+            buf_t* shared = _buf;
+            _new_storage(size);
+            if (Refcnt::dec(shared->refcnt) == 0) _buf_free(shared); // other owners may have gone meanwhile in another thread
+        }
+        else {
+            _buf->hash_len = 0; // may be modified
+            _unique_reserve(size);
         }
-        else if (_capacity < size) _realloc(size);
         return _u.buf;
     }
 
@@ -121,137 +235,220 @@ public:
     }
 
     void shrink_to_fit () {
-        if (_capacity <= _length) return;
-        if (_buf_refcnt() == 1) _realloc(_length);
-        else reserve(_length);
+        if (!_is_heap() || _buf->external() || _buf->capacity <= _length) return;
+        if (Refcnt::get(_buf->refcnt) > 1) reserve(_length);
+        else if (_length <= MAX_SSO_CHARS) {
+            buf_t* heap = _buf;
+            _new_storage(_length);
+            _buf_free(heap);
+        }
+        else {
+            if (_u.buf != _buf->start()) {
+                _buf->hash_len = 0;
+                std::memmove(_buf->start(), _u.buf, _length);
+                _buf->start()[_length] = 0;
+            }
+            _realloc(_length);
+        }
     }
 
-    string& assign (const string& s) {
+    basic_string& assign (const basic_string& s) {
+        if (this == &s) return *this;
+        if (s._is_sso()) return assign(s._u.ptr, s._length, COPY);
         _buf_release();
         _u.ptr = s._u.ptr;
         _length = s._length;
-        if ((_capacity = s._capacity)) _buf_refcnt_inc();
+        if ((_buf = s._buf)) Refcnt::inc(_buf->refcnt);
         return *this;
     }
-    string& assign (const string& s, size_t pos, size_t len = npos) {
+    basic_string& assign (const basic_string& s, size_t pos, size_t len = npos) {
         if (pos == 0 && len >= s._length) return assign(s);
         if (pos > s._length) throw std::out_of_range("string::assign");
         if (len > s._length - pos) len = s._length - pos;
-        return assign(s._u.ptr + pos, len, COPY); // need copy because pointers to partial buffers are not supported
+        if (!s._is_sso() && !s._buf) return assign(s._u.ptr + pos, len, REF); // window into the same external memory
+        if (s._is_sso() || len <= MAX_SSO_CHARS) return assign(s._u.ptr + pos, len, COPY); // no allocation anyway, and big buffer won't be held for a small piece
+        // window into shared heap buffer
+        if (this != &s) {
+            Refcnt::inc(s._buf->refcnt); // before release, as we may share the same buffer
+            _buf_release();
+            _buf = s._buf;
+        }
+        _u.ptr = s._u.ptr + pos;
+        _length = len;
+        return *this;
     }
-    string& assign (const char* p, ref_t ref = REF) {
+    basic_string& assign (const char* p, ref_t ref = REF) {
         return assign(p, std::strlen(p), ref);
     }
-    string& assign (const char* p, size_t len, ref_t ref = REF) {
+    basic_string& assign (const char* p, size_t len, ref_t ref = REF) {
         if (ref == COPY) {
+            if (_is_own(p, len)) { // detach may free the memory 'p' points to: old data is kept while moving to the new storage
+                size_t offset = p - _u.ptr;
+                char* buf = reserve(len);
+                std::memmove(buf, buf + offset, len);
+                buf[_length = len] = 0;
+                return *this;
+            }
+            if (_in_buf(p)) { // beyond our window, e.g. of a wider string sharing the buffer: reserve detaches from the held buffer
+                basic_string hold(*this);
+                _length = 0;
+                char* buf = reserve(len);
+                std::memcpy(buf, p, len);
+                buf[_length = len] = 0;
+                return *this;
+            }
             _length = 0; // prevent copying old data
-            if (!len) clear();
-            else std::memcpy(resize(len), p, len);
+            char* buf = reserve(len);
+            std::memmove(buf, p, len); // 'p' may point to our own data
+            buf[_length = len] = 0;
         }
         else {
             _buf_release();
             _u.ptr = p;
             _length = len;
+            _buf = NULL;
         }
         return *this;
     }
-    string& assign (size_t n, char c) {
+    basic_string& assign (const char* p, size_t len, release_fn release, void* ctx) {
+        ext_buf_t* ext = (ext_buf_t*)std::malloc(sizeof(ext_buf_t));
+        if (!ext) throw std::bad_alloc();
+        ext->refcnt   = 1;
+        ext->capacity = len;
+        ext->alloc    = NULL;
+        ext->hash_len = 0;
+        ext->data     = const_cast<char*>(p);
+        ext->release  = release;
+        ext->ctx      = ctx;
+        _buf_release();
+        _u.ptr  = p;
+        _length = len;
+        _buf    = ext;
+        return *this;
+    }
+    basic_string& assign (size_t n, char c) {
         _length = 0; // prevent copying old data
         if (!n) clear();
         else std::memset(resize(n), c, n);
         return *this;
     }
 
-    string& operator= (const string& source) { if (this != &source) assign(source); return *this; }
-    string& operator= (const char* ptr)      { return assign(ptr); }
-    string& operator= (char c)               { return assign(1, c); }
+    basic_string& operator= (const basic_string& source) { if (this != &source) assign(source); return *this; }
+    basic_string& operator= (const char* ptr)      { return assign(ptr); }
+    basic_string& operator= (char c)               { return assign(1, c); }
 
-    string& append (const string& s) {
+    basic_string& append (const basic_string& s) {
         return append(s._u.ptr, s._length);
     }
-    string& append (const string& s, size_t pos, size_t len = npos) {
+    basic_string& append (const basic_string& s, size_t pos, size_t len = npos) {
         if (pos > s._length) throw std::out_of_range("string::append");
         if (len > s._length - pos) len = s._length - pos;
         return append(s._u.ptr + pos, len);
     }
-    string& append (const char* p) {
+    basic_string& append (const char* p) {
         return append(p, std::strlen(p));
     }
-    string& append (const char* p, size_t n) {
+    basic_string& append (const char* p, size_t n) {
+        if (_is_own(p, n)) { // appending a part of ourselves: storage may be switched or reallocated by resize
+            size_t offset = p - _u.ptr;
+            resize(_length + n);
+            std::memcpy(_u.buf + _length - n, _u.buf + offset, n);
+            return *this;
+        }
+        if (_in_buf(p)) { // beyond our window, e.g. of a wider string sharing the buffer: resize detaches from the held buffer
+            basic_string hold(*this);
+            resize(_length + n);
+            std::memcpy(_u.buf + _length - n, p, n);
+            return *this;
+        }
         resize(_length + n);
         std::memcpy(_u.buf + _length - n, p, n);
         return *this;
     }
-    string& append (size_t n, char c) {
+    basic_string& append (size_t n, char c) {
         resize(_length + n);
         std::memset(_u.buf + _length - n, c, n);
         return *this;
     }
-    string& append (char c) {
+    basic_string& append (char c) {
         return append(1, c);
     }
+    basic_string& append_int (int64_t val) { // decimal representation
+        char tmp[lib::MAX_INT_CHARS];
+        return append(tmp, lib::itoa(val, tmp) - tmp);
+    }
+    basic_string& append_uint (uint64_t val) {
+        char tmp[lib::MAX_INT_CHARS];
+        return append(tmp, lib::utoa(val, tmp) - tmp);
+    }
 
-    string& operator+= (const string& s) { return append(s); }
-    string& operator+= (const char* p)   { return append(p); }
-    string& operator+= (char c)          { return append(1, c); }
+    basic_string& operator+= (const basic_string& s) { return append(s); }
+    basic_string& operator+= (const char* p)   { return append(p); }
+    basic_string& operator+= (char c)          { return append(1, c); }
     void    push_back  (char c)          { append(1, c); }
     void    pop_back   ()                { resize(_length-1); }
 
-    string& replace (size_t pos, size_t len, const string& s) {
+    basic_string& replace (size_t pos, size_t len, const basic_string& s) {
         return replace(pos, len, s._u.ptr, s._length);
     }
-    string& replace (iterator i1, iterator i2, const string& s) {
+    basic_string& replace (iterator i1, iterator i2, const basic_string& s) {
         return replace(i1 - begin(), i2 - i1, s._u.ptr, s._length);
     }
-    string& replace (size_t pos, size_t len, const string& s, size_t pos2, size_t len2 = npos) {
+    basic_string& replace (size_t pos, size_t len, const basic_string& s, size_t pos2, size_t len2 = npos) {
         if (pos2 > s._length) throw std::out_of_range("string::replace");
         if (len2 > s._length - pos2) len2 = s._length - pos2;
         return replace(pos, len, s._u.ptr + pos2, len2);
     }
-    string& replace (size_t pos, size_t len, const char* p) {
+    basic_string& replace (size_t pos, size_t len, const char* p) {
         return replace(pos, len, p, std::strlen(p));
     }
-    string& replace (iterator i1, iterator i2, const char* p) {
+    basic_string& replace (iterator i1, iterator i2, const char* p) {
         return replace(i1 - begin(), i2 - i1, p, std::strlen(p));
     }
-    string& replace (iterator i1, iterator i2, const char* p, size_t n) {
+    basic_string& replace (iterator i1, iterator i2, const char* p, size_t n) {
         return replace(i1 - begin(), i2 - i1, p, n);
     }
-    string& replace (size_t pos, size_t len, const char* p, size_t n) {
+    basic_string& replace (size_t pos, size_t len, const char* p, size_t n) {
+        if (n && (_is_own(p, n) || _in_buf(p))) { // data is about to move under <p>
+            basic_string tmp(p, n, COPY);
+            return replace(pos, len, tmp._u.ptr, n);
+        }
         if (pos > _length) throw std::out_of_range("string::replace");
         if (len > _length - pos) len = _length - pos;
-        char* buf = reserve(_length += n - len);
-        if (len != n) std::memmove(buf + pos + n, buf + pos + len, _length - n - pos);
+        size_t newlen = _length + n - len;
+        char* buf = reserve(newlen);
+        if (len != n) std::memmove(buf + pos + n, buf + pos + len, _length - len - pos);
         std::memcpy(buf + pos, p, n);
-        buf[_length] = 0;
+        buf[_length = newlen] = 0;
         return *this;
     }
-    string& replace (size_t pos, size_t len, size_t n, char c) {
+    basic_string& replace (size_t pos, size_t len, size_t n, char c) {
         if (pos > _length) throw std::out_of_range("string::replace");
         if (len > _length - pos) len = _length - pos;
-        char* buf = reserve(_length += n - len);
-        if (len != n) std::memmove(buf + pos + n, buf + pos + len, _length - n - pos);
+        size_t newlen = _length + n - len;
+        char* buf = reserve(newlen);
+        if (len != n) std::memmove(buf + pos + n, buf + pos + len, _length - len - pos);
         std::memset(buf + pos, c, n);
-        buf[_length] = 0;
+        buf[_length = newlen] = 0;
         return *this;
     }
-    string& replace (iterator i1, iterator i2, size_t n, char c) {
+    basic_string& replace (iterator i1, iterator i2, size_t n, char c) {
         return replace(i1 - begin(), i2 - i1, n, c);
     }
 
-    string& insert (size_t pos, const string& s) {
+    basic_string& insert (size_t pos, const basic_string& s) {
         return replace(pos, 0, s);
     }
-    string& insert (size_t pos, const string& s, size_t pos2, size_t len2 = npos) {
+    basic_string& insert (size_t pos, const basic_string& s, size_t pos2, size_t len2 = npos) {
         return replace(pos, 0, s, pos2, len2);
     }
-    string& insert (size_t pos, const char* p) {
+    basic_string& insert (size_t pos, const char* p) {
         return insert(pos, p, std::strlen(p));
     }
-    string& insert (size_t pos, const char* p, size_t n) {
+    basic_string& insert (size_t pos, const char* p, size_t n) {
         return replace(pos, 0, p, n);
     }
-    string& insert (size_t pos, size_t n, char c) {
+    basic_string& insert (size_t pos, size_t n, char c) {
         return replace(pos, 0, n, c);
     }
     void insert (iterator p, size_t n, char c) {
@@ -273,15 +470,20 @@ public:
         erase(pos, last - first);
         return begin() + pos;
     }
-    string& erase (size_t pos = 0, size_t len = npos) {
+    basic_string& erase (size_t pos = 0, size_t len = npos) {
         if (pos > _length) throw std::out_of_range("string::erase");
         if (len > _length - pos) len = _length - pos;
         if (len == _length) {
             clear();
             return *this;
         }
-        _length -= len;
+        if (_is_heap() && (pos == 0 || pos + len == _length)) { // just narrow the window, no copying
+            if (pos == 0) _u.ptr += len;
+            _length -= len;
+            return *this;
+        }
         char* buf = reserve(_length);
+        _length -= len;
         std::memmove(buf + pos, buf + pos + len, _length - pos);
         buf[_length] = 0;
         return *this;
@@ -290,30 +492,37 @@ public:
     int compare (size_t pos, size_t len, const char* p, size_t n) const {
         if (pos > _length) throw std::out_of_range("string::compare");
         if (len > _length - pos) len = _length - pos;
-        return std::strncmp(_u.ptr + pos, p, std::max(len, n));
+        int r = std::memcmp(_u.ptr + pos, p, std::min(len, n));
+        if (r) return r;
+        return len < n ? -1 : (len > n ? 1 : 0);
     }
-    int compare (size_t pos, size_t len, const string& s) const {
+    int compare (size_t pos, size_t len, const basic_string& s) const {
         return compare(pos, len, s._u.ptr, s._length);
     }
-    int compare (size_t pos, size_t len, const string& s, size_t pos2, size_t len2) const {
+    int compare (size_t pos, size_t len, const basic_string& s, size_t pos2, size_t len2) const {
         if (pos2 > s._length) throw std::out_of_range("string::compare");
         if (len2 > s._length - pos2) len2 = s._length - pos2;
         return compare(pos, len, s._u.ptr + pos2, len2);
     }
-    int compare (const string& s) const {
-        return compare(s._u.ptr);
+    int compare (const basic_string& s) const {
+        return compare(0, _length, s._u.ptr, s._length);
     }
     int compare (const char* p) const {
-        return std::strcmp(_u.ptr, p);
+        return compare(0, _length, p, std::strlen(p));
     }
     int compare (size_t pos, size_t len, const char* p) const {
         return compare(pos, len, p, std::strlen(p));
     }
 
-    void swap (string& s) {
+    void swap (basic_string& s) {
+        char tmp[sizeof(_sso)];
+        std::memcpy(tmp, _sso, sizeof(_sso)); // swaps _buf as well
+        std::memcpy(_sso, s._sso, sizeof(_sso));
+        std::memcpy(s._sso, tmp, sizeof(_sso));
         std::swap(_u.ptr, s._u.ptr);
         std::swap(_length, s._length);
-        std::swap(_capacity, s._capacity);
+        if (_u.ptr == s._sso) _u.buf = _sso;
+        if (s._u.ptr == _sso) s._u.buf = s._sso;
     }
 
     const char& at         (size_t pos) const { if (pos >= _length) throw std::out_of_range("string::at"); return _u.ptr[pos]; }
@@ -327,7 +536,7 @@ public:
     char&       back  ()       { return buf()[_length-1]; }
 
     void clear () {
-        if (_capacity) resize(0);
+        if (capacity()) resize(0);
         else assign("", 0);
     }
 
@@ -338,7 +547,7 @@ public:
         return len;
     }
 
-    size_t find (const string& str, size_t pos = 0) const {
+    size_t find (const basic_string& str, size_t pos = 0) const {
         return find(str._u.ptr, pos, str._length);
     }
     size_t find (const char* p, size_t pos = 0) const {
@@ -346,11 +555,9 @@ public:
     }
     size_t find (const char* p, size_t pos, size_t n) const {
         if (n == 0) return pos <= _length ? pos : npos;
-        if (n <= _length)
-            for (; pos <= _length - n; ++pos)
-                if (_u.ptr[pos] == p[0] && std::strncmp(_u.ptr + pos + 1, p + 1, n - 1) == 0)
-                    return pos;
-        return npos;
+        if (pos >= _length || n > _length - pos) return npos;
+        const char* found = lib::find_bytes(_u.ptr + pos, _length - pos, p, n);
+        return found ? (found - _u.ptr) : npos;
     }
     size_t find (char c, size_t pos = 0) const {
         if (pos > _length) return npos;
@@ -358,75 +565,175 @@ public:
         return found ? (found - _u.ptr) : npos;
     }
 
-    size_t rfind (const string& str, size_t pos = npos) const {
+    size_t rfind (const basic_string& str, size_t pos = npos) const {
         return rfind(str._u.ptr, pos, str._length);
     }
     size_t rfind (const char* p, size_t pos = npos) const {
         return rfind(p, pos, std::strlen(p));
     }
     size_t rfind (const char* p, size_t pos, size_t n) const {
-        if (n <= _length) {
-            pos = std::min(_length - n, pos);
-            do {
-                if (std::strncmp(_u.ptr + pos, p, n) == 0) return pos;
-            } while (pos-- > 0);
-        }
-        return npos;
+        if (n > _length) return npos;
+        pos = std::min(_length - n, pos);
+        const char* found = lib::rfind_bytes(_u.ptr, pos + n, p, n);
+        return found ? (found - _u.ptr) : npos;
     }
     size_t rfind (char c, size_t pos = npos) const {
-        if (size_t slen = _length) {
-            if (--slen > pos) slen = pos;
-            for (++slen; slen-- > 0; )
-                if (_u.ptr[slen] == c)
-                    return slen;
+        if (!_length) return npos;
+        const char* found = lib::rfind_char(_u.ptr, pos < _length ? pos + 1 : _length, c);
+        return found ? (found - _u.ptr) : npos;
+    }
+
+    size_t find_first_of (const basic_string& str, size_t pos = 0) const {
+        return find_first_of(str._u.ptr, pos, str._length);
+    }
+    size_t find_first_of (const char* p, size_t pos = 0) const {
+        return find_first_of(p, pos, std::strlen(p));
+    }
+    size_t find_first_of (const char* p, size_t pos, size_t n) const {
+        if (pos >= _length) return npos;
+        const char* found = lib::find_first_of(_u.ptr + pos, _length - pos, p, n);
+        return found ? (found - _u.ptr) : npos;
+    }
+    size_t find_first_of (char c, size_t pos = 0) const {
+        return find(c, pos);
+    }
+
+    size_t find_last_of (const basic_string& str, size_t pos = npos) const {
+        return find_last_of(str._u.ptr, pos, str._length);
+    }
+    size_t find_last_of (const char* p, size_t pos = npos) const {
+        return find_last_of(p, pos, std::strlen(p));
+    }
+    size_t find_last_of (const char* p, size_t pos, size_t n) const {
+        if (!_length) return npos;
+        const char* found = lib::find_last_of(_u.ptr, pos < _length ? pos + 1 : _length, p, n);
+        return found ? (found - _u.ptr) : npos;
+    }
+    size_t find_last_of (char c, size_t pos = npos) const {
+        return rfind(c, pos);
+    }
+
+    size_t find_first_not_of (const basic_string& str, size_t pos = 0) const {
+        return find_first_not_of(str._u.ptr, pos, str._length);
+    }
+    size_t find_first_not_of (const char* p, size_t pos = 0) const {
+        return find_first_not_of(p, pos, std::strlen(p));
+    }
+    size_t find_first_not_of (const char* p, size_t pos, size_t n) const {
+        if (pos >= _length) return npos;
+        const char* found = lib::find_first_not_of(_u.ptr + pos, _length - pos, p, n);
+        return found ? (found - _u.ptr) : npos;
+    }
+    size_t find_first_not_of (char c, size_t pos = 0) const {
+        return find_first_not_of(&c, pos, 1);
+    }
+
+    size_t find_last_not_of (const basic_string& str, size_t pos = npos) const {
+        return find_last_not_of(str._u.ptr, pos, str._length);
+    }
+    size_t find_last_not_of (const char* p, size_t pos = npos) const {
+        return find_last_not_of(p, pos, std::strlen(p));
+    }
+    size_t find_last_not_of (const char* p, size_t pos, size_t n) const {
+        if (!_length) return npos;
+        const char* found = lib::find_last_not_of(_u.ptr, pos < _length ? pos + 1 : _length, p, n);
+        return found ? (found - _u.ptr) : npos;
+    }
+    size_t find_last_not_of (char c, size_t pos = npos) const {
+        return find_last_not_of(&c, pos, 1);
+    }
+
+    // hash64 of the string. For heap strings starting at the beginning of their buffer it's computed once and memoized in
+    // the buffer, so that all copies share it. Memo is never overwritten while the buffer is shared (safe for atomic_string).
+    uint64_t hash () const {
+        if (!_is_heap() || !_length || _u.ptr != _buf->start()) return lib::hash64(_u.ptr, _length);
+        if (__atomic_load_n(&_buf->hash_len, __ATOMIC_ACQUIRE) == _length) return __atomic_load_n(&_buf->hash, __ATOMIC_RELAXED);
+        uint64_t h = lib::hash64(_u.ptr, _length);
+        size_t none = 0;
+        if (__atomic_compare_exchange_n(&_buf->hash_len, &none, HASH_BUSY, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&_buf->hash, h, __ATOMIC_RELAXED);
+            __atomic_store_n(&_buf->hash_len, _length, __ATOMIC_RELEASE);
         }
-        return npos;
+        return h;
     }
 
-    string substr (size_t pos = 0, size_t len = npos) const {
-        return string(*this, pos, len);
+    bool   is_ascii      () const { return lib::is_ascii(_u.ptr, _length); }
+    bool   utf8_validate () const { return lib::utf8_validate(_u.ptr, _length); }
+    size_t utf8_chars    () const { return (lib::utf8_length)(_u.ptr, _length); } // utf8_length() is a perl macro
+
+    // gives away exclusively owned std::malloc'ed buffer and becomes empty. Returns the beginning of memory block (to be freed
+    // via std::free), sets <offset> to the position of (NUL-terminated) data in it and <size> to the block size.
+    // Returns NULL and leaves the string untouched if buffer is inline, shared, external or comes from custom allocator.
+    void* release_buffer (size_t& offset, size_t& size) {
+        if (!_is_heap() || _buf->alloc || _buf->external() || Refcnt::get(_buf->refcnt) != 1) return NULL;
+        void* block = _buf;
+        _u.buf[_length] = 0;
+        offset = _u.buf - static_cast<char*>(block);
+        size   = sizeof(buf_t) + _buf->capacity + 1;
+        _init();
+        return block;
+    }
+
+    // returns <ctx> of external memory this string refers to, if it was shared with given <release> function; NULL otherwise
+    void* external_context (release_fn release) const {
+        if (!_is_heap() || !_buf->external()) return NULL;
+        const ext_buf_t* ext = static_cast<const ext_buf_t*>(_buf);
+        return ext->release == release ? ext->ctx : NULL;
+    }
+
+    basic_string substr (size_t pos = 0, size_t len = npos) const {
+        return basic_string(*this, pos, len);
     }
 
     operator std::string() const { return std::string(data(), _length); }
 
-    ~string () {
+    ~basic_string () {
         _buf_release();
     }
 };
 
-inline string operator+ (const string& lhs, const string& rhs) { return string(lhs).append(rhs); }
-inline string operator+ (const string& lhs, const char*   rhs) { return string(lhs).append(rhs); }
-inline string operator+ (const char*   lhs, const string& rhs) { return string(rhs).insert(0, lhs); }
-inline string operator+ (const string& lhs, char          rhs) { return string(lhs).append(1, rhs); }
-inline string operator+ (char          lhs, const string& rhs) { return string(rhs).insert(0, 1, lhs); }
+template <class R> const size_t basic_string<R>::MAX_SSO_CHARS;
+template <class R> const size_t basic_string<R>::npos;
+template <class R> const size_t basic_string<R>::HASH_BUSY;
+
+template <class R> inline basic_string<R> operator+ (const basic_string<R>& lhs, const basic_string<R>& rhs) { return basic_string<R>(lhs).append(rhs); }
+template <class R> inline basic_string<R> operator+ (const basic_string<R>& lhs, const char*            rhs) { return basic_string<R>(lhs).append(rhs); }
+template <class R> inline basic_string<R> operator+ (const char*            lhs, const basic_string<R>& rhs) { return basic_string<R>(rhs).insert(0, lhs); }
+template <class R> inline basic_string<R> operator+ (const basic_string<R>& lhs, char                   rhs) { return basic_string<R>(lhs).append(1, rhs); }
+template <class R> inline basic_string<R> operator+ (char                   lhs, const basic_string<R>& rhs) { return basic_string<R>(rhs).insert(0, 1, lhs); }
+
+template <class R> inline bool operator== (const basic_string<R>& lhs, const basic_string<R>& rhs) {
+    return lhs.length() == rhs.length() && (lhs.data() == rhs.data() || !std::memcmp(lhs.data(), rhs.data(), lhs.length()));
+}
+template <class R> inline bool operator== (const char*            lhs, const basic_string<R>& rhs) { return rhs.compare(lhs) == 0; }
+template <class R> inline bool operator== (const basic_string<R>& lhs, const char*            rhs) { return lhs.compare(rhs) == 0; }
 
-inline bool operator== (const string& lhs, const string& rhs) { return lhs.compare(rhs) == 0; }
-inline bool operator== (const char*   lhs, const string& rhs) { return rhs.compare(lhs) == 0; }
-inline bool operator== (const string& lhs, const char*   rhs) { return lhs.compare(rhs) == 0; }
+template <class R> inline bool operator!= (const basic_string<R>& lhs, const basic_string<R>& rhs) { return !(lhs == rhs); }
+template <class R> inline bool operator!= (const char*            lhs, const basic_string<R>& rhs) { return rhs.compare(lhs) != 0; }
+template <class R> inline bool operator!= (const basic_string<R>& lhs, const char*            rhs) { return lhs.compare(rhs) != 0; }
 
-inline bool operator!= (const string& lhs, const string& rhs) { return lhs.compare(rhs) != 0; }
-inline bool operator!= (const char*   lhs, const string& rhs) { return rhs.compare(lhs) != 0; }
-inline bool operator!= (const string& lhs, const char*   rhs) { return lhs.compare(rhs) != 0; }
+template <class R> inline bool operator<  (const basic_string<R>& lhs, const basic_string<R>& rhs) { return lhs.compare(rhs) < 0; }
+template <class R> inline bool operator<  (const char*            lhs, const basic_string<R>& rhs) { return rhs.compare(lhs) > 0; }
+template <class R> inline bool operator<  (const basic_string<R>& lhs, const char*            rhs) { return lhs.compare(rhs) < 0; }
 
-inline bool operator<  (const string& lhs, const string& rhs) { return lhs.compare(rhs) < 0; }
-inline bool operator<  (const char*   lhs, const string& rhs) { return rhs.compare(lhs) > 0; }
-inline bool operator<  (const string& lhs, const char*   rhs) { return lhs.compare(rhs) < 0; }
+template <class R> inline bool operator<= (const basic_string<R>& lhs, const basic_string<R>& rhs) { return lhs.compare(rhs) <= 0; }
+template <class R> inline bool operator<= (const char*            lhs, const basic_string<R>& rhs) { return rhs.compare(lhs) >= 0; }
+template <class R> inline bool operator<= (const basic_string<R>& lhs, const char*            rhs) { return lhs.compare(rhs) <= 0; }
 
-inline bool operator<= (const string& lhs, const string& rhs) { return lhs.compare(rhs) <= 0; }
-inline bool operator<= (const char*   lhs, const string& rhs) { return rhs.compare(lhs) >= 0; }
-inline bool operator<= (const string& lhs, const char*   rhs) { return lhs.compare(rhs) <= 0; }
+template <class R> inline bool operator>  (const basic_string<R>& lhs, const basic_string<R>& rhs) { return lhs.compare(rhs) > 0; }
+template <class R> inline bool operator>  (const char*            lhs, const basic_string<R>& rhs) { return rhs.compare(lhs) < 0; }
+template <class R> inline bool operator>  (const basic_string<R>& lhs, const char*            rhs) { return lhs.compare(rhs) > 0; }
 
-inline bool operator>  (const string& lhs, const string& rhs) { return lhs.compare(rhs) > 0; }
-inline bool operator>  (const char*   lhs, const string& rhs) { return rhs.compare(lhs) < 0; }
-inline bool operator>  (const string& lhs, const char*   rhs) { return lhs.compare(rhs) > 0; }
+template <class R> inline bool operator>= (const basic_string<R>& lhs, const basic_string<R>& rhs) { return lhs.compare(rhs) >= 0; }
+template <class R> inline bool operator>= (const char*            lhs, const basic_string<R>& rhs) { return rhs.compare(lhs) <= 0; }
+template <class R> inline bool operator>= (const basic_string<R>& lhs, const char*            rhs) { return lhs.compare(rhs) >= 0; }
 
-inline bool operator>= (const string& lhs, const string& rhs) { return lhs.compare(rhs) >= 0; }
-inline bool operator>= (const char*   lhs, const string& rhs) { return rhs.compare(lhs) <= 0; }
-inline bool operator>= (const string& lhs, const char*   rhs) { return lhs.compare(rhs) >= 0; }
+template <class R> inline void swap (basic_string<R>& l, basic_string<R>& r) { l.swap(r); }
 
-inline void swap (string& l, string& r) { l.swap(r); }
+template <class R> inline std::ostream& operator<< (std::ostream& os, const basic_string<R>& str) { return os.write(str.data(), str.length()); }
+template <class R> inline std::istream& operator>> (std::istream& is, basic_string<R>& str)       { return is >> str.buf(); }
 
-inline std::ostream& operator<< (std::ostream& os, const string& str) { return os << str.data(); }
-inline std::istream& operator>> (std::istream& is, string& str)       { return is >> str.buf(); }
+typedef basic_string<plain_refcnt>  string;
+typedef basic_string<atomic_refcnt> atomic_string; // buffers can be shared between threads
 
 };
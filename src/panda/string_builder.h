@@ -0,0 +1,157 @@
+#pragma once
+#include <panda/string.h>
+#include <vector>
+#include <sys/uio.h>
+
+namespace panda {
+
+// Accumulates output in a chain of chunks with geometric growth, so that appending never moves data already written.
+// Long strings are linked into the chain without copying (they share their buffers). The result is either flattened
+// once at the end (str) or written out directly from the chunks (iov + writev).
+template <class Refcnt>
+class basic_string_builder {
+public:
+    typedef basic_string<Refcnt> string_type;
+
+    static const size_t MIN_CHUNK = 256;         // capacity of the first chunk (unless reserved more)
+    static const size_t MAX_CHUNK = 1024 * 1024; // chunk capacity doubles until this size
+    static const size_t LINK_MIN  = 512;         // strings of at least this length are linked, not copied
+
+    basic_string_builder (size_t reserve = 0) : _length(0), _next(reserve > MIN_CHUNK ? reserve : size_t(MIN_CHUNK)), _tail(NULL) {}
+
+    // chunks are shared with the source (and detached by the first append to either), tail must point to our own copy
+    basic_string_builder (const basic_string_builder& b) :
+        _chunks(b._chunks), _length(b._length), _next(b._next), _tail(b._tail ? &_chunks.back() : NULL) {}
+
+    basic_string_builder& operator= (const basic_string_builder& b) {
+        _chunks = b._chunks;
+        _length = b._length;
+        _next   = b._next;
+        _tail   = b._tail ? &_chunks.back() : NULL;
+        return *this;
+    }
+
+    size_t length () const { return _length; }
+    size_t size   () const { return _length; }
+    bool   empty  () const { return _length == 0; }
+    size_t chunks () const { return _chunks.size(); }
+
+    const string_type& chunk (size_t i) const { return _chunks[i]; }
+
+    basic_string_builder& append (const char* p, size_t n) {
+        if (!n) return *this;
+        _length += n;
+        size_t room = _tail ? _tail->capacity() - _tail->length() : 0;
+        if (n <= room) {
+            _tail->append(p, n);
+            return *this;
+        }
+        if (room) {
+            _tail->append(p, room);
+            p += room;
+            n -= room;
+        }
+        std::memcpy(_new_chunk(n), p, n);
+        return *this;
+    }
+
+    basic_string_builder& append (size_t n, char c) {
+        if (!n) return *this;
+        _length += n;
+        size_t room = _tail ? _tail->capacity() - _tail->length() : 0;
+        if (n <= room) {
+            _tail->append(n, c);
+            return *this;
+        }
+        if (room) {
+            _tail->append(room, c);
+            n -= room;
+        }
+        std::memset(_new_chunk(n), c, n);
+        return *this;
+    }
+
+    basic_string_builder& append (const string_type& s) {
+        if (s.length() < LINK_MIN) return append(s.data(), s.length());
+        _chunks.push_back(s); // shares the buffer, next append starts a new chunk
+        _tail = NULL;
+        _length += s.length();
+        return *this;
+    }
+
+    basic_string_builder& append (const char* p) { return append(p, std::strlen(p)); }
+    basic_string_builder& append (char c)        { return append(&c, 1); }
+
+    basic_string_builder& append_int (int64_t val) {
+        char tmp[lib::MAX_INT_CHARS];
+        return append(tmp, lib::itoa(val, tmp) - tmp);
+    }
+    basic_string_builder& append_uint (uint64_t val) {
+        char tmp[lib::MAX_INT_CHARS];
+        return append(tmp, lib::utoa(val, tmp) - tmp);
+    }
+
+    basic_string_builder& operator+= (const string_type& s) { return append(s); }
+    basic_string_builder& operator+= (const char* p)        { return append(p); }
+    basic_string_builder& operator+= (char c)               { return append(&c, 1); }
+
+    basic_string_builder& operator<< (const string_type& s) { return append(s); }
+    basic_string_builder& operator<< (const char* p)        { return append(p); }
+    basic_string_builder& operator<< (char c)               { return append(&c, 1); }
+
+    // concatenation of all chunks. The only chunk is returned as is, without copying
+    string_type str () const {
+        if (_chunks.size() == 1) return _chunks[0];
+        string_type ret;
+        char* buf = ret.reserve(_length);
+        for (size_t i = 0; i < _chunks.size(); ++i) {
+            std::memcpy(buf, _chunks[i].data(), _chunks[i].length());
+            buf += _chunks[i].length();
+        }
+        ret.resize(_length);
+        return ret;
+    }
+
+    // fills at most <cnt> iovec structures (i.e. IOV_MAX) for writev() with chunks starting from <from>, returns number of filled ones
+    size_t iov (struct iovec* v, size_t cnt, size_t from = 0) const {
+        if (from >= _chunks.size()) return 0;
+        if (cnt > _chunks.size() - from) cnt = _chunks.size() - from;
+        for (size_t i = 0; i < cnt; ++i) {
+            v[i].iov_base = const_cast<char*>(_chunks[from + i].data());
+            v[i].iov_len  = _chunks[from + i].length();
+        }
+        return cnt;
+    }
+
+    void clear () {
+        _chunks.clear();
+        _tail = NULL;
+        _length = 0;
+        _next = MIN_CHUNK;
+    }
+
+private:
+    std::vector<string_type> _chunks;
+    size_t                   _length;
+    size_t                   _next;   // capacity of the next chunk
+    string_type*             _tail;   // last chunk if it's our own writable one
+
+    // starts a new chunk of <n> bytes (and room for more), returns pointer to write them to
+    char* _new_chunk (size_t n) {
+        size_t cap = n > _next ? n : _next;
+        if (_next < MAX_CHUNK) _next *= 2;
+        _chunks.push_back(string_type());
+        _tail = &_chunks.back();
+        _tail->reserve(cap);
+        return _tail->resize(n);
+    }
+};
+
+template <class R> const size_t basic_string_builder<R>::MIN_CHUNK;
+template <class R> const size_t basic_string_builder<R>::MAX_CHUNK;
+template <class R> const size_t basic_string_builder<R>::LINK_MIN;
+
+typedef basic_string_builder<plain_refcnt>  string_builder;
+typedef basic_string_builder<atomic_refcnt> atomic_string_builder;
+
+}
@@ -0,0 +1,248 @@
+#pragma once
+#include <panda/string.h>
+#include <new>
+#include <utility>
+#include <iterator>
+
+namespace panda {
+
+// Open-addressing hash table keyed by panda strings. Linear probing runs over a compact array of full 64-bit hashes
+// (0 - empty slot), entries live in a parallel array and are compared only when hashes match. Key hashes come from
+// basic_string::hash(), which is memoized in string buffers, so lookups with the same (or copied) key strings don't
+// rehash them. Erase uses backward shift deletion, there are no tombstones.
+template <class String, class Entry, class KeyOf>
+class basic_string_table {
+    template <class E, class T>
+    class base_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef E                         value_type;
+        typedef ptrdiff_t                 difference_type;
+        typedef E*                        pointer;
+        typedef E&                        reference;
+
+        base_iterator () : _t(NULL), _i(0) {}
+        base_iterator (T* t, size_t i) : _t(t), _i(i) {}
+        template <class E2, class T2>
+        base_iterator (const base_iterator<E2, T2>& it) : _t(it._t), _i(it._i) {}
+
+        E& operator*  () const { return _t->_entries[_i]; }
+        E* operator-> () const { return &_t->_entries[_i]; }
+
+        base_iterator& operator++ () {
+            do ++_i; while (_i < _t->capacity() && !_t->_hashes[_i]);
+            return *this;
+        }
+        base_iterator operator++ (int) { base_iterator ret = *this; ++*this; return ret; }
+
+        template <class E2, class T2> bool operator== (const base_iterator<E2, T2>& it) const { return _i == it._i; }
+        template <class E2, class T2> bool operator!= (const base_iterator<E2, T2>& it) const { return _i != it._i; }
+
+    private:
+        template <class, class> friend class base_iterator;
+        friend class basic_string_table;
+        T*     _t;
+        size_t _i;
+    };
+
+public:
+    typedef String                                                 key_type;
+    typedef Entry                                                  value_type;
+    typedef base_iterator<Entry, basic_string_table>               iterator;
+    typedef base_iterator<const Entry, const basic_string_table>   const_iterator;
+
+    static const size_t MIN_CAPACITY = 8;
+
+    basic_string_table (size_t reserve = 0) : _hashes(NULL), _entries(NULL), _mask(0), _size(0) { this->reserve(reserve); }
+
+    basic_string_table (const basic_string_table& t) : _hashes(NULL), _entries(NULL), _mask(0), _size(0) { _copy(t); }
+
+    basic_string_table& operator= (const basic_string_table& t) {
+        if (this != &t) {
+            _free();
+            _copy(t);
+        }
+        return *this;
+    }
+
+    size_t size     () const { return _size; }
+    bool   empty    () const { return _size == 0; }
+    size_t capacity () const { return _hashes ? _mask + 1 : 0; }
+
+    iterator       begin ()       { return iterator(this, _first()); }
+    iterator       end   ()       { return iterator(this, capacity()); }
+    const_iterator begin () const { return const_iterator(this, _first()); }
+    const_iterator end   () const { return const_iterator(this, capacity()); }
+
+    // use string in REF mode to lookup by const char* without copying: find(string(ptr, len))
+    iterator       find  (const String& key)       { return iterator(this, _find(key, _hash(key))); }
+    const_iterator find  (const String& key) const { return const_iterator(this, _find(key, _hash(key))); }
+    size_t         count (const String& key) const { return _find(key, _hash(key)) != capacity(); }
+
+    std::pair<iterator, bool> insert (const Entry& entry) {
+        const String& key = KeyOf()(entry);
+        uint64_t h = _hash(key);
+        size_t i = _find(key, h);
+        if (i != capacity()) return std::pair<iterator, bool>(iterator(this, i), false);
+        if ((_size + 1) * 5 > capacity() * 4) _rehash(capacity() ? capacity() * 2 : size_t(MIN_CAPACITY)); // max load factor 0.8
+        i = _place(h);
+        new (&_entries[i]) Entry(entry);
+        _hashes[i] = h;
+        ++_size;
+        return std::pair<iterator, bool>(iterator(this, i), true);
+    }
+
+    size_t erase (const String& key) {
+        size_t i = _find(key, _hash(key));
+        if (i == capacity()) return 0;
+        _erase(i);
+        return 1;
+    }
+
+    // other elements may be moved into the erased slot, so continuing iteration after erase is not supported
+    void erase (iterator it) { _erase(it._i); }
+
+    void reserve (size_t n) {
+        size_t cap = MIN_CAPACITY;
+        while (cap * 4 < n * 5) cap *= 2;
+        if (cap > capacity()) _rehash(cap);
+    }
+
+    void clear () {
+        for (size_t i = 0; i < capacity(); ++i) if (_hashes[i]) {
+            _entries[i].~Entry();
+            _hashes[i] = 0;
+        }
+        _size = 0;
+    }
+
+    ~basic_string_table () { _free(); }
+
+private:
+    uint64_t* _hashes;
+    Entry*    _entries;
+    size_t    _mask;
+    size_t    _size;
+
+    static uint64_t _hash (const String& key) {
+        uint64_t h = key.hash();
+        return h ? h : 1;
+    }
+
+    size_t _first () const {
+        size_t i = 0;
+        while (i < capacity() && !_hashes[i]) ++i;
+        return i;
+    }
+
+    size_t _find (const String& key, uint64_t h) const { // capacity() if not found
+        if (!_size) return capacity();
+        for (size_t i = h & _mask;; i = (i + 1) & _mask) {
+            uint64_t cur = _hashes[i];
+            if (!cur) return capacity();
+            if (cur == h && KeyOf()(_entries[i]) == key) return i;
+        }
+    }
+
+    size_t _place (uint64_t h) const { // first empty slot for hash
+        size_t i = h & _mask;
+        while (_hashes[i]) i = (i + 1) & _mask;
+        return i;
+    }
+
+    void _erase (size_t i) {
+        _entries[i].~Entry();
+        _hashes[i] = 0;
+        --_size;
+        for (size_t j = (i + 1) & _mask; _hashes[j]; j = (j + 1) & _mask) {
+            size_t home = _hashes[j] & _mask;
+            bool stays = i < j ? (home > i && home <= j) : (home > i || home <= j); // home is cyclically in (i, j]
+            if (stays) continue;
+            new (&_entries[i]) Entry(_entries[j]);
+            _hashes[i] = _hashes[j];
+            _entries[j].~Entry();
+            _hashes[j] = 0;
+            i = j;
+        }
+    }
+
+    void _rehash (size_t cap) {
+        uint64_t* hashes  = (uint64_t*)std::calloc(cap, sizeof(uint64_t));
+        Entry*    entries = (Entry*)std::malloc(cap * sizeof(Entry));
+        if (!hashes || !entries) {
+            std::free(hashes);
+            std::free(entries);
+            throw std::bad_alloc();
+        }
+        uint64_t* old_hashes  = _hashes;
+        Entry*    old_entries = _entries;
+        size_t    old_cap     = capacity();
+        _hashes  = hashes;
+        _entries = entries;
+        _mask    = cap - 1;
+        for (size_t i = 0; i < old_cap; ++i) if (old_hashes[i]) { // full hashes are stored, no need to rehash keys
+            size_t j = _place(old_hashes[i]);
+            new (&_entries[j]) Entry(old_entries[i]);
+            _hashes[j] = old_hashes[i];
+            old_entries[i].~Entry();
+        }
+        std::free(old_hashes);
+        std::free(old_entries);
+    }
+
+    void _copy (const basic_string_table& t) {
+        if (!t._size) return;
+        _rehash(t.capacity());
+        for (size_t i = 0; i < t.capacity(); ++i) if (t._hashes[i]) {
+            new (&_entries[i]) Entry(t._entries[i]);
+            _hashes[i] = t._hashes[i];
+        }
+        _size = t._size;
+    }
+
+    void _free () {
+        clear();
+        std::free(_hashes);
+        std::free(_entries);
+        _hashes  = NULL;
+        _entries = NULL;
+        _mask    = 0;
+    }
+};
+
+template <class S, class E, class K> const size_t basic_string_table<S,E,K>::MIN_CAPACITY;
+
+template <class String, class V>
+struct _string_map_key {
+    const String& operator() (const std::pair<const String, V>& entry) const { return entry.first; }
+};
+
+template <class String>
+struct _string_set_key {
+    const String& operator() (const String& entry) const { return entry; }
+};
+
+template <class V, class String = string>
+class string_map : public basic_string_table<String, std::pair<const String, V>, _string_map_key<String, V> > {
+public:
+    typedef V mapped_type;
+
+    string_map (size_t reserve = 0) : basic_string_table<String, std::pair<const String, V>, _string_map_key<String, V> >(reserve) {}
+
+    V& operator[] (const String& key) {
+        typename string_map::iterator it = this->find(key);
+        if (it == this->end()) it = this->insert(std::pair<const String, V>(key, V())).first;
+        return it->second;
+    }
+};
+
+template <class String>
+class basic_string_set : public basic_string_table<String, String, _string_set_key<String> > {
+public:
+    basic_string_set (size_t reserve = 0) : basic_string_table<String, String, _string_set_key<String> >(reserve) {}
+};
+
+typedef basic_string_set<string>        string_set;
+typedef basic_string_set<atomic_string> atomic_string_set;
+
+}
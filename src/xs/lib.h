@@ -3,3 +3,4 @@
 #include <xs/lib/clone.h>
 #include <xs/lib/merge.h>
 #include <xs/lib/cmp.h>
+#include <xs/lib/utf8.h>
@@ -1,5 +1,8 @@
-#include <map>
+#include <vector>
+#include <pthread.h>
 #include <panda/lib.h>
+#include <panda/lib/ptr_map.h>
+#include <xs/lib/lib.h>
 #include <xs/lib/clone.h>
 
 #ifndef gv_fetchmeth
@@ -8,49 +11,177 @@
 
 namespace xs { namespace lib {
 
-typedef std::map<uint64_t, SV*> CloneMap;
-static const int CLONE_MAX_DEPTH = 10000;
+typedef panda::lib::ptr_map<SV*> CloneMap; // source referent -> cloned referent
+
+// Clone is iterative: containers being cloned are kept on an explicit stack of frames, each remembering the position of the
+// next element, so that C stack use doesn't depend on data depth and the work stack grows only with depth, not width.
+struct CloneFrame {
+    SV*    source; // AV or HV
+    SV*    dest;
+    size_t depth;  // number of references from the root to container
+    size_t i;      // AV: next index, HV: next bucket
+    HE*    entry;  // HV: next entry in current bucket
+};
+
+// In non-cross mode a referent met twice on the path from the root means a cycle. Path is tracked only deeper than
+// PATH_CHECK_DEPTH references, to keep ordinary data free from this cost; any cycle is still found once the path repeats.
+static const size_t PATH_CHECK_DEPTH = 1000;
+
+struct CloneContext {
+    bool                        cross;
+    bool                        hold;        // clone_session: clones in map may be freed by caller between calls, keep them alive
+    I32                         setsv_flags; // for string leaves
+    CloneMap                    map;     // fclone: already cloned referents
+    std::vector<CloneFrame>     stack;
+    std::vector<SV*>            path;    // clone: referents at depth PATH_CHECK_DEPTH and deeper
+    panda::lib::ptr_map<bool>   on_path; // clone: same as path, for lookup
+    std::vector<SV*>            held;    // clone_session: referenced clones from map, released with context
+};
 
 static MGVTBL clone_marker;
 
-static void _clone (SV* dest, SV* source, CloneMap* map, I32 depth);
+// Context is reused between calls in the same thread to avoid reallocating and growing its containers every time.
+// Nested calls (clone() from CLONE callback) find it taken and use their own.
+static __thread CloneContext* cached_ctx = NULL;
+static pthread_key_t          cached_ctx_key;
+static pthread_once_t         cached_ctx_once = PTHREAD_ONCE_INIT;
 
-SV* clone (SV* source, bool cross) {
-    SV* ret = newSV(0);
-    try {
-        if (cross) {
-            CloneMap map;
-            _clone(ret, source, &map, 0);
+static void cached_ctx_free       (void* ctx) { delete (CloneContext*)ctx; }
+static void cached_ctx_key_create ()          { pthread_key_create(&cached_ctx_key, cached_ctx_free); }
+
+static CloneContext* context_acquire (SV* source, int flags) {
+    CloneContext* ctx = cached_ctx;
+    if (ctx) {
+        cached_ctx = NULL;
+        pthread_setspecific(cached_ctx_key, NULL);
+    }
+    else ctx = new CloneContext();
+    bool cross = flags & CLONE_CROSS;
+    ctx->cross = cross;
+    ctx->hold  = false;
+    ctx->setsv_flags = SV_GMAGIC | SV_NOSTEAL | (flags & CLONE_NO_COW ? 0 : SV_COW_FLAGS);
+
+    if (cross) {
+        size_t estimate = 0; // cheap estimate of referents count: top-level container size
+        if (source && SvROK(source)) {
+            SV* val = SvRV(source);
+            if (SvTYPE(val) == SVt_PVAV) estimate = AvFILLp((AV*)val) + 1;
+            else if (SvTYPE(val) == SVt_PVHV) estimate = HvUSEDKEYS((HV*)val);
         }
-        else _clone(ret, source, NULL, 0);
-    } catch (int val) {
-        SvREFCNT_dec(ret);
-        croak("clone: max depth (%d) reached, it looks like you passed a cycled structure", CLONE_MAX_DEPTH);
+        ctx->map.reserve(estimate + 1);
+    }
+    return ctx;
+}
+
+static void context_release (pTHX_ void* p) {
+    CloneContext* ctx = (CloneContext*)p;
+    for (size_t i = 0; i < ctx->held.size(); ++i) SvREFCNT_dec(ctx->held[i]);
+    ctx->held.clear();
+    if (cached_ctx) {
+        delete ctx;
+        return;
     }
+    ctx->map.clear();
+    ctx->stack.clear();
+    ctx->path.clear();
+    ctx->on_path.clear();
+    pthread_once(&cached_ctx_once, cached_ctx_key_create);
+    pthread_setspecific(cached_ctx_key, ctx);
+    cached_ctx = ctx;
+}
+
+static bool _clone (CloneContext* ctx, SV* dest, SV* source);
+
+// remembers clone of a referent in map
+static inline void _map_set (CloneContext* ctx, SV** slot, SV* clone) {
+    *slot = clone;
+    if (ctx->hold) ctx->held.push_back(SvREFCNT_inc_simple_NN(clone));
+}
+
+// sources are sources[0], sources[step], ... sources[(cnt-1)*step]
+static void _clone_many (SV* const* sources, size_t step, size_t cnt, SV** dest, int flags) {
+    if (!cnt) return;
+    if (flags & CLONE_SHARED) flags |= CLONE_CROSS;
+    CloneContext* ctx = context_acquire(sources[0], flags);
+    bool reset_map = !(flags & CLONE_SHARED) && cnt > 1;
+    ENTER;
+    SAVEDESTRUCTOR_X(context_release, ctx); // context is released even if CLONE callback dies
+    size_t i = 0;
+    bool ok = true;
+    for (; i < cnt; ++i) {
+        if (i && reset_map) ctx->map.clear();
+        dest[i] = newSV(0);
+        if (!(ok = _clone(ctx, dest[i], sources[i * step]))) break;
+    }
+    LEAVE;
+    if (!ok) {
+        for (size_t j = 0; j <= i; ++j) SvREFCNT_dec(dest[j]);
+        croak("clone: cycled structure can't be cloned, use fclone");
+    }
+}
+
+SV* clone (SV* source, int flags) {
+    SV* ret;
+    _clone_many(&source, 0, 1, &ret, flags);
     return ret;
 }
 
-static void _clone (SV* dest, SV* source, CloneMap* map, I32 depth) {
-    if (depth > CLONE_MAX_DEPTH) throw 1;
+void clone (SV* const* sources, size_t cnt, SV** dest, int flags) { _clone_many(sources, 1, cnt, dest, flags); }
+
+void clone (SV* source, size_t cnt, SV** dest, int flags) { _clone_many(&source, 0, cnt, dest, flags); }
 
-    if (SvROK(source)) { // reference
+// context is taken on first clone, so that sessions which clone nothing cost nothing. ENTER here pairs with LEAVE in
+// destructor; if perl dies in between, context is released while unwinding and destructor is never called
+SV* clone_session::clone (SV* source) {
+    if (!_ctx) {
+        _ctx = context_acquire(NULL, _flags);
+        _ctx->hold = true;
+        ENTER;
+        SAVEDESTRUCTOR_X(context_release, _ctx);
+    }
+    SV* ret = newSV(0);
+    _clone(_ctx, ret, source); // cross mode never fails
+    return ret;
+}
+
+clone_session::~clone_session () { if (_ctx) LEAVE; }
+
+// registers referent met at <depth> references from the root, returns false if it's already on the path
+static inline bool _path_enter (CloneContext* ctx, SV* val, size_t depth) {
+    std::vector<SV*>& path = ctx->path;
+    size_t keep = depth > PATH_CHECK_DEPTH ? depth - PATH_CHECK_DEPTH : 0;
+    while (path.size() > keep) { // leave referents which are not ancestors of this one
+        ctx->on_path.erase(path.back());
+        path.pop_back();
+    }
+    if (depth < PATH_CHECK_DEPTH) return true;
+    path.push_back(val);
+    return ctx->on_path.insert(val, true);
+}
+
+// clones scalars and references in place, for arrays and hashes sets up dest and pushes a frame to clone their elements
+static inline bool _clone_item (CloneContext* ctx, SV* dest, SV* source, size_t depth) {
+    while (SvROK(source)) { // reference
         SV* source_val = SvRV(source);
         svtype val_type = SvTYPE(source_val);
 
         if (unlikely(val_type == SVt_PVCV || val_type == SVt_PVIO)) { // CV and IO cannot be copied - just set reference to the same SV
             SvSetSV_nosteal(dest, source);
-            return;
+            return true;
         }
 
-        if (map) {
-            uint64_t id = PTR2UV(source_val);
-            CloneMap::iterator it = map->find(id);
-            if (it != map->end()) {
-                SvSetSV_nosteal(dest, it->second);
-                return;
+        SV** cloned = NULL;
+        if (ctx->cross) {
+            bool inserted;
+            cloned = ctx->map.insert(source_val, NULL, inserted);
+            if (!inserted) { // new reference to the same clone. Map keeps referents, not references: they may be copied and freed by caller
+                sv_upgrade(dest, SVt_RV);
+                SvRV_set(dest, SvREFCNT_inc_simple_NN(*cloned));
+                SvROK_on(dest);
+                return true;
             }
-            (*map)[id] = dest;
         }
+        else if (!_path_enter(ctx, source_val, depth)) return false;
 
         GV* cloneGV;
         bool is_object = SvOBJECT(source_val);
@@ -74,18 +205,24 @@ static void _clone (SV* dest, SV* source, CloneMap* map, I32 depth) {
             FREETMPS; LEAVE;
             // remove cloning flag from object's magic
             sv_unmagicext(source_val, PERL_MAGIC_ext, &clone_marker);
-            return;
+            if (ctx->cross) {
+                if (SvROK(dest)) _map_set(ctx, ctx->map.find(source_val), SvRV(dest));
+                else ctx->map.erase(source_val); // not a reference: nothing to share, other occurrences call CLONE again
+            }
+            return true;
         }
 
         SV* refval = newSV(0);
+        if (cloned) _map_set(ctx, cloned, refval);
         sv_upgrade(dest, SVt_RV);
         SvRV_set(dest, refval);
         SvROK_on(dest);
 
         if (is_object) sv_bless(dest, SvSTASH(source_val)); // cloning an object without any specific clone behavior
-        _clone(refval, source_val, map, depth+1);
 
-        return;
+        dest   = refval;
+        source = source_val;
+        ++depth;
     }
 
     switch (SvTYPE(source)) {
@@ -99,53 +236,75 @@ static void _clone (SV* dest, SV* source, CloneMap* map, I32 depth) {
 #if PERL_VERSION > 16
         case SVt_REGEXP: // regexp
 #endif
-            SvSetSV_nosteal(dest, source);
-            return;
+            sv_setsv_flags(dest, source, ctx->setsv_flags); // string buffers are shared until either side is modified
+            return true;
 #if PERL_VERSION <= 16 // fix bug in SvSetSV_nosteal while copying regexp SV prior to perl 5.16.0
         case SVt_REGEXP: // regexp
             SvSetSV_nosteal(dest, source);
             if (SvSTASH(dest) == NULL) SvSTASH_set(dest, gv_stashpv("Regexp",0));
-            return;
+            return true;
 #endif
         case SVt_PVAV: { // array
             sv_upgrade(dest, SVt_PVAV);
-            SV** srclist = AvARRAY((AV*)source);
             SSize_t srcfill = AvFILLp((AV*)source);
+            if (srcfill < 0) return true;
             av_extend((AV*)dest, srcfill); // dest is an empty array. we can set directly it's SV** array for speed
             AvFILLp((AV*)dest) = srcfill; // set array len
-            SV** dstlist = AvARRAY((AV*)dest);
-            for (SSize_t i = 0; i <= srcfill; ++i) {
-                SV* srcval = *srclist++;
-                if (srcval != NULL) { // if not empty slot
-                    SV* elem = newSV(0);
-                    dstlist[i] = elem;
-                    _clone(elem, srcval, map, depth+1);
-                }
-            }
-            return;
+            CloneFrame frame = {source, dest, depth, 0, NULL};
+            ctx->stack.push_back(frame);
+            return true;
         }
         case SVt_PVHV: { // hash
             sv_upgrade(dest, SVt_PVHV);
-            STRLEN hvmax = HvMAX((HV*)source);
-            HE** hvarr = HvARRAY((HV*)source);
-            if (!hvarr) return;
-
-            for (STRLEN i = 0; i <= hvmax; ++i) {
-                const HE* entry;
-                for (entry = hvarr[i]; entry; entry = HeNEXT(entry)) {
-                    HEK* hek = HeKEY_hek(entry);
-                    SV* elem = newSV(0);
-                    hv_storehek((HV*)dest, hek, elem);
-                    _clone(elem, HeVAL(entry), map, depth+1);
-                }
-            }
-
-            return;
+            STRLEN keys = HvUSEDKEYS((HV*)source);
+            if (!HvARRAY((HV*)source) || !keys) return true;
+            hv_ksplit((HV*)dest, keys); // presize, so that dest doesn't split while filling. hv_storehek reuses shared keys with their hashes
+            CloneFrame frame = {source, dest, depth, 0, NULL};
+            ctx->stack.push_back(frame);
+            return true;
         }
         case SVt_NULL: // undef
         default: // BIND, LVALUE, FORMAT - are not copied
-            return;
+            return true;
     }
 }
 
+static bool _clone (CloneContext* ctx, SV* dest, SV* source) {
+    std::vector<CloneFrame>& stack = ctx->stack;
+    size_t base = stack.size();
+    if (!_clone_item(ctx, dest, source, 0)) return false;
+
+    while (stack.size() > base) {
+        CloneFrame& frame = stack.back();
+        SV* srcval = NULL;
+        SV* elem;
+        if (SvTYPE(frame.source) == SVt_PVAV) {
+            AV* av = (AV*)frame.source;
+            while (!srcval && (SSize_t)frame.i <= AvFILLp(av)) srcval = AvARRAY(av)[frame.i++]; // skip empty slots
+            if (!srcval) {
+                stack.pop_back();
+                continue;
+            }
+            elem = newSV(0);
+            AvARRAY((AV*)frame.dest)[frame.i - 1] = elem;
+        }
+        else {
+            HV* hv = (HV*)frame.source;
+            HE* entry = frame.entry;
+            while (!entry && frame.i <= HvMAX(hv)) entry = HvARRAY(hv)[frame.i++];
+            if (!entry) {
+                stack.pop_back();
+                continue;
+            }
+            frame.entry = HeNEXT(entry);
+            elem = newSV(0);
+            hv_storehek((HV*)frame.dest, HeKEY_hek(entry), elem);
+            srcval = HeVAL(entry);
+        }
+        if (!_clone_item(ctx, elem, srcval, frame.depth)) return false; // may push and invalidate frame
+    }
+
+    return true;
+}
+
 }}
@@ -1,9 +1,39 @@
 #pragma once
-#include <map>
 #include <xs/xs.h>
 
 namespace xs { namespace lib {
 
-SV* clone (SV* source, bool cross);
+const int CLONE_CROSS  = 1; // keep cross-references and cycles (fclone)
+const int CLONE_NO_COW = 2; // copy string buffers instead of sharing them via perl's copy-on-write
+const int CLONE_SHARED = 4; // batch clone: data shared between sources stays shared between clones (implies CLONE_CROSS)
+
+SV* clone (SV* source, int flags = 0);
+
+// batch clone: clones 'cnt' sources into new SVs written to dest, sharing clone state (context, cross-references map) between them
+void clone (SV* const* sources, size_t cnt, SV** dest, int flags = 0);
+
+// clones the same source 'cnt' times
+void clone (SV* source, size_t cnt, SV** dest, int flags = 0);
+
+struct CloneContext;
+
+// Series of cross-mode clones sharing one cross-references map, for callers that clone many parts of one structure
+// separately (merge with MERGE_COPY_SOURCE): referents met again are not cloned twice and stay shared between results.
+// Session keeps a reference to every clone it may return again, so caller may free results meanwhile.
+// Must be destroyed in the same perl scope it first cloned in.
+class clone_session {
+public:
+    clone_session (int flags = 0) : _flags(flags | CLONE_CROSS), _ctx(NULL) {}
+    ~clone_session ();
+
+    SV* clone (SV* source);
+
+private:
+    int           _flags;
+    CloneContext* _ctx;
+
+    clone_session (const clone_session&);
+    clone_session& operator= (const clone_session&);
+};
 
 }}
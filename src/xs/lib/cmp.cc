@@ -1,32 +1,159 @@
+#include <new>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
 #include <stdint.h>
+#include <panda/lib.h>
+#include <panda/lib/ptr_map.h>
 #include <xs/lib/cmp.h>
 
 namespace xs { namespace lib {
 
-static inline bool _elem_cmp (SV* f, SV* s) {
-    if (f == s) return true;
+// Compare remembers compared pairs of containers only when it gets deep (maybe a cycle) or big (maybe a DAG with shared parts
+// compared once per path), so that usual small compares don't pay for it. Pair met again is considered equal: either it was
+// already compared equal, or it's being compared up the path (a cycle) and any difference will be found there, making the whole
+// result false (a difference anywhere makes compare false).
+static const size_t CMP_MEMO_DEPTH = 64;
+static const size_t CMP_MEMO_COUNT = 256;
+
+// set of pointer pairs, open addressing, linear probing, like panda::lib::ptr_map
+class CmpPairSet {
+public:
+    CmpPairSet () : _entries(NULL), _cap(0), _shift(64), _size(0) {}
+    ~CmpPairSet () { std::free(_entries); }
+
+    // returns false if pair is already in set
+    bool insert (const void* a, const void* b) {
+        if ((_size + 1) * 2 > _cap) _rehash(_cap ? _cap * 2 : 64);
+        size_t i = _slot(a, b);
+        for (;; i = (i + 1) & (_cap - 1)) {
+            entry& e = _entries[i];
+            if (!e.a) break;
+            if (e.a == a && e.b == b) return false;
+        }
+        _entries[i].a = a;
+        _entries[i].b = b;
+        ++_size;
+        return true;
+    }
+
+private:
+    struct entry { const void* a; const void* b; };
+
+    entry* _entries;
+    size_t _cap;
+    int    _shift;
+    size_t _size;
+
+    CmpPairSet (const CmpPairSet&);
+    CmpPairSet& operator= (const CmpPairSet&);
+
+    size_t _slot (const void* a, const void* b) const {
+        return size_t(((uint64_t)(uintptr_t)a * 0x9E3779B97F4A7C15ULL ^ (uint64_t)(uintptr_t)b * 0xC2B2AE3D27D4EB4FULL) >> _shift);
+    }
+
+    void _rehash (size_t cap) {
+        entry* entries = (entry*)std::calloc(cap, sizeof(entry));
+        if (!entries) throw std::bad_alloc();
+        entry* old     = _entries;
+        size_t old_cap = _cap;
+        _entries = entries;
+        _cap     = cap;
+        _shift   = 64;
+        while (cap >>= 1) --_shift;
+        for (size_t i = 0; i < old_cap; ++i) if (old[i].a) {
+            size_t j = _slot(old[i].a, old[i].b);
+            while (_entries[j].a) j = (j + 1) & (_cap - 1);
+            _entries[j] = old[i];
+        }
+        std::free(old);
+    }
+};
+
+// Compare is iterative, like clone and fingerprint: a frame per pair of containers being compared, so that C stack use doesn't
+// depend on data depth (long linked lists, long rings walked until the memo catches them). The current frame is kept in locals,
+// only its ancestors are on the stack.
+struct CmpFrame {
+    SV*    f;     // AV or HV
+    SV*    s;
+    size_t i;     // AV: next index, HV: next bucket
+    HE*    entry; // HV: next entry in current bucket
+};
+
+// first frames are kept in place, so that usual shallow compares don't allocate
+static const size_t CMP_LOCAL_FRAMES = 16;
+
+class CmpStack {
+public:
+    CmpStack () : _size(0) {}
+
+    bool   empty () const { return !_size; }
+    size_t size  () const { return _size; }
+
+    void push (const CmpFrame& frame) {
+        if (_size < CMP_LOCAL_FRAMES) _local[_size] = frame;
+        else _more.push_back(frame);
+        ++_size;
+    }
+
+    void pop (CmpFrame& frame) {
+        if (--_size < CMP_LOCAL_FRAMES) frame = _local[_size];
+        else {
+            frame = _more.back();
+            _more.pop_back();
+        }
+    }
+
+private:
+    CmpFrame              _local[CMP_LOCAL_FRAMES];
+    std::vector<CmpFrame> _more;
+    size_t                _size;
+};
+
+struct CmpContext {
+    size_t     count; // containers compared
+    CmpPairSet seen;
+    CmpStack   stack;
+
+    CmpContext () : count(0) {}
+};
+
+// true if pair of containers was met before. Below the depth threshold pairs are remembered only if both are referenced more
+// than once: otherwise they can't be met again, unless their parents can
+static inline bool _cmp_seen (CmpContext& ctx, size_t depth, SV* f, SV* s) {
+    if (depth < CMP_MEMO_DEPTH && (++ctx.count < CMP_MEMO_COUNT || SvREFCNT(f) == 1 || SvREFCNT(s) == 1)) return false;
+    return !ctx.seen.insert(f, s);
+}
+
+enum CmpResult { CMP_DIFF, CMP_EQUAL, CMP_NESTED };
+
+// compares scalars in place. For containers of the same type returns CMP_NESTED with <f> and <s> set to them (references
+// unrolled), their elements are compared by _cmp_walk
+static inline CmpResult _elem_cmp (SV*& f, SV*& s) {
+    if (f == s) return CMP_EQUAL;
 
     if (SvROK(f) | SvROK(s)) { /* unroll references */
         while (SvROK(f) & SvROK(s)) {
             SV* fval = SvRV(f);
             SV* sval = SvRV(s);
-            if (SvOBJECT(fval) ^ SvOBJECT(sval)) return false;
+            if (SvOBJECT(fval) ^ SvOBJECT(sval)) return CMP_DIFF;
             if (SvOBJECT(fval)) {
-                if (fval == sval) return true;
-                if (SvSTASH(fval) != SvSTASH(sval)) return false;
+                if (fval == sval) return CMP_EQUAL;
+                if (SvSTASH(fval) != SvSTASH(sval)) return CMP_DIFF;
                 if (HvAMAGIC(SvSTASH(fval))) { // class has operator overloadings
                     SV* const tmpsv = amagic_call(f, s, eq_amg, 0);
-                    if (tmpsv) return SvTRUE(tmpsv); // class has '==' operator overloading
+                    if (tmpsv) return SvTRUE(tmpsv) ? CMP_EQUAL : CMP_DIFF; // class has '==' operator overloading
                     // otherwise compare object's data structure as it wasn't blessed at all.
                 }
             }
             f = fval;
             s = sval;
         }
-        if (SvROK(f) | SvROK(s)) return false; /* asymmetric references */
-        if (f == s) return true;
+        if (SvROK(f) | SvROK(s)) return CMP_DIFF; /* asymmetric references */
+        if (f == s) return CMP_EQUAL;
     }
 
+    bool res;
     switch (SvTYPE(f)) {
         case SVt_IV:
         case SVt_NV:
@@ -35,72 +162,311 @@ static inline bool _elem_cmp (SV* f, SV* s) {
         case SVt_PVNV:
         case SVt_NULL:
         case SVt_PVMG:
-            if (SvOK(f) & SvOK(s)) { // both are not undefs
-                if (SvTYPE(s) > SVt_PVMG) return false; // wrong type
-                if (SvPOK(f) | SvPOK(s)) return strEQ(SvPV_nolen(f), SvPV_nolen(s)); // both strings
-                if (SvNOK(f) | SvNOK(s)) return SvNV(f) == SvNV(s); // natural values
-                return SvIVX(f) == SvIVX(s); // compare as integers
+            if (SvOK(f) && SvOK(s)) { // both are not undefs (flags may differ, so not bitwise)
+                if (SvTYPE(s) > SVt_PVMG) res = false; // wrong type
+                else if (SvPOK(f) | SvPOK(s)) res = strEQ(SvPV_nolen(f), SvPV_nolen(s)); // both strings
+                else if (SvNOK(f) | SvNOK(s)) res = SvNV(f) == SvNV(s); // natural values
+                else res = SvIVX(f) == SvIVX(s); // compare as integers
             }
-            return !(SvOK(f) | SvOK(s));
+            else res = !SvOK(f) && !SvOK(s);
+            break;
         case SVt_PVHV:
-            return SvTYPE(s) == SVt_PVHV && hv_compare((HV*)f, (HV*)s);
         case SVt_PVAV:
-            return SvTYPE(s) == SVt_PVAV && av_compare((AV*)f, (AV*)s);
+            return SvTYPE(s) == SvTYPE(f) ? CMP_NESTED : CMP_DIFF;
         case SVt_PVIO:
-            return SvTYPE(s) == SVt_PVIO && PerlIO_fileno(IoIFP(f)) == PerlIO_fileno(IoIFP(s));
+            res = SvTYPE(s) == SVt_PVIO && PerlIO_fileno(IoIFP(f)) == PerlIO_fileno(IoIFP(s));
+            break;
         case SVt_REGEXP:
-            return SvTYPE(s) == SVt_REGEXP && strEQ(SvPV_nolen(f), SvPV_nolen(s));
+            res = SvTYPE(s) == SVt_REGEXP && strEQ(SvPV_nolen(f), SvPV_nolen(s));
+            break;
         case SVt_PVCV:
         case SVt_PVGV:
-            return false; /* already checked by pointers equality */
+            res = false; /* already checked by pointers equality */
+            break;
         default:
-            return false;
+            res = false;
+    }
+    return res ? CMP_EQUAL : CMP_DIFF;
+}
+
+// sets up frame for containers of the same type, false if they differ in size
+static inline bool _cmp_enter (CmpFrame& frame, SV* f, SV* s) {
+    if (SvTYPE(f) == SVt_PVHV) {
+        if (HvUSEDKEYS((HV*)f) != HvUSEDKEYS((HV*)s)) return false;
+    }
+    else if (AvFILLp((AV*)f) != AvFILLp((AV*)s)) return false;
+    frame.f     = f;
+    frame.s     = s;
+    frame.i     = 0;
+    frame.entry = NULL;
+    return true;
+}
+
+// next pair of elements of frame's containers: 1 if there is one, 0 if containers are done, -1 if a key or an element is missing
+static inline int _cmp_next (CmpFrame& frame, SV*& f, SV*& s) {
+    if (SvTYPE(frame.f) == SVt_PVAV) {
+        AV* fav = (AV*)frame.f;
+        AV* sav = (AV*)frame.s;
+        if ((SSize_t)frame.i > AvFILLp(fav)) return 0;
+        if ((SSize_t)frame.i > AvFILLp(sav)) return -1; // shrunk by overloaded '=='
+        f = AvARRAY(fav)[frame.i];
+        s = AvARRAY(sav)[frame.i++];
+        return ((bool)f ^ (bool)s) ? -1 : 1; // one is null while another is not.
+    }
+    HV* hv = (HV*)frame.f;
+    HE* entry = frame.entry;
+    while (!entry) {
+        if (!HvARRAY(hv) || frame.i > HvMAX(hv)) return 0;
+        entry = HvARRAY(hv)[frame.i++];
+    }
+    frame.entry = HeNEXT(entry);
+    SV** sref = hv_fetchhek((HV*)frame.s, HeKEY_hek(entry), 0);
+    if (!sref) return -1;
+    f = HeVAL(entry);
+    s = *sref;
+    return 1;
+}
+
+// compares containers of the same type and, depth first, all nested ones
+static bool _cmp_walk (CmpContext& ctx, SV* f, SV* s) {
+    CmpStack& stack = ctx.stack;
+    CmpFrame  frame;
+    if (!_cmp_enter(frame, f, s)) return false;
+
+    while (true) {
+        switch (_cmp_next(frame, f, s)) {
+            case -1: return false;
+            case 0:
+                if (stack.empty()) return true;
+                stack.pop(frame);
+                continue;
+        }
+        CmpResult res = _elem_cmp(f, s);
+        if (res == CMP_DIFF) return false;
+        if (res == CMP_EQUAL || _cmp_seen(ctx, stack.size() + 1, f, s)) continue;
+        stack.push(frame);
+        if (!_cmp_enter(frame, f, s)) return false;
     }
 }
 
 bool sv_compare (SV* f, SV* s) {
     if ((bool)f ^ (bool)s) return false;
-    return _elem_cmp(f, s); // _elem_cmp cannot receive NULLs except for when both are NULLs
+    CmpResult res = _elem_cmp(f, s); // _elem_cmp cannot receive NULLs except for when both are NULLs
+    if (res != CMP_NESTED) return res == CMP_EQUAL;
+    CmpContext ctx;
+    return _cmp_walk(ctx, f, s);
 }
 
 bool hv_compare (HV* f, HV* s) {
     if (f == s) return true;
     if (!f || !s) return false;
-    if (HvUSEDKEYS(f) != HvUSEDKEYS(s)) return false;
-
-    HE** farr = HvARRAY(f);
-    if (!farr) return true; // both are empty
-    STRLEN fmax = HvMAX(f);
-    bool res = true;
-
-    for (STRLEN i = 0; res && i <= fmax; ++i) {
-        const HE* entry;
-        for (entry = farr[i]; res && entry; entry = HeNEXT(entry)) {
-            const HEK* hek = HeKEY_hek(entry);
-            SV** sref = hv_fetchhek(s, hek, 0);
-            if (!sref) return false;
-            res = _elem_cmp(HeVAL(entry), *sref);
-        }
-    }
-
-    return res;
+    CmpContext ctx;
+    return _cmp_walk(ctx, (SV*)f, (SV*)s);
 }
 
 bool av_compare (AV* f, AV* s) {
     if (f == s) return true;
     if (!f || !s) return true;
+    CmpContext ctx;
+    return _cmp_walk(ctx, (SV*)f, (SV*)s);
+}
+
+// Fingerprint is computed iteratively, like clone: a frame per container being hashed, so that C stack use doesn't depend on
+// data depth. A reference back to a container on the current path is hashed as its distance up the path, so equal cyclic
+// structures have equal fingerprints. Containers referenced more than once (refcnt > 1) have their hash memoized unless it
+// depends on the path (contains back references above the container), so that DAGs are hashed in linear time.
+struct FpFrame {
+    SV*      sv;     // AV or HV
+    uint64_t prefix; // hash of the reference chain leading to container
+    uint64_t acc;    // AV: running hash of elements, HV: sum of entry hashes, independent of order
+    uint64_t key;    // HV: hash of the key whose value is being hashed
+    size_t   i;      // AV: next index, HV: next bucket
+    HE*      entry;  // HV: next entry in current bucket
+    size_t   low;    // lowest depth of ancestor referenced from inside, FP_NONE if none
+};
+
+// path shorter than this is searched by scanning the stack, deeper containers are also kept in on_path map
+static const size_t FP_SCAN_DEPTH = 16;
+static const size_t FP_NONE       = (size_t)-1;
+
+struct FpContext {
+    std::vector<FpFrame>          stack;
+    panda::lib::ptr_map<size_t>   on_path; // container -> depth
+    panda::lib::ptr_map<uint64_t> memo;    // container -> hash without prefix
+};
+
+static const uint64_t FP_NULL  = 0x6e756c6c; // empty array slot
+static const uint64_t FP_UNDEF = 0x756e6466;
+static const uint64_t FP_REF   = 0x72656600;
+static const uint64_t FP_OBJ   = 0x6f626a00;
+static const uint64_t FP_BACK  = 0x6261636b;
+static const uint64_t FP_PTR   = 0x70747200;
+static const uint64_t FP_IO    = 0x696f0000;
+static const uint64_t FP_AV    = 0x61760000;
+static const uint64_t FP_HV    = 0x68760000;
+
+static inline uint64_t _fp_mix (uint64_t h, uint64_t v) { // order-dependent combination, murmur3 finalizer
+    h ^= v + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    return h ^ (h >> 33);
+}
+
+// Scalars are hashed by their string form, computed without stringifying SV itself (which would change how sv_compare
+// compares it). Numbers equal by sv_compare have equal string forms, except for big integers compared to floats.
+static inline uint64_t _fp_scalar (SV* sv) {
+    if (!SvOK(sv)) return FP_UNDEF;
+    if (SvPOKp(sv)) return panda::lib::string_hash(SvPVX_const(sv), SvCUR(sv));
+    char buf[128];
+    // private IV along with NV is a truncated fractional number (e.g. 1.5 used as array index): NV is formatted then
+    if (SvIOKp(sv) && (SvIOK(sv) || !SvNOKp(sv))) { // decimal digits, written from the end
+        bool neg = !SvIsUV(sv) && SvIVX(sv) < 0;
+        UV   val = neg ? -(UV)SvIVX(sv) : SvUVX(sv);
+        char* end = buf + sizeof(buf);
+        char* p   = end;
+        do *--p = '0' + val % 10; while (val /= 10);
+        if (neg) *--p = '-';
+        return panda::lib::string_hash(p, end - p);
+    }
+    if (SvNOKp(sv)) {
+        NV nv = SvNVX(sv);
+        if (nv == 0) nv = 0; // -0.0
+        Gconvert(nv, NV_DIG, 0, buf); // as perl stringifies numbers
+        return panda::lib::string_hash(buf, std::strlen(buf));
+    }
+    return FP_UNDEF;
+}
+
+static inline size_t _fp_on_path (FpContext& ctx, SV* sv) {
+    size_t depth = ctx.stack.size();
+    size_t scan  = depth < FP_SCAN_DEPTH ? depth : FP_SCAN_DEPTH;
+    for (size_t i = 0; i < scan; ++i) if (ctx.stack[i].sv == sv) return i;
+    if (depth > FP_SCAN_DEPTH) {
+        size_t* found = ctx.on_path.find(sv);
+        if (found) return *found;
+    }
+    return FP_NONE;
+}
+
+static inline void _fp_add (FpFrame& frame, uint64_t h) {
+    if (SvTYPE(frame.sv) == SVt_PVAV) frame.acc = _fp_mix(frame.acc, h);
+    else frame.acc += _fp_mix(frame.key, h);
+}
+
+// hashes scalars and references in place (returns true), for arrays and hashes pushes a frame (returns false)
+static inline bool _fp_item (FpContext& ctx, SV* sv, uint64_t& out) {
+    uint64_t prefix = 0;
+    while (SvROK(sv)) {
+        sv = SvRV(sv);
+        if (SvOBJECT(sv)) { // objects are fingerprinted by class and data, overloaded '==' is not taken into account
+            HV* stash = SvSTASH(sv);
+            prefix = _fp_mix(prefix ^ FP_OBJ, panda::lib::string_hash(HvNAME_get(stash), HvNAMELEN_get(stash)));
+        }
+        else prefix = _fp_mix(prefix, FP_REF);
+    }
+
+    switch (SvTYPE(sv)) {
+        case SVt_NULL:
+        case SVt_IV:
+        case SVt_NV:
+        case SVt_PV:
+        case SVt_PVIV:
+        case SVt_PVNV:
+        case SVt_PVMG:
+            out = _fp_mix(prefix, _fp_scalar(sv));
+            return true;
+        case SVt_REGEXP: {
+            STRLEN len;
+            const char* str = SvPV_const(sv, len);
+            out = _fp_mix(prefix, panda::lib::string_hash(str, len));
+            return true;
+        }
+        case SVt_PVIO:
+            out = _fp_mix(prefix ^ FP_IO, IoIFP(sv) ? PerlIO_fileno(IoIFP(sv)) : -1);
+            return true;
+        case SVt_PVAV:
+        case SVt_PVHV:
+            break;
+        default: // code, globs and others are equal only to themselves
+            out = _fp_mix(prefix ^ FP_PTR, PTR2UV(sv));
+            return true;
+    }
+
+    std::vector<FpFrame>& stack = ctx.stack;
+    size_t depth = stack.size();
+    if (depth) {
+        size_t ancestor = _fp_on_path(ctx, sv);
+        if (ancestor != FP_NONE) {
+            out = _fp_mix(prefix ^ FP_BACK, depth - ancestor);
+            if (ancestor < stack.back().low) stack.back().low = ancestor;
+            return true;
+        }
+    }
+    if (SvREFCNT(sv) > 1) {
+        uint64_t* memo = ctx.memo.find(sv);
+        if (memo) {
+            out = _fp_mix(prefix, *memo);
+            return true;
+        }
+    }
+
+    FpFrame frame = {sv, prefix, SvTYPE(sv) == SVt_PVAV ? FP_AV : 0, 0, 0, NULL, FP_NONE};
+    if (depth >= FP_SCAN_DEPTH) ctx.on_path.insert(sv, depth);
+    stack.push_back(frame);
+    return false;
+}
+
+uint64_t sv_fingerprint (SV* sv) {
+    if (!sv) return FP_NULL;
+    FpContext ctx;
+    std::vector<FpFrame>& stack = ctx.stack;
+    uint64_t h;
+    if (_fp_item(ctx, sv, h)) return h;
+
+    while (true) {
+        FpFrame& frame = stack.back();
+        SV* elem = NULL;
+        bool more;
+        if (SvTYPE(frame.sv) == SVt_PVAV) {
+            AV* av = (AV*)frame.sv;
+            more = (SSize_t)frame.i <= AvFILLp(av);
+            if (more && !(elem = AvARRAY(av)[frame.i++])) {
+                frame.acc = _fp_mix(frame.acc, FP_NULL);
+                continue;
+            }
+        }
+        else {
+            HV* hv = (HV*)frame.sv;
+            HE* entry = frame.entry;
+            while (!entry && HvARRAY(hv) && frame.i <= HvMAX(hv)) entry = HvARRAY(hv)[frame.i++];
+            if ((more = entry)) {
+                frame.entry = HeNEXT(entry);
+                frame.key   = panda::lib::string_hash(HeKEY(entry), HeKLEN(entry));
+                elem        = HeVAL(entry);
+            }
+        }
+
+        if (more) {
+            if (_fp_item(ctx, elem, h)) _fp_add(frame, h); // frame is not used if a new one was pushed
+            continue;
+        }
 
-    SSize_t lasti = AvFILLp(f);
-    if (lasti != AvFILLp(s)) return false;
-    SV** fl = AvARRAY(f);
-    SV** sl = AvARRAY(s);
+        size_t depth = stack.size() - 1;
+        if (SvTYPE(frame.sv) == SVt_PVAV) h = _fp_mix(frame.acc, AvFILLp((AV*)frame.sv) + 1);
+        else h = _fp_mix(FP_HV ^ frame.acc, HvUSEDKEYS((HV*)frame.sv));
+        if (frame.low >= depth && SvREFCNT(frame.sv) > 1) ctx.memo.insert(frame.sv, h);
+        if (depth >= FP_SCAN_DEPTH) ctx.on_path.erase(frame.sv);
+        h = _fp_mix(frame.prefix, h);
+        size_t low = frame.low;
+        stack.pop_back();
+        if (stack.empty()) return h;
 
-    bool res = true;
-    while (res && lasti-- >= 0) {
-        if ((bool)*fl ^ (bool)*sl) return false; // one is null while another is not.
-        res = _elem_cmp(*fl++, *sl++);
+        FpFrame& parent = stack.back();
+        if (low < parent.low) parent.low = low;
+        _fp_add(parent, h);
     }
-    return res;
 }
 
 }}
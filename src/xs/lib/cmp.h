@@ -1,4 +1,5 @@
 #pragma once
+#include <stdint.h>
 #include <xs/xs.h>
 
 namespace xs { namespace lib {
@@ -7,4 +8,8 @@ bool hv_compare (HV*, HV*);
 bool av_compare (AV*, AV*);
 bool sv_compare (SV*, SV*);
 
+// Deep 64-bit hash of data: values equal by sv_compare() have equal fingerprints, so storing a fingerprint is enough to find
+// out later whether data changed. Hashes are iterated independently of bucket order, cycles and shared data are supported.
+uint64_t sv_fingerprint (SV*);
+
 }}
@@ -0,0 +1,61 @@
+#include <xs/lib/lib.h>
+
+namespace xs { namespace lib {
+
+static inline SV* _sv_cow_copy (SV* sv) {
+    SV* ret = newSV(0);
+    sv_setsv_flags(ret, sv, SV_NOSTEAL | SV_COW_FLAGS);
+    return ret;
+}
+
+static void _sv_release (const char*, void* holder) {
+    dTHX;
+    SvREFCNT_dec((SV*)holder);
+}
+
+panda::string sv2string_shared (SV* svstr) {
+    STRLEN len;
+    const char* ptr = SvPV(svstr, len);
+    if (len <= panda::string::MAX_SSO_CHARS || !SvPOK(svstr) || SvROK(svstr) || SvGMAGICAL(svstr))
+        return panda::string(ptr, len, panda::string::COPY);
+
+    // private copy that is never modified - it shares the buffer with svstr when perl can COW it, so modifying svstr later
+    // makes perl detach svstr, not our copy
+    SV* holder = _sv_cow_copy(svstr);
+    try {
+        return panda::string(SvPVX_const(holder), SvCUR(holder), _sv_release, holder);
+    } catch (...) {
+        SvREFCNT_dec(holder);
+        throw;
+    }
+}
+
+SV* string2sv (panda::string& str) {
+    SV* ret;
+    if (void* holder = str.external_context(_sv_release)) {
+        if (str.data() == SvPVX_const((SV*)holder) && str.length() == SvCUR((SV*)holder)) { // whole perl string - COW it back
+            ret = _sv_cow_copy((SV*)holder);
+            str.clear();
+            return ret;
+        }
+    }
+#if !defined(MYMALLOC) && !defined(PERL_TRACK_MEMPOOL) && !defined(PERL_IMPLICIT_SYS)
+    // perl frees PV buffers with std::free, so malloc'ed block can be handed over as is. Data is moved to the beginning of block
+    // rather than using SvOOK offset, because perl can neither COW nor steal OOK strings and would copy it on first assignment.
+    size_t len = str.length(), offset, size;
+    if (void* block = str.release_buffer(offset, size)) {
+        std::memmove(block, (char*)block + offset, len + 1);
+        ret = newSV_type(SVt_PV);
+        SvPV_set(ret, (char*)block);
+        SvCUR_set(ret, len);
+        SvLEN_set(ret, size);
+        SvPOK_only(ret);
+        return ret;
+    }
+#endif
+    ret = newSVpvn(str.data(), str.length());
+    str.clear();
+    return ret;
+}
+
+}}
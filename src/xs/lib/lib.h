@@ -2,6 +2,12 @@
 #include <xs/xs.h>
 #include <panda/string.h>
 
+#ifdef SV_COW_OTHER_PVS
+#  define SV_COW_FLAGS (SV_COW_SHARED_HASH_KEYS | SV_COW_OTHER_PVS) // perl enables COW only for core by default
+#else
+#  define SV_COW_FLAGS 0
+#endif
+
 namespace xs { namespace lib {
 
 inline panda::string sv2string (SV* svstr, panda::string::ref_t ref = panda::string::COPY) {
@@ -10,4 +16,10 @@ inline panda::string sv2string (SV* svstr, panda::string::ref_t ref = panda::str
     return panda::string(ptr, len, ref);
 }
 
+// string sharing perl string's buffer without copying; keeps it alive and unchanged (via perl's COW) while referenced
+panda::string sv2string_shared (SV* svstr);
+
+// new SV with string's content; moves string buffer into SV without copying when possible. String is left empty.
+SV* string2sv (panda::string& str);
+
 }}
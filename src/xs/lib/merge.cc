@@ -1,3 +1,6 @@
+#include <cstring>
+#include <algorithm>
+#include <xs/lib/lib.h>
 #include <xs/lib/merge.h>
 #include <xs/lib/clone.h>
 
@@ -6,25 +9,27 @@
 
 namespace xs { namespace lib {
 
-static void _hash_merge (HV* dest, HV* source, IV flags);
-static void _array_merge (AV* dest, AV* source, IV flags);
+// with MERGE_COPY_SOURCE, referenced values are copied by one clone session per merge call: a substructure referenced several
+// times from sources is copied once and stays shared in result, cyclic sources are copied with their cycles
+static void _hash_merge (HV* dest, HV* source, IV flags, clone_session* session);
+static void _array_merge (AV* dest, AV* source, IV flags, clone_session* session);
 
-static inline void _elem_merge (SV* dest, SV* source, IV flags) {
+static inline void _elem_merge (SV* dest, SV* source, IV flags, clone_session* session) {
     if (SvROK(source)) {
         uint8_t type = SvTYPE(SvRV(source));
         if (type == SVt_PVHV && dest != NULL && SvROK(dest) && SvTYPE(SvRV(dest)) == type) {
-            _hash_merge((HV*) SvRV(dest), (HV*) SvRV(source), flags);
+            _hash_merge((HV*) SvRV(dest), (HV*) SvRV(source), flags, session);
             return;
         }
         else if (type == SVt_PVAV && (flags & MERGE_ARRAY_CM) && dest != NULL && SvROK(dest) && SvTYPE(SvRV(dest)) == type) {
-            _array_merge((AV*) SvRV(dest), (AV*) SvRV(source), flags);
+            _array_merge((AV*) SvRV(dest), (AV*) SvRV(source), flags, session);
             return;
         }
 
         if ((flags & MERGE_LAZY) && SvOK(dest)) return;
 
         if (flags & MERGE_COPY_SOURCE) { // deep copy reference value
-            SV* copy = newRV_noinc(clone(SvRV(source), false));
+            SV* copy = session->clone(source);
             SvSetSV_nosteal(dest, copy);
             SvREFCNT_dec(copy);
             return;
@@ -38,36 +43,36 @@ static inline void _elem_merge (SV* dest, SV* source, IV flags) {
     }
 }
 
-static void _hash_merge (HV* dest, HV* source, IV flags) {
+static inline void _hash_merge_entry (HV* dest, HEK* hek, SV* valueSV, IV flags, clone_session* session) {
+    if ((flags & MERGE_SKIP_UNDEF) && !SvOK(valueSV)) return; // skip undefs
+    if ((flags & MERGE_DELETE_UNDEF) && !SvOK(valueSV)) {
+        hv_deletehek(dest, hek, G_DISCARD);
+        return;
+    }
+    if (MERGE_CAN_LAZY(flags, valueSV)) {
+        SV** elemref = hv_fetchhek(dest, hek, 0);
+        if (elemref != NULL && SvOK(*elemref)) return;
+    }
+    if (MERGE_CAN_ALIAS(flags, valueSV)) { // make aliases for simple values
+        SvREFCNT_inc(valueSV);
+        hv_storehek(dest, hek, valueSV);
+        return;
+    }
+    SV* destSV  = *(hv_fetchhek(dest, hek, 1));
+    _elem_merge(destSV, valueSV, flags, session);
+}
+
+static void _hash_merge (HV* dest, HV* source, IV flags, clone_session* session) {
     STRLEN hvmax = HvMAX(source);
     HE** hvarr = HvARRAY(source);
     if (!hvarr) return;
     for (STRLEN i = 0; i <= hvmax; ++i) {
         const HE* entry;
-        for (entry = hvarr[i]; entry; entry = HeNEXT(entry)) {
-            HEK* hek = HeKEY_hek(entry);
-            SV* valueSV = HeVAL(entry);
-            if ((flags & MERGE_SKIP_UNDEF) && !SvOK(valueSV)) continue; // skip undefs
-            if ((flags & MERGE_DELETE_UNDEF) && !SvOK(valueSV)) {
-                hv_deletehek(dest, hek, G_DISCARD);
-                continue;
-            }
-            if (MERGE_CAN_LAZY(flags, valueSV)) {
-                SV** elemref = hv_fetchhek(dest, hek, 0);
-                if (elemref != NULL && SvOK(*elemref)) continue;
-            }
-            if (MERGE_CAN_ALIAS(flags, valueSV)) { // make aliases for simple values
-                SvREFCNT_inc(valueSV);
-                hv_storehek(dest, hek, valueSV);
-                continue;
-            }
-            SV* destSV  = *(hv_fetchhek(dest, hek, 1));
-            _elem_merge(destSV, valueSV, flags);
-        }
+        for (entry = hvarr[i]; entry; entry = HeNEXT(entry)) _hash_merge_entry(dest, HeKEY_hek(entry), HeVAL(entry), flags, session);
     }
 }
 
-static void _array_merge (AV* dest, AV* source, IV flags) {
+static void _array_merge (AV* dest, AV* source, IV flags, clone_session* session) {
     // we are using low-level code for AV for efficiency (it is 5-10x times faster)
     if (SvREADONLY(dest)) Perl_croak_no_modify();
     SV** srclist = AvARRAY(source);
@@ -80,7 +85,7 @@ static void _array_merge (AV* dest, AV* source, IV flags) {
         if (flags & MERGE_COPY_SOURCE) {
             while (srcfill-- >= 0) {
                 SV* elem = *srclist++;
-                dstlist[savei++] = elem == NULL ? newSV(0) : clone(elem, false);
+                dstlist[savei++] = elem == NULL ? newSV(0) : session->clone(elem);
             }
         } else {
             while (srcfill-- >= 0) {
@@ -109,24 +114,151 @@ static void _array_merge (AV* dest, AV* source, IV flags) {
                 continue;
             }
             if (!dstlist[i]) dstlist[i] = newSV(0);
-            _elem_merge(dstlist[i], elem, flags);
+            _elem_merge(dstlist[i], elem, flags, session);
         }
         if (AvFILLp(dest) < srcfill) AvFILLp(dest) = srcfill;
     } 
 }
 
 HV* hash_merge (HV* dest, HV* source, IV flags) {
+    return hash_merge(dest, &source, 1, flags);
+}
+
+HV* hash_merge (HV* dest, HV* const* sources, size_t cnt, IV flags) {
     if (!dest) dest = newHV();
-    else if (flags & MERGE_COPY_DEST) dest = (HV*)clone((SV*)dest, false);
-    if (source) _hash_merge(dest, source, flags);
+    else if (flags & MERGE_COPY_DEST) dest = (HV*)clone((SV*)dest);
+    if (cnt > 1) { // presize for combined key count, so that dest splits at most once
+        STRLEN keys = HvUSEDKEYS(dest);
+        for (size_t i = 0; i < cnt; ++i) if (sources[i]) keys += HvUSEDKEYS(sources[i]);
+        hv_ksplit(dest, keys);
+    }
+    clone_session session;
+    for (size_t i = 0; i < cnt; ++i) if (sources[i]) _hash_merge(dest, sources[i], flags, &session);
     return dest;
 }
 
 SV* merge (SV* dest, SV* source, IV flags) {
-    if ((flags & MERGE_COPY) && dest) dest = clone(dest, false);
-    if (!source) source = &PL_sv_undef;
-    _elem_merge(dest, source, flags);
+    return merge(dest, &source, 1, flags);
+}
+
+SV* merge (SV* dest, SV* const* sources, size_t cnt, IV flags) {
+    if ((flags & MERGE_COPY) && dest) dest = clone(dest);
+    clone_session session;
+    for (size_t i = 0; i < cnt; ++i) _elem_merge(dest, sources[i] ? sources[i] : &PL_sv_undef, flags, &session);
     return dest;
 }
 
+merge_plan::merge_plan (HV* tmpl, IV flags) : _hv(tmpl ? (HV*)clone((SV*)tmpl) : newHV()), _flags(flags), _owner(true), _wasutf8(false) {
+    _compile();
+}
+
+merge_plan::merge_plan (HV* hv, IV flags, bool owner) : _hv(hv), _flags(flags), _owner(owner), _wasutf8(false) {
+    _compile();
+}
+
+merge_plan::~merge_plan () {
+    for (size_t i = 0; i < _keys.size(); ++i) delete _keys[i].nested;
+    if (_owner) SvREFCNT_dec((SV*)_hv);
+}
+
+void merge_plan::_compile () {
+    _keys.reserve(HvUSEDKEYS(_hv));
+    _index.reserve(HvUSEDKEYS(_hv));
+    STRLEN hvmax = HvMAX(_hv);
+    HE** hvarr = HvARRAY(_hv);
+    if (!hvarr) return;
+    for (STRLEN i = 0; i <= hvmax; ++i) for (const HE* entry = hvarr[i]; entry; entry = HeNEXT(entry)) {
+        key_t key = {HeKEY_hek(entry), HeVAL(entry), NULL};
+        SV* val = key.value;
+        if (SvROK(val) && SvTYPE(SvRV(val)) == SVt_PVHV && !SvOBJECT(SvRV(val)) && !SvRMAGICAL(SvRV(val)))
+            key.nested = new merge_plan((HV*)SvRV(val), _flags, false);
+        if (HEK_WASUTF8(key.hek)) _wasutf8 = true;
+        _index.insert(key.hek, _keys.size());
+        _keys.push_back(key);
+    }
+}
+
+HV* merge_plan::merge (HV* source) const {
+    HV* dest = newHV();
+    clone_session session;
+    _apply(dest, source, &session);
+    return dest;
+}
+
+// same as hash_merge(dest, source, flags) where dest is a fresh copy of template
+void merge_plan::_apply (HV* dest, HV* source, clone_session* session) const {
+    size_t cnt = _keys.size();
+    if (cnt) hv_ksplit(dest, cnt);
+    if (!source || !HvUSEDKEYS(source) || !HvARRAY(source)) {
+        for (size_t i = 0; i < cnt; ++i) _apply_key(dest, _keys[i], NULL, session);
+        return;
+    }
+
+    SV* stack_vals[64]; // source values for template keys
+    std::vector<SV*> heap_vals;
+    SV** vals = stack_vals;
+    if (cnt > 64) {
+        heap_vals.resize(cnt);
+        vals = &heap_vals[0];
+    }
+    std::memset(vals, 0, std::min(cnt, size_t(64)) * sizeof(SV*));
+
+    STRLEN hvmax = HvMAX(source);
+    HE** hvarr = HvARRAY(source);
+    if (HvSHAREKEYS(source)) { // the same keys are the same shared HEKs in template and source
+        for (STRLEN i = 0; i <= hvmax; ++i) for (const HE* entry = hvarr[i]; entry; entry = HeNEXT(entry)) {
+            HEK* hek = HeKEY_hek(entry);
+            size_t* pos = _index.find(hek);
+            if (!pos && (HEK_WASUTF8(hek) || _wasutf8)) { // key downgraded from utf8 and the same latin-1 key are different HEKs
+                HE* tmpl_entry = (HE*)hv_common(_hv, NULL, HEK_KEY(hek), HEK_LEN(hek), HEK_UTF8(hek), 0, NULL, HEK_HASH(hek));
+                if (tmpl_entry) pos = _index.find(HeKEY_hek(tmpl_entry));
+            }
+            if (pos) vals[*pos] = HeVAL(entry);
+            else _hash_merge_entry(dest, hek, HeVAL(entry), _flags, session); // not in template - generic path
+        }
+    }
+    else {
+        STRLEN found = 0;
+        for (size_t i = 0; i < cnt; ++i) {
+            SV** valref = hv_fetchhek(source, _keys[i].hek, 0); // uses hash precomputed in template's HEK
+            if (valref) {
+                vals[i] = *valref;
+                ++found;
+            }
+        }
+        if (found < HvUSEDKEYS(source)) for (STRLEN i = 0; i <= hvmax; ++i) for (const HE* entry = hvarr[i]; entry; entry = HeNEXT(entry)) {
+            HEK* hek = HeKEY_hek(entry);
+            if (!hv_fetchhek(_hv, hek, 0)) _hash_merge_entry(dest, hek, HeVAL(entry), _flags, session);
+        }
+    }
+
+    for (size_t i = 0; i < cnt; ++i) _apply_key(dest, _keys[i], vals[i], session);
+}
+
+void merge_plan::_apply_key (HV* dest, const key_t& key, SV* val, clone_session* session) const {
+    if (key.nested && (!val || (SvROK(val) && SvTYPE(SvRV(val)) == SVt_PVHV))) { // hash merged into plain hash - nested plan
+        HV* nested = newHV();
+        hv_storehek(dest, key.hek, newRV_noinc((SV*)nested));
+        key.nested->_apply(nested, val ? (HV*)SvRV(val) : NULL, session);
+        return;
+    }
+
+    if (val && !(_flags & (MERGE_LAZY | MERGE_COPY_SOURCE)) && !SvROK(val) &&
+        (SvOK(val) || !(_flags & (MERGE_SKIP_UNDEF | MERGE_DELETE_UNDEF)))) // replaced by alias regardless of template value
+    {
+        SvREFCNT_inc_simple_void_NN(val);
+        hv_storehek(dest, key.hek, val);
+        return;
+    }
+
+    SV* copy;
+    if (SvROK(key.value)) copy = clone(key.value);
+    else {
+        copy = newSV(0);
+        sv_setsv_flags(copy, key.value, SV_GMAGIC | SV_NOSTEAL | SV_COW_FLAGS);
+    }
+    hv_storehek(dest, key.hek, copy);
+    if (val) _hash_merge_entry(dest, key.hek, val, _flags, session);
+}
+
 }}
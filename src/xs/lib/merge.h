@@ -1,5 +1,8 @@
 #pragma once
+#include <vector>
 #include <xs/xs.h>
+#include <panda/lib/ptr_map.h>
+#include <xs/lib/clone.h>
 
 namespace xs { namespace lib {
 
@@ -15,6 +18,45 @@ const int MERGE_COPY         = MERGE_COPY_DEST | MERGE_COPY_SOURCE;
 
 HV* hash_merge (HV* dest, HV* source, IV flags);
 
+// merges sources one after another, the same as consecutive hash_merge() calls, but dest is copied at most once
+HV* hash_merge (HV* dest, HV* const* sources, size_t cnt, IV flags);
+
 SV* merge (SV* dest, SV* source, IV flags);
 
+SV* merge (SV* dest, SV* const* sources, size_t cnt, IV flags);
+
+// Merge plan precompiled from a template hash: merge(source) returns the same result as hash_merge(tmpl, source, flags | MERGE_COPY_DEST),
+// without copying template values which are replaced by source. Source keys are matched to template keys by their shared HEKs
+// (or looked up by template keys with precomputed hashes), plain nested hashes have nested plans. Source keys which are not in
+// template go through generic merge. Template is copied when plan is created, changing it later doesn't affect the plan.
+class merge_plan {
+public:
+    merge_plan (HV* tmpl, IV flags = 0);
+    ~merge_plan ();
+
+    HV* merge (HV* source) const;
+
+private:
+    struct key_t {
+        HEK*        hek;
+        SV*         value;
+        merge_plan* nested;
+    };
+
+    HV*                         _hv;
+    IV                          _flags;
+    bool                        _owner;
+    bool                        _wasutf8; // template has keys downgraded from utf8
+    std::vector<key_t>          _keys;
+    panda::lib::ptr_map<size_t> _index; // HEK -> position in _keys
+
+    merge_plan (HV* hv, IV flags, bool owner);
+    merge_plan (const merge_plan&);
+    merge_plan& operator= (const merge_plan&);
+
+    void _compile   ();
+    void _apply     (HV* dest, HV* source, clone_session* session) const;
+    void _apply_key (HV* dest, const key_t& key, SV* val, clone_session* session) const;
+};
+
 }}
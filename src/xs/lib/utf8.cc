@@ -0,0 +1,71 @@
+#include <vector>
+#include <panda/lib/utf8.h>
+#include <panda/lib/ptr_map.h>
+#include <xs/lib/utf8.h>
+
+namespace xs { namespace lib {
+
+static inline void _encode (SV* sv) {
+    if (!SvPOK(sv) || !SvUTF8(sv)) return;
+    if (!SvREADONLY(sv) && panda::lib::is_ascii(SvPVX_const(sv), SvCUR(sv))) SvUTF8_off(sv); // the same bytes in both encodings
+    else sv_utf8_encode(sv);
+}
+
+static inline void _decode (SV* sv) {
+    if (!SvPOK(sv) || SvUTF8(sv) || panda::lib::is_ascii(SvPVX_const(sv), SvCUR(sv))) return;
+    sv_utf8_decode(sv); // leaves invalid UTF-8 as is
+}
+
+// Containers are processed from a worklist in any order: conversion of each value doesn't depend on others.
+// Referents are queued only once, which also breaks cycles.
+template <void (*convert)(SV*)>
+static void _walk (SV* data) {
+    if (!data || !SvROK(data)) return;
+    std::vector<SV*> todo;
+    panda::lib::ptr_map<bool> seen;
+    todo.push_back(SvRV(data));
+    seen.insert(todo.back(), true);
+
+    while (!todo.empty()) {
+        SV* container = todo.back();
+        todo.pop_back();
+        if (SvOBJECT(container)) continue;
+
+        SV** vals = NULL;
+        SSize_t cnt = 0;
+        HV* hv = NULL;
+        if (SvTYPE(container) == SVt_PVAV) {
+            vals = AvARRAY((AV*)container);
+            cnt  = AvFILLp((AV*)container) + 1;
+        }
+        else if (SvTYPE(container) == SVt_PVHV) hv = (HV*)container;
+        else continue;
+
+        HE* entry = NULL;
+        STRLEN bucket = 0;
+        while (true) {
+            SV* val;
+            if (!hv) {
+                if (!cnt--) break;
+                if (!(val = *vals++)) continue;
+            }
+            else {
+                while (!entry && HvARRAY(hv) && bucket <= HvMAX(hv)) entry = HvARRAY(hv)[bucket++];
+                if (!entry) break;
+                val   = HeVAL(entry);
+                entry = HeNEXT(entry);
+            }
+
+            if (!SvROK(val)) convert(val);
+            else {
+                SV* ref = SvRV(val);
+                if ((SvTYPE(ref) == SVt_PVAV || SvTYPE(ref) == SVt_PVHV) && !SvOBJECT(ref) && seen.insert(ref, true)) todo.push_back(ref);
+            }
+        }
+    }
+}
+
+void encode_utf8_struct (SV* data) { _walk<_encode>(data); }
+void decode_utf8_struct (SV* data) { _walk<_decode>(data); }
+
+}}
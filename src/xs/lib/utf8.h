@@ -0,0 +1,12 @@
+#pragma once
+#include <xs/xs.h>
+
+namespace xs { namespace lib {
+
+// In-place conversion of all string values in plain (unblessed) hashes and arrays reachable from data, like
+// Encode::encode_utf8/decode_utf8 applied to each of them. Hash keys, objects and references to scalars are left untouched.
+// Every container is processed once, so shared and cyclic data is fine; depth is not limited by C stack.
+void encode_utf8_struct (SV* data);
+void decode_utf8_struct (SV* data);
+
+}}
@@ -1,6 +1,6 @@
 use 5.012;
 use warnings;
-use Test::More tests => 3;
+use Test::More tests => 13;
 use Panda::Lib;
 
 my $data = "hello world";
@@ -18,6 +18,51 @@ my $large_data = $data x 10000;
 $ret = Panda::Lib::crypt_xor($large_data, $key);
 ok($ret eq check_xor($large_data, $key));
 
+# all key lengths around vector widths, unaligned lengths
+my $ok = 1;
+for my $klen (1..70) {
+    my $k = join '', map { chr(($_ * 37 + $klen) % 256) } 1..$klen;
+    for my $len (0, 1, 31, 32, 33, 100, 1000 + $klen) {
+        my $d = substr($large_data, $klen, $len);
+        $ok &&= Panda::Lib::crypt_xor($d, $k) eq check_xor($d, $k) or diag("klen=$klen, len=$len");
+    }
+}
+ok($ok, 'various key and data lengths');
+
+# streaming: chunks with key offset give the same result as the whole string
+my $whole = Panda::Lib::crypt_xor($large_data, $key);
+my ($stream, $pos) = ('', 0);
+for my $chunk_len (1, 7, 33, 100, 4096, 50000, 100000) {
+    last if $pos >= length $large_data;
+    my $chunk = substr($large_data, $pos, $chunk_len);
+    $stream .= Panda::Lib::crypt_xor($chunk, $key, $pos % length($key));
+    $pos += length $chunk;
+}
+is($pos, length $large_data);
+ok($stream eq $whole, 'streaming with key offset');
+
+# in-place
+my $buf = $large_data;
+my $copy = $buf; # shares buffer via COW
+is(Panda::Lib::crypt_xor_inplace($buf, $key), length($large_data) % length($key), 'returns next key offset');
+ok($buf eq $whole, 'in-place');
+ok($copy eq $large_data, 'COW copy is not changed');
+
+$buf = $large_data;
+my $koff = 0;
+$koff = Panda::Lib::crypt_xor_inplace(substr($buf, 0, 12345), $key, $koff);
+Panda::Lib::crypt_xor_inplace(substr($buf, 12345), $key, $koff);
+ok($buf eq $whole, 'in-place streaming via substr lvalues');
+
+$buf = 12345;
+Panda::Lib::crypt_xor_inplace($buf, "\x01");
+is($buf, "03254", 'in-place on number');
+
+eval { Panda::Lib::crypt_xor_inplace("readonly", $key) };
+ok($@, 'in-place on readonly croaks');
+
+is(Panda::Lib::crypt_xor("abc", ""), "abc", 'empty key');
+
 sub check_xor {
     my ($data, $key) = @_;
     my $ret = '';
@@ -1,12 +1,14 @@
 use 5.012;
 use warnings;
 use Test::More;
+use POSIX();
+use Time::HiRes qw/time sleep/;
 use Panda::Lib;
 
 my $i = 0;
 
 # there must be no timeout
-my $ok = Panda::Lib::timeout(sub { $i++ }, 1); 
+my $ok = Panda::Lib::timeout(sub { $i++ }, 1);
 ok($ok);
 ok($i == 1);
 
@@ -15,4 +17,91 @@ $ok = Panda::Lib::timeout(sub { $i++; select undef, undef, undef, 0.2; $i++ }, 0
 ok(!$ok);
 ok($i == 2);
 
+# busy perl code is interrupted too
+{
+    my $start = time;
+    ok(!Panda::Lib::timeout(sub { 1 while 1 }, 0.05), 'busy loop');
+    cmp_ok(time - $start, '<', 1);
+}
+
+# errors are rethrown
+ok(!eval { Panda::Lib::timeout(sub { die "my error\n" }, 1); 1 });
+is($@, "my error\n");
+ok(!eval { Panda::Lib::timeout(sub { die {code => 1} }, 1); 1 });
+is_deeply($@, {code => 1}, 'error object');
+
+# nested: inner deadline expires, outer goes on
+{
+    my @log;
+    $ok = Panda::Lib::timeout(sub {
+        push @log, Panda::Lib::timeout(sub { sleep 0.5; push @log, 'inner finished' }, 0.05) ? 'inner ok' : 'inner timeout';
+        push @log, 'outer finished';
+    }, 2);
+    ok($ok, 'nested: outer ok');
+    is_deeply(\@log, ['inner timeout', 'outer finished']);
+}
+
+# nested: outer deadline expires while inner runs, inner doesn't take it for its own
+{
+    my @log;
+    $ok = Panda::Lib::timeout(sub {
+        push @log, Panda::Lib::timeout(sub { sleep 0.5; push @log, 'inner finished' }, 2) ? 'inner ok' : 'inner timeout';
+        push @log, 'outer finished';
+    }, 0.05);
+    ok(!$ok, 'nested: outer timeout');
+    is_deeply(\@log, []);
+}
+
+# deep nesting, each level with its own deadline
+{
+    my $depth = 0;
+    my $nest;
+    $nest = sub {
+        my $level = shift;
+        return sleep 0.5 if $level == 10;
+        $depth = $level;
+        return Panda::Lib::timeout(sub { $nest->($level + 1) }, $level == 5 ? 0.05 : 5);
+    };
+    is($nest->(0), 1, 'deep nesting');
+    is($depth, 9);
+    undef $nest;
+}
+
+# perl alarm keeps working inside and around timeout
+SKIP: {
+    skip 'no realtime signals, ALRM is used', 4 if Panda::Lib::_deadline_signal() eq 'ALRM';
+    ok(!defined $SIG{ALRM}, 'ALRM handler is not installed');
+    my $alarm = 0;
+    local $SIG{ALRM} = sub { $alarm++ };
+    alarm 1;
+    $ok = Panda::Lib::timeout(sub {
+        Panda::Lib::timeout(sub { 1 }, 0.01) for 1..100;
+        sleep 0.05;
+    }, 0.2);
+    ok($ok, 'alarm not clobbered');
+    is($alarm, 0);
+    sleep 0.1 while !$alarm && time - $^T < 30;
+    is($alarm, 1, 'outer alarm fired');
+}
+
+# many short guarded calls don't leave pending timers behind
+{
+    Panda::Lib::timeout(sub { $i++ }, 0.05) for 1..10000;
+    my $start = time;
+    select undef, undef, undef, 0.2;
+    cmp_ok(time - $start, '>=', 0.19, 'no late signals');
+}
+
+# child process gets its own watchdog
+{
+    my $pid = fork() // die "fork: $!";
+    if (!$pid) {
+        my $res = Panda::Lib::timeout(sub { sleep 2 }, 0.05);
+        POSIX::_exit($res ? 1 : 0);
+    }
+    waitpid($pid, 0);
+    is($?, 0, 'fork');
+    ok(!Panda::Lib::timeout(sub { sleep 2 }, 0.05), 'parent after fork');
+}
+
 done_testing();
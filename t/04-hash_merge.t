@@ -1,6 +1,6 @@
 use 5.012;
 use warnings;
-use Panda::Lib qw/hash_merge :const/;
+use Panda::Lib qw/hash_merge hash_merge_many :const/;
 use Test::More;
 use Test::Deep;
 
@@ -136,4 +136,86 @@ cmp_deeply($ret, $bb);
 $ret = hash_merge(undef, undef);
 cmp_deeply($ret, {});
 
+# many sources - same as consecutive merges
+{
+    use Storable qw/dclone/;
+    my $layers = [
+        {a => 1, b => {x => 1, y => [1, 2]}, c => [1], u => 1},
+        {b => {y => [3], z => 1}, c => [2, 3], d => undef},
+        undef,
+        {a => undef, b => {x => {deep => 1}}, e => 'e', u => undef},
+        {b => {x => {deeper => 2}}, c => 'scalar', f => [{g => 1}]},
+    ];
+    my $base = {a => 0, b => {w => 0}, u => 'keep'};
+    for my $flags (0, MERGE_ARRAY_CONCAT, MERGE_ARRAY_MERGE, MERGE_LAZY, MERGE_SKIP_UNDEF, MERGE_DELETE_UNDEF, MERGE_COPY,
+                   MERGE_COPY_DEST | MERGE_ARRAY_CONCAT | MERGE_SKIP_UNDEF, MERGE_COPY_SOURCE | MERGE_ARRAY_MERGE | MERGE_LAZY)
+    {
+        my ($dest1, $layers1) = @{dclone([$base, $layers])};
+        my ($dest2, $layers2) = @{dclone([$base, $layers])};
+        my $ret1 = $dest1;
+        $ret1 = hash_merge($ret1, $_, $flags) for @$layers1;
+        my $ret2 = hash_merge_many($dest2, $layers2, $flags);
+        cmp_deeply($ret2, $ret1, "hash_merge_many flags=$flags");
+        cmp_deeply($dest2, $dest1);
+        # consecutive MERGE_COPY_DEST merges copy values aliased from previous sources, hash_merge_many copies dest only once
+        cmp_deeply($layers2, $layers1) unless ($flags & MERGE_COPY) == MERGE_COPY_DEST;
+        if ($flags & MERGE_COPY_DEST) { isnt($ret2, $dest2) } else { is($ret2, $dest2) }
+    }
+
+    cmp_deeply(hash_merge_many(undef, [{a => 1}, {b => 2}]), {a => 1, b => 2});
+    cmp_deeply(hash_merge_many(undef, []), {});
+    $aa = {x => 1};
+    is(hash_merge_many($aa, []), $aa);
+    ok(!eval { hash_merge_many({}, [{}, [1]]); 1 });
+}
+
+# MERGE_COPY_SOURCE copies each referent once per merge: shared data stays shared, cycles are kept
+{
+    my $shared = {v => [1, 2]};
+    my $src = {a => $shared, b => $shared, l => [$shared, $shared->{v}]};
+    for my $flags (MERGE_COPY_SOURCE, MERGE_COPY, MERGE_COPY_SOURCE | MERGE_ARRAY_CONCAT) {
+        my $ret = hash_merge({l => [0]}, $src, $flags);
+        my $l = $ret->{l};
+        $l = [@$l[1, 2]] if $flags & MERGE_ARRAY_CONCAT;
+        cmp_deeply([@$ret{qw/a b/}, @$l], [$shared, $shared, $shared, $shared->{v}], "shared flags=$flags");
+        isnt($ret->{a}, $shared);
+        is($ret->{b}, $ret->{a});
+        is($l->[0], $ret->{a});
+        is($l->[1], $ret->{a}{v});
+    }
+
+    my $ret = hash_merge_many({}, [{a => $shared}, {b => $shared}, {a => 1}, {c => $shared}], MERGE_COPY_SOURCE);
+    is($ret->{a}, 1);
+    is($ret->{c}, $ret->{b}, 'shared between sources');
+    isnt($ret->{b}, $shared);
+
+    # the only owner of a copy is overwritten by a later source, the copy must not be reused after it's freed
+    $ret = hash_merge_many({}, [{a => $shared}, {a => 1}, {b => $shared}], MERGE_COPY_SOURCE);
+    is($ret->{a}, 1);
+    cmp_deeply($ret->{b}, $shared, 'copy whose owner was overwritten');
+    isnt($ret->{b}, $shared);
+
+    my $cyclic = {name => 'root'};
+    $cyclic->{self} = $cyclic;
+    $cyclic->{child} = {parent => $cyclic};
+    $ret = hash_merge({}, {c => $cyclic}, MERGE_COPY_SOURCE);
+    isnt($ret->{c}, $cyclic, 'cyclic source');
+    is($ret->{c}{self}, $ret->{c});
+    is($ret->{c}{child}{parent}, $ret->{c});
+    $ret->{c}{name} = 'copy';
+    is($cyclic->{name}, 'root');
+    %$_ = () for $ret->{c}{child}, $ret->{c}, $cyclic->{child}, $cyclic;
+
+    my $obj = bless {x => 1}, 'MyObj';
+    $ret = hash_merge({}, {o => $obj, p => $obj}, MERGE_COPY_SOURCE);
+    isa_ok($ret->{o}, 'MyObj');
+    is($ret->{p}, $ret->{o});
+
+    { package MyDying; sub CLONE { die "clone failed\n" } }
+    ok(!eval { hash_merge({}, {a => [1], o => bless({}, 'MyDying')}, MERGE_COPY_SOURCE); 1 }, 'dying CLONE');
+    is($@, "clone failed\n");
+    $ret = hash_merge({}, {a => $shared, b => $shared}, MERGE_COPY_SOURCE);
+    is($ret->{a}, $ret->{b}, 'merge after dying CLONE');
+}
+
 done_testing();
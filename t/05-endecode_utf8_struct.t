@@ -22,4 +22,74 @@ my $test2 = dclone($dec_struct);
 Panda::Lib::encode_utf8_struct($test2);
 cmp_deeply($test2, $enc_struct);
 
+# same as former pure-perl version
+sub perl_encode {
+    my $data = shift;
+    for my $v (ref($data) eq 'HASH' ? values %$data : ref($data) eq 'ARRAY' ? @$data : ()) {
+        if (ref $v) { perl_encode($v) }
+        elsif (utf8::is_utf8($v)) { $v = encode_utf8($v) }
+    }
+}
+sub perl_decode {
+    my $data = shift;
+    for my $v (ref($data) eq 'HASH' ? values %$data : ref($data) eq 'ARRAY' ? @$data : ()) {
+        if (ref $v) { perl_decode($v) }
+        elsif (defined $v and !utf8::is_utf8($v)) { $v = decode_utf8($v) }
+    }
+}
+
+my $ascii_dec = decode_utf8('ascii');
+ok(utf8::is_utf8($ascii_dec));
+my $mixed = {
+    words  => [$word_enc, $word_dec, 'ascii', $ascii_dec, '', undef, "\xd0", "x$word_enc"],
+    nested => {a => {b => [[$word_enc], {c => $word_dec}]}, $word_dec => $word_enc},
+    obj    => bless({a => $word_enc}, 'MyObj'),
+    sref   => \$word_enc,
+    rref   => \[$word_enc],
+};
+for my $row ([encode => \&Panda::Lib::encode_utf8_struct, \&perl_encode], [decode => \&Panda::Lib::decode_utf8_struct, \&perl_decode]) {
+    my ($name, $xs, $perl) = @$row;
+    my $got = dclone($mixed);
+    my $expected = dclone($mixed);
+    $xs->($got);
+    $perl->($expected);
+    $expected->{words}[6] = "\xd0" if $name eq 'decode'; # invalid UTF-8 is left as is instead of replacement characters
+    cmp_deeply($got, $expected, $name);
+    is(join(',', map { utf8::is_utf8($_) ? 1 : 0 } @{$got->{words}}[0..4]), $name eq 'encode' ? '0,0,0,0,0' : '1,1,0,1,0', "$name flags");
+    is(${$got->{sref}}, $word_enc, "$name: scalar refs untouched");
+    is($got->{obj}{a}, $word_enc, "$name: objects untouched");
+    ok(exists $got->{nested}{$word_dec}, "$name: keys untouched");
+}
+
+# numbers and undefs stay as they are
+{
+    my $data = [1, 1.5, undef];
+    Panda::Lib::decode_utf8_struct($data);
+    ok(!utf8::is_utf8($data->[0]) && !defined $data->[2]);
+    use B;
+    ok(!(B::svref_2object(\$data->[0])->FLAGS & B::SVf_POK), 'numbers are not stringified');
+}
+
+# shared and cyclic data, deep data
+{
+    my $shared = [$word_enc];
+    my $data = {a => $shared, b => $shared, c => [$shared]};
+    $data->{self} = $data;
+    Panda::Lib::decode_utf8_struct($data);
+    is($shared->[0], $word_dec, 'shared');
+    Panda::Lib::encode_utf8_struct($data);
+    is($shared->[0], $word_enc);
+    delete $data->{self};
+
+    my $deep = [$word_enc];
+    my $inner = $deep;
+    $deep = {a => [$deep]} for 1..100000;
+    Panda::Lib::decode_utf8_struct($deep);
+    is($inner->[0], $word_dec, 'deep');
+}
+
+# not a structure
+Panda::Lib::decode_utf8_struct($_) for undef, 1, $word_enc, \1;
+pass('not a structure');
+
 done_testing();
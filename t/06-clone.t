@@ -1,7 +1,7 @@
 use 5.012;
 use warnings;
 use Test::More;
-use Panda::Lib qw/clone fclone/;
+use Panda::Lib qw/clone fclone clone_many fclone_many clone_times fclone_times CLONE_SHARED/;
 use Test::Deep;
 use Storable qw/dclone/;
 
@@ -138,6 +138,93 @@ $copy = fclone($val);
 shift @{$val->[0]{b}};
 cmp_deeply($copy->[0]{c}{c}{c}{c}{c}{c}{c}{c}{b}, [1,2,3]);
 
+# deep structures are not limited by depth
+{
+    my $list;
+    $list = {next => $list, val => $_} for 1..100000;
+    for my $copy (clone($list), fclone($list)) {
+        my ($cnt, $ok) = (0, 1);
+        for (my $node = $copy; $node; $node = $node->{next}) { $ok = 0 if $node->{val} != 100000 - $cnt++ }
+        is($cnt, 100000);
+        ok($ok);
+    }
+    $val = [1];
+    $val = [$val] for 1..100000;
+    $copy = clone($val);
+    $copy = $copy->[0] for 1..100000;
+    cmp_deeply($copy, [1]);
+}
+
+# long cycle
+{
+    my $root = {};
+    my $node = $root;
+    $node = $node->{next} = {} for 1..5000;
+    $node->{next} = $root;
+    ok(!eval { clone($root); 1 });
+    like($@, qr/cycle/);
+    $copy = fclone($root);
+    $node = $copy;
+    $node = $node->{next} for 1..5001;
+    is($node, $copy);
+}
+
+# dying CLONE callback doesn't break subsequent clones
+{
+    package MyDier;
+    sub CLONE { die "clone failed\n" }
+}
+ok(!eval { fclone([1, bless {}, 'MyDier']); 1 });
+is($@, "clone failed\n");
+$tmp = [1];
+$copy = fclone([$tmp, $tmp]);
+is($copy->[0], $copy->[1]);
+
+# batch clone
+{
+    my $shared = [1, 2];
+    my $list = [{a => $shared, b => $shared}, {c => $shared}, 10, undef, "str"];
+    my @copies = clone_many($list);
+    is(scalar @copies, 5);
+    cmp_deeply(\@copies, $list);
+    isnt($copies[0]{a}, $copies[0]{b});
+    isnt($copies[0]{a}, $list->[0]{a});
+
+    @copies = fclone_many($list);
+    cmp_deeply(\@copies, $list);
+    is($copies[0]{a}, $copies[0]{b});
+    isnt($copies[0]{a}, $copies[1]{c}); # items are independent by default
+    isnt($copies[0]{a}, $shared);
+
+    @copies = clone_many($list, CLONE_SHARED);
+    is($copies[0]{a}, $copies[1]{c});
+    is($copies[0]{a}, $copies[0]{b});
+    push @$shared, 3;
+    cmp_deeply($copies[1]{c}, [1, 2]);
+
+    is(scalar(() = clone_many([])), 0);
+
+    my $cycled = {};
+    $cycled->{self} = $cycled;
+    ok(!eval { clone_many([1, $cycled]); 1 });
+    @copies = fclone_many([$cycled, $cycled]);
+    is($copies[0]{self}, $copies[0]);
+    isnt($copies[0], $copies[1]);
+    $_->{self} = undef for @copies, $cycled;
+
+    my $template = {a => [1], b => {c => 2}};
+    @copies = clone_times($template, 3);
+    is(scalar @copies, 3);
+    cmp_deeply($_, $template) for @copies;
+    isnt($copies[0]{a}, $copies[1]{a});
+    $copies[0]{a}[0] = 10;
+    is($copies[1]{a}[0], 1);
+    @copies = fclone_times({x => $shared, y => $shared}, 2);
+    is($copies[0]{x}, $copies[0]{y});
+    isnt($copies[0]{x}, $copies[1]{x});
+    is(scalar(() = clone_times($template, 0)), 0);
+}
+
 # code reference
 $val = sub { return 25 };
 $copy = clone($val);
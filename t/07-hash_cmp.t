@@ -2,6 +2,7 @@ use 5.012;
 use warnings;
 use blib;
 use Panda::Lib 'compare';
+use Scalar::Util();
 use Test::More;
 use Test::Deep;
 
@@ -141,4 +142,72 @@ is compare($oo1, $oo4), "";
 is compare($oo1, $oo5), "";
 is compare($oo1, $noo), "";
 
+# cycles
+{
+    my ($c1, $c2, $c3) = map { {name => 'node'} } 1..3;
+    $c1->{self} = $c1;
+    $c2->{self} = $c2;
+    is compare($c1, $c2), 1, 'cycle';
+    $c3->{self} = $c3;
+    $c3->{name} = 'other';
+    is compare($c1, $c3), "";
+
+    # the same infinite data, cycles of different length
+    my @ring = map { {name => 'node'} } 1..2;
+    $ring[0]{self} = $ring[1];
+    $ring[1]{self} = $ring[0];
+    is compare($c1, $ring[0]), 1, 'cycles of different length';
+
+    my @long1 = map { {id => $_ % 7, list => [$_ % 3]} } 1..5000;
+    my @long2 = map { {id => $_ % 7, list => [$_ % 3]} } 1..5000;
+    $long1[$_]{next} = $long1[($_ + 1) % @long1] for 0..$#long1;
+    $long2[$_]{next} = $long2[($_ + 1) % @long2] for 0..$#long2;
+    is compare($long1[0], $long2[0]), 1, 'long cycle';
+    $long2[4000]{list}[0] = 10;
+    is compare($long1[0], $long2[0]), "";
+
+    # compare is not recursive: rings and chains of any length don't overflow C stack
+    my @huge1 = map { {id => $_ % 7} } 1..300000;
+    my @huge2 = map { {id => $_ % 7} } 1..300000;
+    $huge1[$_]{next} = $huge1[($_ + 1) % @huge1] for 0..$#huge1;
+    $huge2[$_]{next} = $huge2[($_ + 1) % @huge2] for 0..$#huge2;
+    is compare($huge1[0], $huge2[0]), 1, 'huge ring';
+    $huge2[-1]{id} = 10;
+    is compare($huge1[0], $huge2[0]), "", 'huge ring: difference at the end';
+    %$_ = () for @huge1, @huge2;
+
+    my $weak1 = {name => 'parent'};
+    my $weak2 = {name => 'parent'};
+    $_->{child} = {parent => $_} for $weak1, $weak2;
+    Scalar::Util::weaken($_->{child}{parent}) for $weak1, $weak2;
+    is compare($weak1, $weak2), 1, 'weak cycle';
+
+    %$_ = () for $c1, $c2, $c3, @ring, @long1, @long2;
+}
+
+# deep acyclic chains
+{
+    my ($l1, $l2) = ({end => 1}, {end => 1});
+    ($l1, $l2) = ({next => $l1, list => [1]}, {next => $l2, list => [1]}) for 1..200000;
+    is compare($l1, $l2), 1, 'deep chain';
+    my ($a1, $a2) = ([1], [1]);
+    ($a1, $a2) = ([$a1], [$a2]) for 1..200000;
+    is compare($a1, $a2), 1, 'deep array chain';
+    my ($l3, $a3) = ({end => 2}, [2]);
+    ($l3, $a3) = ({next => $l3, list => [1]}, [$a3]) for 1..200000;
+    is compare($l1, $l3), "", 'deep chain: difference at the bottom';
+    is compare($a1, $a3), "", 'deep array chain: difference at the bottom';
+}
+
+# DAG: exponential number of paths, shared parts are compared once
+{
+    my ($d1, $d2) = ({leaf => [1]}, {leaf => [1]});
+    $d1 = {left => $d1, right => $d1, list => [$d1]} for 1..50;
+    $d2 = {left => $d2, right => $d2, list => [$d2]} for 1..50;
+    is compare($d1, $d2), 1, 'dag';
+    my $d3 = {leaf => [2]};
+    $d3 = {left => $d3, right => $d3, list => [$d3]} for 1..50;
+    is compare($d1, $d3), "";
+}
+
 done_testing;
@@ -1,6 +1,6 @@
 use 5.012;
 use warnings;
-use Panda::Lib qw/merge :const/;
+use Panda::Lib qw/merge merge_many :const/;
 use Test::More;
 use Test::Deep;
 
@@ -63,4 +63,33 @@ $aa = 20;
 $ret = merge($aa, 30, MERGE_LAZY);
 is($aa, 20);
 
+# many sources
+$aa = {a => 1, b => [1]};
+$ret = merge_many($aa, [{b => [2]}, {c => 3}, {a => {x => 1}}], MERGE_ARRAY_CONCAT);
+is($ret, $aa);
+cmp_deeply($aa, {a => {x => 1}, b => [1, 2], c => 3});
+
+$aa = [1, 2];
+$ret = merge_many($aa, [[3], [4, 5]], MERGE_ARRAY_CONCAT | MERGE_COPY_DEST);
+cmp_deeply($ret, [1, 2, 3, 4, 5]);
+cmp_deeply($aa, [1, 2]);
+
+# copy of a referent shared between sources, whose first owner is overwritten
+{
+    my $x = {v => [1, 2]};
+    $ret = merge_many({}, [{a => $x}, {a => 1}, {b => $x}], MERGE_COPY_SOURCE);
+    cmp_deeply($ret, {a => 1, b => $x});
+    isnt($ret->{b}, $x);
+}
+
+$aa = 10;
+merge_many($aa, [20, undef, 30]);
+is($aa, 30);
+$aa = undef;
+merge_many($aa, [undef, 30, 40], MERGE_LAZY);
+is($aa, 30);
+$aa = 10;
+merge_many($aa, []);
+is($aa, 10);
+
 done_testing();
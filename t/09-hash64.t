@@ -0,0 +1,33 @@
+use 5.012;
+use warnings;
+use Panda::Lib;
+use Test::More;
+
+# wyhash final version 4 test vectors
+my @vectors = (
+    ['',                                                                                 "93228a4de0eec5a2"],
+    ['a',                                                                                "c5bac3db178713c4"],
+    ['abc',                                                                              "a97f2f7b1d9b3314"],
+    ['message digest',                                                                   "786d1f1df3801df4"],
+    ['abcdefghijklmnopqrstuvwxyz',                                                       "dca5a8138ad37c87"],
+    ['ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789',                   "b9e734f117cfaf70"],
+    ['12345678901234567890123456789012345678901234567890123456789012345678901234567890', "6cc5eab49a92d617"],
+);
+
+my $seed = 0;
+is(sprintf("%016x", Panda::Lib::hash64($_->[0], $seed++)), $_->[1], "hash64 '$_->[0]'") for @vectors;
+
+is(Panda::Lib::hash64("hello world"), Panda::Lib::hash64("hello world", 0), 'default seed is 0');
+isnt(Panda::Lib::hash64("hello world", 1), Panda::Lib::hash64("hello world", 2), 'seed changes result');
+
+my @keys = map { "key$_" x ($_ % 7 + 1) } 1..200;
+push @keys, '', 12345;
+my $packed = Panda::Lib::hash64_batch(\@keys, 10);
+is(length($packed), 8 * @keys, 'batch result length');
+is_deeply([unpack 'Q*', $packed], [map { Panda::Lib::hash64($_, 10) } @keys], 'batch equals single calls');
+is(Panda::Lib::hash64_batch([]), '', 'empty batch');
+
+is(Panda::Lib::string_hash("hello world"), 4305416711574135400, 'string_hash is not changed');
+is(Panda::Lib::string_hash("hello world, unaligned"), Panda::Lib::string_hash(substr("xhello world, unaligned", 1)), 'string_hash unaligned');
+
+done_testing();
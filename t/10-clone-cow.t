@@ -0,0 +1,108 @@
+use 5.012;
+use warnings;
+use Test::More;
+use Panda::Lib qw/clone fclone crypt_xor_inplace CLONE_NO_COW/;
+
+# address of string buffer
+sub pvx { unpack 'J', pack 'p', $_[0] }
+
+my $big = join '', map { chr(ord('a') + $_ % 26) } 1..100000;
+
+# buffers are shared (if perl can COW) or copied (CLONE_NO_COW), never modified through the other side
+my $copy = clone({blob => $big});
+SKIP: {
+    skip "perl has no copy-on-write", 1 if $] < 5.020;
+    is(pvx($copy->{blob}), pvx($big), 'buffer is shared');
+}
+$copy = clone({blob => $big}, CLONE_NO_COW);
+isnt(pvx($copy->{blob}), pvx($big), 'CLONE_NO_COW copies buffer');
+is($copy->{blob}, $big);
+
+my @mutators = (
+    [assign  => sub { $_[0] = 'new' }],
+    [append  => sub { $_[0] .= 'tail' }],
+    [substr4 => sub { substr($_[0], 0, 3, 'XYZ') }],
+    [lvalue  => sub { substr($_[0], 10, 1) = '!' }],
+    [subst   => sub { $_[0] =~ s/a/_/g }],
+    [tr      => sub { $_[0] =~ tr/b/B/ }],
+    [chop    => sub { chop $_[0] }],
+    [vec     => sub { vec($_[0], 0, 8) = 65 }],
+    [read    => sub { open my $fh, '<', \"input"; read($fh, $_[0], 5, 2) }],
+    [xor     => sub { crypt_xor_inplace($_[0], "key") }],
+    [undef   => sub { undef $_[0] }],
+);
+
+for my $row (@mutators) {
+    my ($name, $mutate) = @$row;
+    for my $flags (0, CLONE_NO_COW) {
+        my $mode = $flags ? 'nocow' : 'cow';
+        my $expected = $big;
+        $mutate->($expected);
+
+        my $src = {blob => $big, list => [$big]};
+        my $cloned = clone($src, $flags);
+        $mutate->($src->{blob});
+        $mutate->($src->{list}[0]);
+        is($src->{blob}, $expected, "$name $mode: source modified");
+        ok($cloned->{blob} eq $big && $cloned->{list}[0] eq $big, "$name $mode: clone intact after modifying source");
+
+        $src = {blob => $big, list => [$big]};
+        $cloned = clone($src, $flags);
+        $mutate->($cloned->{blob});
+        $mutate->($cloned->{list}[0]);
+        is($cloned->{blob}, $expected, "$name $mode: clone modified");
+        ok($src->{blob} eq $big && $src->{list}[0] eq $big, "$name $mode: source intact after modifying clone");
+    }
+}
+
+# buffer shared by many clones and clones of clones
+{
+    my $src = "$big";
+    my @clones = map { clone([$src]) } 1..300;
+    push @clones, clone($clones[-1]) for 1..10;
+    $_->[0] .= '!' for @clones[0, 150, 305];
+    substr($src, 0, 1, '#');
+    is(scalar(grep { $_->[0] eq $big } @clones), 307, 'many clones');
+    is(scalar(grep { $_->[0] eq "$big!" } @clones), 3);
+    undef $src;
+    @clones = ();
+}
+
+# source freed before clone
+{
+    my $src = ["$big"];
+    my $cloned = clone($src);
+    undef $src;
+    is($cloned->[0], $big, 'source freed');
+    $cloned->[0] .= 'x';
+    is(length $cloned->[0], length($big) + 1);
+}
+
+# utf8 and numeric strings, hash keys
+{
+    my $str = "\x{442}\x{435}\x{441}\x{442}" x 1000;
+    my $num = 42;
+    my $numstr = "$num";
+    my $src = {utf8 => $str, num => $num, $big => 1};
+    my $cloned = fclone($src);
+    ok(utf8::is_utf8($cloned->{utf8}), 'utf8 flag kept');
+    is($cloned->{utf8}, $str);
+    $src->{utf8} =~ s/\x{442}/t/g;
+    is($cloned->{utf8}, $str);
+    $cloned->{num}++;
+    is($src->{num}, 42);
+    is($cloned->{num}, 43);
+    ok(exists $cloned->{$big}, 'long hash key');
+}
+
+# cross mode shares buffers too, references stay shared
+{
+    my $inner = [$big];
+    my $cloned = fclone({a => $inner, b => $inner});
+    is($cloned->{a}, $cloned->{b});
+    $cloned->{a}[0] .= '!';
+    is($cloned->{b}[0], "$big!");
+    is($inner->[0], $big);
+}
+
+done_testing();
@@ -0,0 +1,106 @@
+use 5.012;
+use warnings;
+use Test::More;
+use Test::Deep;
+use Storable qw/dclone/;
+use Encode ();
+use Panda::Lib qw/hash_merge :const/;
+
+my $tmpl = {
+    a      => 1,
+    b      => 'str',
+    u      => undef,
+    list   => [1, 2],
+    nested => {x => 1, y => {deep => 1}, z => [1]},
+    obj    => bless({q => 1}, 'MyObj'),
+};
+
+my @sources = (
+    undef,
+    {},
+    {a => 2},
+    {a => 2, b => undef, u => 3, extra => 'e', extra_undef => undef},
+    {list => [3], nested => {x => 2, y => {deeper => 2}, w => 1}, obj => {r => 1}},
+    {nested => 'scalar', list => {not => 'list'}, a => [1]},
+    {nested => {y => undef, z => [2, 3]}, u => undef},
+    {map { ($_ => "new_$_") } keys %$tmpl},
+);
+
+my @flags = (0, MERGE_ARRAY_CONCAT, MERGE_ARRAY_MERGE, MERGE_LAZY, MERGE_SKIP_UNDEF, MERGE_DELETE_UNDEF, MERGE_COPY_SOURCE,
+             MERGE_LAZY | MERGE_ARRAY_CONCAT, MERGE_COPY_SOURCE | MERGE_ARRAY_MERGE | MERGE_SKIP_UNDEF);
+
+for my $flags (@flags) {
+    my $plan = Panda::Lib::MergePlan->new($tmpl, $flags);
+    for my $i (0..$#sources) {
+        my $expected = hash_merge(dclone($tmpl), dclone([$sources[$i]])->[0], $flags | MERGE_COPY_DEST);
+        my $src = dclone([$sources[$i]])->[0];
+        my $got = $plan->merge($src);
+        cmp_deeply($got, $expected, "flags=$flags source=$i");
+        cmp_deeply($src, $sources[$i], "flags=$flags source=$i: source intact");
+    }
+}
+
+# result doesn't share anything with template, template changes don't affect plan
+{
+    my $t = dclone($tmpl);
+    my $plan = Panda::Lib::MergePlan->new($t);
+    my $res = $plan->merge({a => 5});
+    $res->{nested}{x} = 100;
+    push @{$res->{list}}, 3;
+    $res->{obj}{q} = 2;
+    cmp_deeply($t, $tmpl);
+    $t->{nested}{x} = 200;
+    $t->{new} = 1;
+    $res = $plan->merge(undef);
+    cmp_deeply($res, $tmpl);
+    isa_ok($res->{obj}, 'MyObj');
+    isnt($plan->merge(undef)->{nested}, $plan->merge(undef)->{nested});
+}
+
+# empty template
+{
+    my $plan = Panda::Lib::MergePlan->new({});
+    cmp_deeply($plan->merge({a => 1, b => {c => 2}}), {a => 1, b => {c => 2}});
+    cmp_deeply(Panda::Lib::MergePlan->new(undef)->merge(undef), {});
+}
+
+# big template
+{
+    my $big = {map { ("key$_" => $_) } 1..1000};
+    $big->{sub} = {map { ("key$_" => $_) } 1..100};
+    my $plan = Panda::Lib::MergePlan->new($big);
+    my $src = {key1 => 'a', key999 => 'b', sub => {key5 => 'c', other => 1}, other => 2};
+    cmp_deeply($plan->merge($src), hash_merge($big, $src, MERGE_COPY_DEST));
+}
+
+# utf8 key, which is downgraded to latin-1 in hash, is the same key as latin-1 one, but has another shared HEK
+{
+    my $utf8 = Encode::decode_utf8("\xc3\xa9");
+    for my $t ([{"\xe9" => 1, x => 1}, {$utf8 => 2}], [{$utf8 => 1, x => 1}, {"\xe9" => 2}], [{"\xe9" => {a => 1}}, {$utf8 => {b => 2}}]) {
+        my ($tmpl, $src) = @$t;
+        for my $flags (0, MERGE_COPY_SOURCE) {
+            my $got = Panda::Lib::MergePlan->new($tmpl, $flags)->merge($src);
+            cmp_deeply($got, hash_merge(dclone($tmpl), $src, $flags | MERGE_COPY_DEST), "latin-1 key, flags=$flags");
+            is(scalar(keys %$got), scalar(keys %$tmpl), "latin-1 key, flags=$flags: no duplicate key");
+        }
+    }
+}
+
+ok(!eval { Panda::Lib::MergePlan::merge({}, {}); 1 }, 'invalid object');
+
+# plans are not cloned into threads: no double free or use of parent's data there
+SKIP: {
+    require Config;
+    skip 'no ithreads', 3 unless $Config::Config{useithreads};
+    require threads;
+    my $plan = Panda::Lib::MergePlan->new({a => 1, b => {c => 2}});
+    my $in_thread = threads->create(sub {
+        my $own = Panda::Lib::MergePlan->new({x => 1});
+        return [ref($plan) eq 'Panda::Lib::MergePlan' ? 1 : 0, $own->merge({y => 2})];
+    })->join;
+    is($in_thread->[0], 0, 'plan is not cloned to thread');
+    cmp_deeply($in_thread->[1], {x => 1, y => 2}, 'plan created in thread');
+    cmp_deeply($plan->merge({a => 3}), {a => 3, b => {c => 2}}, 'parent plan after thread');
+}
+
+done_testing();
@@ -0,0 +1,134 @@
+use 5.012;
+use warnings;
+use Test::More;
+use Storable qw/dclone/;
+use Panda::Lib qw/fingerprint compare/;
+
+sub fp_is   { is(fingerprint($_[0]), fingerprint($_[1]), $_[2]) }
+sub fp_isnt { isnt(fingerprint($_[0]), fingerprint($_[1]), $_[2]) }
+
+my $code = sub { 1 };
+my $obj  = bless {a => 1}, 'MyObj';
+my @data = (
+    undef, '', 0, 1, '1', 1.5, -3, 'str', "\x{442}\x{435}",
+    [], {}, [undef], [[]], [{}], {a => undef}, {a => ''}, {'' => 1}, [1, 2], [2, 1], [1, [2]], [[1], 2],
+    \1, \\1, \'1', \undef, [\1], {a => [1, {b => 2}]}, {a => [1, {b => 3}]}, {a => 1, b => 2}, {a => 2, b => 1},
+    $obj, bless({a => 1}, 'Other'), bless([], 'MyObj'), {a => 1}, $code, sub { 2 }, qr/abc/, qr/abd/i, \*STDOUT,
+);
+
+# equal data - equal fingerprints, different - different (no collisions expected on such small set)
+for my $i (0..$#data) {
+    my $copy = ref($data[$i]) eq 'CODE' || ref($data[$i]) eq 'GLOB' || ref($data[$i]) eq 'Regexp' ? $data[$i] : dclone([$data[$i]])->[0];
+    is(fingerprint($copy), fingerprint($data[$i]), "copy of $i");
+    for my $j ($i+1..$#data) {
+        next if compare($data[$i], $data[$j]);
+        fp_isnt($data[$i], $data[$j], "$i vs $j");
+    }
+}
+
+# same equality as compare()
+fp_is(1, '1');
+fp_is(1.5, '1.5');
+fp_is(10, 10.0);
+fp_is(-0.0, 0);
+fp_is(-15, '-15');
+fp_is(~0, "" . ~0);
+fp_is(-9223372036854775807 - 1, '-9223372036854775808');
+fp_is({a => [1, '2.5']}, {a => ['1', 2.5]});
+fp_isnt('1.0', 1);
+fp_is(qr/abc/, qr/abc/);
+{
+    my $nv = 1.5;
+    my @arr = (1, 2);
+    my $elem = $arr[$nv]; # gets private integer value
+    fp_is($nv, 1.5, 'fractional number used as index');
+    fp_isnt($nv, 1, 'fractional number used as index is not integer');
+}
+fp_is($code, $code);
+
+# independent of hash order and size
+{
+    my %h1 = map { ("key$_" => $_) } 1..1000;
+    my %h2;
+    keys(%h2) = 8192;
+    $h2{"key$_"} = $_ for reverse 1..1000;
+    fp_is(\%h1, \%h2, 'hash order');
+    delete $h2{key1};
+    fp_isnt(\%h1, \%h2);
+    $h2{key1} = 1;
+    $h2{key2} = 'changed';
+    fp_isnt(\%h1, \%h2);
+}
+
+# empty slot and undef
+{
+    my @a;
+    $a[1] = 1;
+    fp_isnt(\@a, [undef, 1]);
+    ok(!compare(\@a, [undef, 1]));
+}
+
+# numbers are not stringified
+{
+    my ($x, $y) = (0.1 + 0.2, 0.3);
+    ok(!compare($x, $y));
+    fingerprint($_) for $x, $y;
+    ok(!compare($x, $y), 'data not changed');
+}
+
+# cycles
+{
+    my $c1 = {name => 'a'};
+    $c1->{self} = $c1;
+    my $c2 = {name => 'a'};
+    $c2->{self} = $c2;
+    fp_is($c1, $c2, 'cycle');
+    $c2->{name} = 'b';
+    fp_isnt($c1, $c2);
+
+    my @ring1 = map { {id => $_ % 3} } 1..6;
+    my @ring2 = map { {id => $_ % 3} } 1..6;
+    $ring1[$_]{next} = $ring1[($_ + 1) % 6] for 0..5;
+    $ring2[$_]{next} = $ring2[($_ + 1) % 6] for 0..5;
+    fp_is($ring1[0], $ring2[0], 'ring');
+    $ring2[4]{id} = 10;
+    fp_isnt($ring1[0], $ring2[0]);
+
+    # shared node referring back to its parent: its hash depends on the path and is not memoized
+    my $p1 = {name => 'p1'};
+    my $child = {name => 'child', parent => $p1};
+    $p1->{child} = $child;
+    fp_is([$p1, $child], dclone([$p1, $child]), 'shared with back reference');
+    fp_is([$child, $p1, $child], dclone([$child, $p1, $child]));
+    fp_isnt([$p1, $child], [$child, $p1]);
+    my $p2 = {name => 'p1'};
+    $p2->{child} = {name => 'child', parent => $p2};
+    fp_is([$p1, $child], [$p2, {name => 'child', parent => $p2}], 'shared vs not shared');
+
+    %$_ = () for $c1, $c2, @ring1, @ring2, $p1, $child, $p2;
+}
+
+# DAG: exponential number of paths, linear time
+{
+    my $node = {leaf => 1};
+    $node = {left => $node, right => $node} for 1..60;
+    my $node2 = {leaf => 1};
+    $node2 = {left => $node2, right => $node2} for 1..60;
+    fp_is($node, $node2, 'dag');
+    my $node3 = {leaf => 2};
+    $node3 = {left => $node3, right => $node3} for 1..60;
+    fp_isnt($node, $node3);
+}
+
+# deep structures
+{
+    my ($l1, $l2) = (1, 1);
+    $l1 = [$l1] for 1..100000;
+    $l2 = [$l2] for 1..100000;
+    fp_is($l1, $l2, 'deep');
+    $l1 = {a => $l1} for 1..20; # deeper than linear path scan
+    $l2 = {a => $l2} for 1..20;
+    fp_is($l1, $l2);
+}
+
+done_testing();
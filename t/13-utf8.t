@@ -0,0 +1,95 @@
+use 5.012;
+use warnings;
+use Test::More;
+use Panda::Lib qw/is_ascii utf8_validate utf8_length/;
+
+# reference: decode sequences by hand, strict RFC 3629
+sub ref_validate {
+    my @b = unpack 'C*', shift;
+    my $i = 0;
+    while ($i < @b) {
+        my $c = $b[$i];
+        if ($c < 0x80) { $i++; next }
+        my ($n, $cp, $min) = $c >= 0xF0 && $c < 0xF8 ? (3, $c & 7, 0x10000) : $c >= 0xE0 ? (2, $c & 15, 0x800) :
+                             $c >= 0xC0 && $c < 0xE0 ? (1, $c & 31, 0x80) : return 0;
+        return 0 if $c >= 0xF8 || $i + $n >= @b;
+        for (1..$n) {
+            return 0 if ($b[$i + $_] & 0xC0) != 0x80;
+            $cp = ($cp << 6) | ($b[$i + $_] & 0x3F);
+        }
+        return 0 if $cp < $min || $cp > 0x10FFFF || ($cp >= 0xD800 && $cp <= 0xDFFF);
+        $i += $n + 1;
+    }
+    return 1;
+}
+
+sub check {
+    my ($bytes, $name) = @_;
+    my $valid = ref_validate($bytes);
+    is(utf8_validate($bytes) ? 1 : 0, $valid, "validate $name") or diag(unpack 'H*', $bytes);
+    is(is_ascii($bytes) ? 1 : 0, $bytes =~ /[\x80-\xff]/ ? 0 : 1, "is_ascii $name");
+    is(utf8_length($bytes), scalar(() = $bytes =~ /[^\x80-\xbf]/g), "length $name");
+}
+
+my %seq = (
+    ascii      => "a",
+    two        => "\xd1\x82",
+    three      => "\xe2\x82\xac",
+    four       => "\xf0\x9f\x98\x80",
+    max        => "\xf4\x8f\xbf\xbf",
+    cont       => "\x80",
+    lone_lead2 => "\xd1",
+    lone_lead3 => "\xe2\x82",
+    lone_lead4 => "\xf0\x9f\x98",
+    overlong2  => "\xc0\xaf",
+    overlong2b => "\xc1\xbf",
+    overlong3  => "\xe0\x80\xaf",
+    overlong4  => "\xf0\x80\x80\xaf",
+    surrogate  => "\xed\xa0\x80",
+    surr_high  => "\xed\xbf\xbf",
+    too_large  => "\xf4\x90\x80\x80",
+    f5         => "\xf5\x80\x80\x80",
+    ff         => "\xff",
+    two_conts  => "\xd1\x82\x82",
+    short3     => "\xe2\x82a",
+    short4     => "\xf0\x9f\x98a",
+);
+
+# every sequence at every offset around 16/32-byte block boundaries and in the tail
+for my $name (sort keys %seq) {
+    for my $len (0, 1, 13, 14, 15, 16, 17, 29, 30, 31, 32, 33, 62, 63, 64, 100) {
+        check(('x' x $len) . $seq{$name}, "$name at $len");
+        check(('x' x $len) . $seq{$name} . ("\xd0\xb9" x 20), "$name at $len + cyrillic");
+        check(("\xe2\x82\xac" x int($len / 3)) . $seq{$name} . 'y', "$name after euro x" . int($len / 3));
+    }
+}
+
+check('', 'empty');
+check("\0" x 100, 'nuls');
+check("\xd0\xb9" x 5000, 'long cyrillic');
+check(("a" x 10000) . "\xc0\x80", 'long with bad tail');
+check(("\xf0\x9f\x98\x80" x 1000) . "\xed\xa0\x80" . ("b" x 1000), 'long with surrogate inside');
+check("\xe2" x 10000, 'long lead bytes');
+
+# random valid strings and their corruptions
+srand(42);
+for my $i (1..300) {
+    my $str = join '', map { chr(int(rand(4)) == 0 ? 0x800 + int(rand(0xD000)) : int(rand(0x500))) } 1..int(rand(120));
+    utf8::encode($str);
+    check($str, "random $i");
+    next unless length $str;
+    substr($str, int(rand(length $str)), 1, chr(int(rand(256))));
+    check($str, "random corrupted $i");
+}
+
+# character strings are checked by their UTF-8 representation, data not changed
+{
+    my $str = "\x{442}\x{435}st";
+    ok(utf8_validate($str));
+    is(utf8_length($str), 4);
+    ok(!is_ascii($str));
+    ok(utf8::is_utf8($str));
+    ok(is_ascii(12345));
+}
+
+done_testing();
@@ -0,0 +1,53 @@
+use 5.012;
+use warnings;
+use Test::More;
+use Panda::Lib qw/itoa itoa_batch itoa_join atoi/;
+
+my @nums = (0, 1, -1, 9, 10, -10, 99, 100, 101, 12345, -98765, 2147483647, -2147483648, 4294967296, 9223372036854775807,
+            -9223372036854775807 - 1, ~0, ~0 - 1);
+push @nums, map { 0 + $_ } '9' x $_, '1' . '0' x $_, '-1' . '0' x $_ for 1..18;
+srand(7);
+push @nums, int(rand(2**$_)) * (rand() < 0.5 ? 1 : -1) for 1..52;
+
+for my $n (@nums) {
+    is(itoa($n), "$n", "itoa $n");
+    is(atoi("$n"), $n, "atoi $n");
+}
+
+is(itoa("42"), '42', 'string');
+is(itoa(3.9), '3', 'float is truncated');
+is(itoa(-3.9), '-3');
+
+# batch
+is_deeply(itoa_batch(\@nums), [map {"$_"} @nums], 'itoa_batch');
+is_deeply(itoa_batch([]), []);
+is(itoa_join(\@nums), join(',', @nums), 'itoa_join');
+is(itoa_join(\@nums, ' | '), join(' | ', @nums));
+is(itoa_join([1, 2, 3], ''), '123');
+is(itoa_join([]), '');
+is(itoa_join([5]), '5');
+{
+    my @sparse;
+    $sparse[2] = 7;
+    is(itoa_join(\@sparse), '0,0,7', 'missing elements');
+    is_deeply(itoa_batch(\@sparse), [0, 0, 7]);
+    my $res = itoa_join([1, 2], "\x{2192}");
+    is($res, "1\x{2192}2", 'utf8 separator');
+    my $big = itoa_join([(~0) x 10000], ',');
+    is(length($big), 10000 * 21 - 1);
+}
+
+# parse: whole string must be an integer
+is(atoi('+15'), 15);
+is(atoi('-0'), 0);
+is(atoi('007'), 7);
+is(atoi('00000000000000000000000000000000042'), 42, 'leading zeros');
+is(atoi('18446744073709551615'), ~0, 'max unsigned');
+is(atoi('+18446744073709551615'), ~0);
+is(atoi('-9223372036854775808'), -9223372036854775807 - 1, 'min signed');
+is(atoi('1234567812345678'), 1234567812345678);
+is(atoi('12345678123456781234'), 12345678123456781234);
+ok(!defined atoi($_), "invalid '$_'") for ('', '-', '+', '-+1', '+-1', ' 1', '1 ', '1.5', '1e5', 'abc', '0x10', '12345678x',
+    '1234567/', '1234567:', '18446744073709551616', '99999999999999999999', '-9223372036854775809', '-18446744073709551615');
+
+done_testing();
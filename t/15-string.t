@@ -0,0 +1,7 @@
+use 5.012;
+use warnings;
+
+# panda::string and panda::string_builder are tested by t/cpp/string.cc, built by 'make test'
+my $bin = 't/cpp/string';
+unless (-x $bin) { print "1..0 # SKIP $bin is not built, run 'make test'\n"; exit }
+exec $bin or die "$bin: $!\n";
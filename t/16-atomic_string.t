@@ -0,0 +1,7 @@
+use 5.012;
+use warnings;
+
+# panda::atomic_string concurrency stress test is t/cpp/atomic_string.cc, built by 'make test'
+my $bin = 't/cpp/atomic_string';
+unless (-x $bin) { print "1..0 # SKIP $bin is not built, run 'make test'\n"; exit }
+exec $bin or die "$bin: $!\n";
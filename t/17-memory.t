@@ -0,0 +1,7 @@
+use 5.012;
+use warnings;
+
+# pool and arena allocators, string allocators are tested by t/cpp/memory.cc, built by 'make test'
+my $bin = 't/cpp/memory';
+unless (-x $bin) { print "1..0 # SKIP $bin is not built, run 'make test'\n"; exit }
+exec $bin or die "$bin: $!\n";
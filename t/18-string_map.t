@@ -0,0 +1,7 @@
+use 5.012;
+use warnings;
+
+# panda::string_map and string_set are tested by t/cpp/string_map.cc, built by 'make test'
+my $bin = 't/cpp/string_map';
+unless (-x $bin) { print "1..0 # SKIP $bin is not built, run 'make test'\n"; exit }
+exec $bin or die "$bin: $!\n";
@@ -0,0 +1,17 @@
+use 5.012;
+use warnings;
+
+# search kernels are tested by t/cpp/search.cc, built by 'make test' once per SIMD level. Every binary is a subtest here
+my @levels = qw/scalar sse2 avx2/;
+print "1..", scalar(@levels), "\n";
+my $n = 0;
+for my $level (@levels) {
+    my $bin = "t/cpp/search_$level";
+    ++$n;
+    unless (-x $bin) { print "ok $n # SKIP $bin is not built, run 'make test'\n"; next }
+    my $out = `$bin`;
+    my $status = $?;
+    $out =~ s/^/    /mg;
+    print $out;
+    print $status ? "not ok" : "ok", " $n - $level kernels\n";
+}
@@ -27,14 +27,27 @@ my $s3 = {"clover" => {"finish_date" => 12345676,"fillup_multiplier" => 1.3},"ma
 for (my $i = 0; $i < 100000; $i++) {
     my $ret = Panda::Lib::string_hash($str);
     $ret = Panda::Lib::string_hash32($str);
+    $ret = Panda::Lib::hash64($str, 1);
+    $ret = Panda::Lib::hash64_batch([$str, $str2, ""], 1);
     $ret = Panda::Lib::crypt_xor($str, $str2);
+    $ret = Panda::Lib::crypt_xor($str, $str2, 3);
+    Panda::Lib::crypt_xor_inplace($ret, $str2, 3);
     $ret = Panda::Lib::timeout(sub { my $a = 10 }, 1);
+    $ret = Panda::Lib::itoa_batch([1, -2, ~0, undef]);
+    $ret = Panda::Lib::itoa_join([1, -2, ~0, undef], ', ');
+    $ret = Panda::Lib::atoi('-12345');
 
     my $h1c = eval($h1); 
     Panda::Lib::hash_merge($h1c, $h2, MERGE_DELETE_UNDEF);
     $h1c = eval($h1);
     Panda::Lib::hash_merge($h1c, $h2, MERGE_COPY);
     Panda::Lib::hash_merge(undef, $h2);
+    Panda::Lib::hash_merge_many($h1c, [$h2, undef, $s1], MERGE_COPY);
+    Panda::Lib::merge_many($h1c, [$h2, 1], MERGE_COPY_DEST);
+    Panda::Lib::hash_merge_many({}, [{a => $s1}, {a => 1}, {b => $s1}], MERGE_COPY_SOURCE);
+    my $plan = Panda::Lib::MergePlan->new($h2, MERGE_ARRAY_CONCAT);
+    $plan->merge($s1);
+    $plan->merge(undef);
     Panda::Lib::hash_merge($h1c, undef);
     Panda::Lib::hash_merge($h1c, undef, MERGE_COPY);
     Panda::Lib::hash_merge(undef, undef);
@@ -47,7 +60,15 @@ for (my $i = 0; $i < 100000; $i++) {
     $cycled->{c} = $cycled;
     Panda::Lib::clone($_) for @to_test;
     Panda::Lib::fclone($_) for @to_test;
+    Panda::Lib::clone($_, Panda::Lib::CLONE_NO_COW) for @to_test;
+    my @copies = Panda::Lib::fclone_many(\@to_test, Panda::Lib::CLONE_SHARED);
+    @copies = Panda::Lib::clone_times(\@to_test, 3);
     my $copy = Panda::Lib::fclone($cycled);
+    Panda::Lib::compare($copy, $cycled);
+    my $utf8 = {a => "\x{442}\x{435}", b => ["\xd1\x82", 'ascii', {c => "\xd0"}]};
+    Panda::Lib::encode_utf8_struct($utf8);
+    Panda::Lib::decode_utf8_struct($utf8);
+    Panda::Lib::fingerprint($_) for @to_test, $cycled, \@to_test;
     delete $cycled->{c};
     delete $copy->{c};
 
@@ -0,0 +1,109 @@
+// panda::atomic_string stress test: threads exchange shared copies, windows and detached copies of one source through
+// mutex-guarded slots and modify what they get. Strings must keep their content, buffers must be freed exactly once.
+#include "test.h"
+#include <vector>
+#include <cstdlib>
+#include <pthread.h>
+#include <panda/string.h>
+#include <panda/lib/memory.h>
+
+using panda::atomic_string;
+using panda::lib::allocator;
+using panda::lib::string_allocator_guard;
+
+class counting_allocator : public allocator {
+public:
+    long live;
+    counting_allocator () : live(0) {}
+    void* allocate (size_t size) {
+        __atomic_add_fetch(&live, 1, __ATOMIC_RELAXED);
+        return std::malloc(size);
+    }
+    void* reallocate (void* ptr, size_t, size_t new_size) { return std::realloc(ptr, new_size); }
+    void deallocate (void* ptr, size_t) {
+        __atomic_sub_fetch(&live, 1, __ATOMIC_RELAXED);
+        std::free(ptr);
+    }
+};
+
+struct stress_t {
+    static const int SLOTS = 16;
+    counting_allocator counter;
+    atomic_string      source;
+    atomic_string      slots[SLOTS];
+    pthread_mutex_t    mutexes[SLOTS];
+    int                iterations;
+    int                errors;
+};
+
+struct stress_thread_t {
+    stress_t* ctx;
+    unsigned  seed;
+};
+
+// every string is a substring of source ('a'..'z' repeated), possibly with 'x'-es appended
+static bool check (const atomic_string& s) {
+    size_t len = s.length();
+    while (len && s[len-1] == 'x') --len;
+    for (size_t i = 1; i < len; ++i) if (s[i] != char('a' + (s[0] - 'a' + i) % 26)) return false;
+    return true;
+}
+
+static void* stress_thread (void* arg) {
+    stress_t* ctx  = static_cast<stress_thread_t*>(arg)->ctx;
+    unsigned  seed = static_cast<stress_thread_t*>(arg)->seed;
+    string_allocator_guard guard(&ctx->counter);
+    for (int i = 0; i < ctx->iterations; ++i) {
+        seed = seed * 1103515245 + 12345;
+        int n = (seed >> 8) % stress_t::SLOTS;
+        atomic_string mine;
+        switch ((seed >> 16) % 4) {
+            case 0: mine = ctx->source; break;                                 // share
+            case 1: mine = ctx->source.substr((seed >> 4) % 100, 200); break;  // window
+            case 2: mine = ctx->source; mine.append(1, 'x'); break;            // detach
+            case 3: mine.assign(ctx->source.data(), 100, atomic_string::COPY); break;
+        }
+        pthread_mutex_lock(&ctx->mutexes[n]);
+        atomic_string theirs = ctx->slots[n];
+        ctx->slots[n] = mine;
+        pthread_mutex_unlock(&ctx->mutexes[n]);
+        if (!check(theirs)) __atomic_add_fetch(&ctx->errors, 1, __ATOMIC_RELAXED);
+        if ((seed >> 24) % 2) theirs.append(1, 'x'); // modify other thread's string - must detach
+        if (!check(theirs)) __atomic_add_fetch(&ctx->errors, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+int main () {
+    const int threads = 4;
+    stress_t ctx;
+    ctx.iterations = 50000;
+    ctx.errors = 0;
+    {
+        string_allocator_guard guard(&ctx.counter);
+        ctx.source.resize(1000);
+        for (size_t i = 0; i < ctx.source.length(); ++i) ctx.source[i] = 'a' + i % 26;
+    }
+    for (int i = 0; i < stress_t::SLOTS; ++i) pthread_mutex_init(&ctx.mutexes[i], NULL);
+
+    std::vector<pthread_t>       tids(threads);
+    std::vector<stress_thread_t> args(threads);
+    int started = 0; // if thread creation fails, fewer threads are enough for the test
+    for (; started < threads; ++started) {
+        args[started].ctx  = &ctx;
+        args[started].seed = started + 1;
+        if (pthread_create(&tids[started], NULL, stress_thread, &args[started])) break;
+    }
+    for (int i = 0; i < started; ++i) pthread_join(tids[i], NULL);
+    if (started < threads) test::diag("only %d threads started", started);
+
+    for (int i = 0; i < stress_t::SLOTS; ++i) {
+        ctx.slots[i] = atomic_string();
+        pthread_mutex_destroy(&ctx.mutexes[i]);
+    }
+    ctx.source = atomic_string();
+
+    test::is_num(ctx.errors, 0, "strings keep their content");
+    test::is_num(ctx.counter.live, 0, "all buffers freed once");
+    return test::done_testing();
+}
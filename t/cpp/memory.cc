@@ -0,0 +1,237 @@
+// panda::lib::pool_allocator, arena_allocator and string allocator of panda::string
+#include "test.h"
+#include <vector>
+#include <cstdlib>
+#include <stdint.h>
+#include <pthread.h>
+#include <panda/string.h>
+#include <panda/lib/memory.h>
+
+using panda::string;
+using namespace panda::lib;
+using test::ok;
+using test::is;
+using test::is_num;
+
+// frees of cached blocks (by flush and at thread exit) are seen by interposing free() of glibc
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#  define WATCH_FREE
+static const int WATCHED = 10;
+static void* watched[WATCHED];
+static bool  watched_freed[WATCHED];
+
+extern "C" void __libc_free (void* ptr);
+extern "C" void free (void* ptr) {
+    if (ptr) for (int i = 0; i < WATCHED; ++i) if (watched[i] == ptr) watched_freed[i] = true;
+    __libc_free(ptr);
+}
+
+static int watched_freed_count () {
+    int cnt = 0;
+    for (int i = 0; i < WATCHED; ++i) cnt += watched_freed[i];
+    return cnt;
+}
+#endif
+
+class counting_allocator : public allocator {
+public:
+    long live;
+    long allocs;
+    counting_allocator () : live(0), allocs(0) {}
+    void* allocate (size_t size) {
+        ++live;
+        ++allocs;
+        return std::malloc(size);
+    }
+    void* reallocate (void* ptr, size_t, size_t new_size) { return std::realloc(ptr, new_size); }
+    void deallocate (void* ptr, size_t) {
+        --live;
+        std::free(ptr);
+    }
+};
+
+static void test_pool_classes () {
+    pool_allocator* pool = pool_allocator::instance();
+    ok(pool == pool_allocator::instance(), "pool: single instance");
+
+    // blocks are rounded up to power of 2 size classes: a freed block is reused for any size of its class
+    const size_t sizes[][2] = {{1, 32}, {32, 32}, {33, 64}, {100, 128}, {129, 256}, {1000, 1024}, {5000, 8192}};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        size_t size = sizes[i][0], cls = sizes[i][1];
+        void* p = pool->allocate(size);
+        std::memset(p, 'x', cls); // the whole class size is usable
+        pool->deallocate(p, size);
+        ok(pool->allocate(cls) == p, "pool: %d bytes block is reused for %d bytes", (int)size, (int)cls);
+        void* other = pool->allocate(size);
+        ok(other != p, "pool: block is taken from free list");
+        pool->deallocate(other, size);
+        pool->deallocate(p, cls);
+        void* bigger = pool->allocate(cls + 1);
+        ok(bigger != p, "pool: %d bytes block is not reused for %d bytes", (int)size, (int)cls + 1);
+        pool->deallocate(bigger, cls + 1);
+    }
+
+    // free list is LIFO
+    void* a = pool->allocate(64);
+    void* b = pool->allocate(64);
+    pool->deallocate(a, 64);
+    pool->deallocate(b, 64);
+    ok(pool->allocate(64) == b && pool->allocate(64) == a, "pool: last freed block is reused first");
+    pool->deallocate(a, 64);
+    pool->deallocate(b, 64);
+
+    // reallocate within a class keeps the block
+    void* p = pool->allocate(40);
+    ok(pool->reallocate(p, 40, 64) == p, "pool: reallocate within size class is in place");
+    void* q = pool->reallocate(p, 64, 20000);
+    std::memset(q, 'y', 20000);
+    q = pool->reallocate(q, 20000, 30000);
+    std::memset(q, 'z', 30000);
+    pool->deallocate(q, 30000);
+    ok(true, "pool: blocks bigger than MAX_SIZE are reallocated by malloc");
+
+    pool_allocator::flush();
+}
+
+static void test_pool_max_cached () {
+    pool_allocator* pool = pool_allocator::instance();
+    pool_allocator::flush();
+    const size_t N = pool_allocator::MAX_CACHED + 50;
+    std::vector<void*> blocks(N);
+    for (size_t i = 0; i < N; ++i) blocks[i] = pool->allocate(256);
+    for (size_t i = 0; i < N; ++i) pool->deallocate(blocks[i], 256);
+
+    // only the first MAX_CACHED are cached, the rest went to free(); cache is reused in reverse order
+    size_t from_cache = 0;
+    std::vector<void*> again(pool_allocator::MAX_CACHED);
+    for (size_t i = 0; i < pool_allocator::MAX_CACHED; ++i) {
+        again[i] = pool->allocate(256);
+        if (again[i] == blocks[pool_allocator::MAX_CACHED - 1 - i]) ++from_cache;
+    }
+    is_num(from_cache, pool_allocator::MAX_CACHED, "pool: MAX_CACHED blocks per size class are cached");
+    for (size_t i = 0; i < again.size(); ++i) pool->deallocate(again[i], 256);
+    pool_allocator::flush();
+}
+
+#ifdef WATCH_FREE
+static void* pool_thread (void*) {
+    pool_allocator* pool = pool_allocator::instance();
+    for (int i = 0; i < WATCHED; ++i) watched[i] = pool->allocate(128);
+    for (int i = 0; i < WATCHED; ++i) pool->deallocate(watched[i], 128);
+    return (void*)(intptr_t)watched_freed_count();
+}
+#endif
+
+static void test_pool_free () {
+#ifdef WATCH_FREE
+    pool_allocator* pool = pool_allocator::instance();
+    for (int i = 0; i < WATCHED; ++i) watched[i] = pool->allocate(128);
+    for (int i = 0; i < WATCHED; ++i) pool->deallocate(watched[i], 128);
+    is_num(watched_freed_count(), 0, "pool: freed blocks are cached");
+    pool_allocator::flush();
+    is_num(watched_freed_count(), WATCHED, "pool: flush frees cached blocks");
+    for (int i = 0; i < WATCHED; ++i) {
+        watched[i] = NULL;
+        watched_freed[i] = false;
+    }
+
+    pthread_t tid;
+    void* freed_in_thread;
+    if (pthread_create(&tid, NULL, pool_thread, NULL)) {
+        ok(false, "pool: thread started");
+        return;
+    }
+    pthread_join(tid, &freed_in_thread);
+    is_num((intptr_t)freed_in_thread, 0, "pool: freed blocks are cached by thread");
+    is_num(watched_freed_count(), WATCHED, "pool: thread's cached blocks are freed at its exit");
+    for (int i = 0; i < WATCHED; ++i) watched[i] = NULL;
+#else
+    for (int i = 0; i < 4; ++i) ok(true, "# SKIP free() can't be watched");
+#endif
+}
+
+static void test_arena () {
+    arena_allocator arena(1024);
+    is_num(arena.allocated(), 0, "arena: no chunk until first allocation");
+
+    char* a = (char*)arena.allocate(10);
+    char* b = (char*)arena.allocate(10);
+    ok(((uintptr_t)a % 16) == 0 && ((uintptr_t)b % 16) == 0, "arena: allocations are aligned");
+    ok(b == a + 16, "arena: allocations are consecutive");
+    is_num(arena.allocated(), 1024, "arena: one chunk");
+
+    arena.deallocate(b, 10);
+    ok(arena.allocate(20) == b, "arena: deallocate of last allocation rolls it back");
+    arena.deallocate(a, 10);
+    ok(arena.allocate(10) != a, "arena: deallocate of not last allocation does nothing");
+
+    char* c = (char*)arena.allocate(100);
+    ok(arena.reallocate(c, 100, 300) == c, "arena: last allocation grows in place");
+    char* d = (char*)arena.reallocate(b, 20, 40);
+    ok(d != b, "arena: not last allocation is moved by reallocate");
+
+    arena.allocate(5000); // bigger than chunk - own chunk
+    ok(arena.allocated() > 1024 + 5000, "arena: big allocation gets its own chunk");
+    arena.allocate(1000); // doesn't fit into the rest of current chunk
+    size_t before = arena.allocated();
+
+    arena.reset();
+    ok(arena.allocated() < before, "arena: reset frees chunks");
+    is_num(arena.allocated(), 1024, "arena: reset keeps the most recent chunk");
+    char* e = (char*)arena.allocate(10);
+    ok(arena.allocate(10) == e + 16, "arena: kept chunk is reused");
+}
+
+static void test_string_allocator () {
+    counting_allocator counter;
+    ok(get_string_allocator() == NULL, "string: malloc by default");
+    string s1, s2;
+    {
+        string_allocator_guard guard(&counter);
+        ok(get_string_allocator() == &counter, "string: guard sets allocator");
+        s1.assign(100, 'a');
+        s2.assign(100, 'b');
+        string sso(10, 'c');
+        is_num(counter.live, 2, "string: heap buffers are allocated by allocator of the guard");
+    }
+    ok(get_string_allocator() == NULL, "string: previous allocator is restored");
+
+    string s3(100, 'd');
+    is_num(counter.allocs, 2, "string: no allocations after guard is gone");
+
+    s1.append(1000, 'e');
+    is(s1, std::string(100, 'a') + std::string(1000, 'e'), "string: grows after guard is gone");
+    s2 = string();
+    is_num(counter.live, 1, "string: buffer is returned to its allocator after guard is gone");
+    string shared = s1;
+    s1 = string();
+    is_num(counter.live, 1, "string: shared buffer is alive");
+    shared = string();
+    is_num(counter.live, 0, "string: all buffers returned to their allocator");
+
+    {
+        arena_allocator arena;
+        string_allocator_guard guard(&arena);
+        string a(100, 'a');
+        a.append(100, 'b');
+        is(a, std::string(100, 'a') + std::string(100, 'b'), "string: in arena");
+        ok(arena.allocated() > 0, "string: arena is used");
+    }
+    {
+        string_allocator_guard guard(pool_allocator::instance());
+        string a(100, 'a');
+        string b(a);
+        b.append(1000, 'b');
+        a = string();
+        is(b, std::string(100, 'a') + std::string(1000, 'b'), "string: in pool");
+    }
+}
+
+int main () {
+    test_pool_classes();
+    test_pool_max_cached();
+    test_pool_free();
+    test_arena();
+    test_string_allocator();
+    return test::done_testing();
+}
@@ -0,0 +1,168 @@
+// panda::lib search kernels and panda::string find methods against naive search. Built once per SIMD level
+// (PANDA_SEARCH_MAX_LEVEL), so that scalar, SSE2 and AVX2 kernels are all tested on the same data. Haystacks end exactly
+// at the end of their allocation and start at different alignments, needles and set chars are placed around 16/32 bytes
+// block boundaries.
+#include "test.h"
+#include <vector>
+#include <cstdlib>
+#include <panda/string.h>
+#include <panda/lib/search.h>
+
+using panda::string;
+using namespace panda::lib;
+using test::ok;
+
+/* naive search */
+
+static const char* ref_find (const char* h, size_t hlen, const char* n, size_t nlen) {
+    for (size_t i = 0; i + nlen <= hlen; ++i) if (std::memcmp(h + i, n, nlen) == 0) return h + i;
+    return NULL;
+}
+
+static const char* ref_rfind (const char* h, size_t hlen, const char* n, size_t nlen) {
+    if (nlen > hlen) return NULL;
+    for (size_t i = hlen - nlen + 1; i--;) if (std::memcmp(h + i, n, nlen) == 0) return h + i;
+    return NULL;
+}
+
+static bool in_set (char c, const char* set, size_t setlen) { return std::memchr(set, c, setlen) != NULL; }
+
+template <bool NOT>
+static const char* ref_find_of (const char* s, size_t len, const char* set, size_t setlen) {
+    for (size_t i = 0; i < len; ++i) if (in_set(s[i], set, setlen) != NOT) return s + i;
+    return NULL;
+}
+
+template <bool NOT>
+static const char* ref_rfind_of (const char* s, size_t len, const char* set, size_t setlen) {
+    for (size_t i = len; i--;) if (in_set(s[i], set, setlen) != NOT) return s + i;
+    return NULL;
+}
+
+typedef const char* (*search_fn) (const char*, size_t, const char*, size_t);
+
+struct check_t {
+    const char* name;
+    search_fn   fn;
+    search_fn   ref;
+    long        count;
+    long        failed;
+};
+
+static void check (check_t& c, const char* h, size_t hlen, const char* n, size_t nlen, size_t align) {
+    ++c.count;
+    const char* got = c.fn(h, hlen, n, nlen);
+    const char* exp = c.ref(h, hlen, n, nlen);
+    if (got == exp) return;
+    if (!c.failed++) test::diag(
+        "%s: haystack '%.*s' (%d bytes, alignment %d), needle '%.*s': got %ld, expected %ld", c.name, (int)hlen, h, (int)hlen,
+        (int)align, (int)nlen, n, got ? long(got - h) : -1L, exp ? long(exp - h) : -1L
+    );
+}
+
+// 'a' and 'b' with rare 'c'
+static void fill (char* s, size_t len, unsigned& seed) {
+    for (size_t i = 0; i < len; ++i) {
+        seed = seed * 1103515245 + 12345;
+        unsigned r = (seed >> 16) % 20;
+        s[i] = r == 0 ? 'c' : (r < 12 ? 'a' : 'b');
+    }
+}
+
+static const size_t POSITIONS[] = {0, 1, 7, 14, 15, 16, 17, 30, 31, 32, 33, 47, 48, 63, 64, 65};
+static const size_t NEEDLE_LENS[] = {1, 2, 3, 5, 15, 16, 17, 31, 32, 33};
+static const size_t ALIGNS[] = {0, 1, 7, 15, 16, 31};
+
+static void test_kernels () {
+    check_t bytes[] = {
+        {"find_bytes",  find_bytes,  ref_find,  0, 0},
+        {"rfind_bytes", rfind_bytes, ref_rfind, 0, 0},
+    };
+    check_t sets[] = {
+        {"find_first_of",     find_first_of,     ref_find_of<false>,  0, 0},
+        {"find_first_not_of", find_first_not_of, ref_find_of<true>,   0, 0},
+        {"find_last_of",      find_last_of,      ref_rfind_of<false>, 0, 0},
+        {"find_last_not_of",  find_last_not_of,  ref_rfind_of<true>,  0, 0},
+    };
+    // sets up to MAX_SIMD_SET (16) chars are searched by SIMD kernels, bigger ones by bitmap
+    const char* set_list[] = {"", "c", "a", "cd", "ab", "abc", "defghijklmnopqrc", "defghijklmnopqrsc", "abdefghijklmnopq", "abdefghijklmnopqr"};
+
+    unsigned seed = 1;
+    std::vector<char> needle;
+    for (size_t a = 0; a < sizeof(ALIGNS) / sizeof(ALIGNS[0]); ++a) for (size_t len = 0; len <= 100; ++len) {
+        size_t align = ALIGNS[a];
+        char* mem = (char*)std::malloc(1 + align + len);
+        char* h = mem + 1 + align; // ends at the end of allocation
+        fill(h, len, seed);
+
+        for (size_t i = 0; i < sizeof(NEEDLE_LENS) / sizeof(NEEDLE_LENS[0]); ++i) {
+            size_t nlen = NEEDLE_LENS[i];
+            needle.resize(nlen);
+            for (size_t j = 0; j < sizeof(POSITIONS) / sizeof(POSITIONS[0]) + 1; ++j) {
+                size_t pos = j < sizeof(POSITIONS) / sizeof(POSITIONS[0]) ? POSITIONS[j] : len - nlen; // last one - at the end
+                if (nlen > len || pos + nlen > len) continue;
+                std::memcpy(&needle[0], h + pos, nlen);
+                for (size_t k = 0; k < 2; ++k) check(bytes[k], h, len, &needle[0], nlen, align);
+                needle[nlen-1] = 'd'; // first byte matches, last doesn't
+                for (size_t k = 0; k < 2; ++k) check(bytes[k], h, len, &needle[0], nlen, align);
+            }
+        }
+        for (size_t k = 0; k < 2; ++k) check(bytes[k], h, len, "", 0, align);
+
+        // set chars at block boundaries: 'c' put into positions one by one, 'a'-only haystack for not_of
+        for (size_t s = 0; s < sizeof(set_list) / sizeof(set_list[0]); ++s) {
+            const char* set = set_list[s];
+            for (size_t k = 0; k < 4; ++k) check(sets[k], h, len, set, std::strlen(set), align);
+        }
+        std::vector<char> copy(h, h + len);
+        for (size_t j = 0; j < sizeof(POSITIONS) / sizeof(POSITIONS[0]); ++j) {
+            size_t pos = POSITIONS[j];
+            if (pos >= len) break;
+            std::memset(h, 'a', len);
+            h[pos] = 'c';
+            for (size_t s = 0; s < sizeof(set_list) / sizeof(set_list[0]); ++s) {
+                const char* set = set_list[s];
+                for (size_t k = 0; k < 4; ++k) check(sets[k], h, len, set, std::strlen(set), align);
+            }
+        }
+        if (len) std::memcpy(h, &copy[0], len);
+        std::free(mem);
+    }
+
+    for (size_t k = 0; k < 2; ++k) ok(!bytes[k].failed, "%s (%ld cases)", bytes[k].name, bytes[k].count);
+    for (size_t k = 0; k < 4; ++k) ok(!sets[k].failed, "%s (%ld cases)", sets[k].name, sets[k].count);
+}
+
+// string methods with start positions, compared with std::string
+static void test_string () {
+    unsigned seed = 2;
+    std::vector<char> buf(100);
+    fill(&buf[0], buf.size(), seed);
+    std::string ref(&buf[0], buf.size());
+    string str(&buf[0], buf.size(), string::COPY);
+    const char* needles[] = {"ab", "abba", "ca", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", "c"};
+    const char* sets[] = {"c", "ab", "bc", "defghijklmnopqrsc"};
+    long failed = 0, count = 0;
+    for (size_t pos = 0; pos <= ref.length() + 1; ++pos) {
+        for (size_t i = 0; i < sizeof(needles) / sizeof(needles[0]); ++i) {
+            count += 2;
+            failed += str.find(needles[i], pos) != ref.find(needles[i], pos);
+            failed += str.rfind(needles[i], pos) != ref.rfind(needles[i], pos);
+        }
+        for (size_t i = 0; i < sizeof(sets) / sizeof(sets[0]); ++i) {
+            count += 4;
+            failed += str.find_first_of(sets[i], pos) != ref.find_first_of(sets[i], pos);
+            failed += str.find_first_not_of(sets[i], pos) != ref.find_first_not_of(sets[i], pos);
+            failed += str.find_last_of(sets[i], pos) != ref.find_last_of(sets[i], pos);
+            failed += str.find_last_not_of(sets[i], pos) != ref.find_last_not_of(sets[i], pos);
+        }
+    }
+    ok(!failed, "string find methods with positions (%ld cases)", count);
+    ok(str.find("", 5) == 5 && str.rfind("") == str.length() && str.find("", 200) == string::npos, "empty needle");
+}
+
+int main () {
+    test_kernels();
+    test_string();
+    return test::done_testing();
+}
@@ -0,0 +1,208 @@
+// panda::string and panda::string_builder: operations, which take their argument from the string itself, copies of builders
+#include "test.h"
+#include <cstdlib>
+#include <panda/string.h>
+#include <panda/string_builder.h>
+
+using panda::string;
+using test::ok;
+using test::is;
+
+static const char* const SAMPLES[] = {"abcdefghij", "abcdefghijklmno", "abcdefghijklmnop", NULL};
+
+// release_fn for strings over external memory: poisons it, so that reading it after release shows up
+static void poison_free (const char* ptr, void* ctx) {
+    std::memset(const_cast<char*>(ptr), '#', (size_t)ctx);
+    std::free(const_cast<char*>(ptr));
+}
+
+static void test_self (const std::string& str) {
+    int len = str.length();
+    {
+        string s(str.data(), str.length(), string::COPY);
+        s.append(s);
+        is(s, str + str, "append self, %d chars", len);
+    }
+    {
+        string s(str.data(), str.length(), string::COPY);
+        s.append(s, 2, 5);
+        is(s, str + str.substr(2, 5), "append own part, %d chars", len);
+    }
+    {
+        string s(str.data(), str.length(), string::COPY);
+        s += s.c_str();
+        is(s, str + str, "append own c_str, %d chars", len);
+    }
+    {
+        string s(str.data(), str.length(), string::COPY);
+        s.replace(1, 2, s, 3, 7);
+        std::string exp = str;
+        exp.replace(1, 2, str.substr(3, 7));
+        is(s, exp, "replace with own part, %d chars", len);
+    }
+    {
+        string s(str.data(), str.length(), string::COPY);
+        s.replace(0, 0, s, 0, len);
+        is(s, str + str, "insert self, %d chars", len);
+    }
+}
+
+// substrings and narrowing erase are windows into the shared buffer, writes detach them
+static void test_windows () {
+    std::string alpha = "abcdefghijklmnopqrstuvwxyz";
+    string a(alpha.data(), alpha.length(), string::COPY);
+
+    string w = a.substr(5, 16);
+    is(w, alpha.substr(5, 16), "substring");
+    ok(w.data() == a.data() + 5, "substring shares the buffer");
+    string s = a.substr(5, 10);
+    is(s, alpha.substr(5, 10), "small substring");
+    ok(s.data() < a.data() || s.data() >= a.data() + a.length(), "small substring is copied inline");
+
+    string c = a;
+    c.erase(0, 3);
+    ok(c.data() == a.data() + 3, "erase of prefix narrows the window");
+    c.erase(20);
+    ok(c.data() == a.data() + 3, "erase of suffix narrows the window");
+    is(c, alpha.substr(3, 20), "narrowed window");
+    c = a;
+    c.erase(5, 3);
+    is(c, alpha.substr(0, 5) + alpha.substr(8), "erase in the middle");
+    ok(c.data() != a.data(), "erase in the middle detaches");
+    is(a, alpha, "source is intact after erase");
+
+    w[0] = 'X';
+    is(w, "X" + alpha.substr(6, 15), "write to substring");
+    ok(w.data() != a.data() + 5, "write to substring detaches it");
+    w = a.substr(5, 16);
+    w.append("!");
+    is(w, alpha.substr(5, 16) + "!", "append to substring");
+    is(a, alpha, "source is intact after writes to substrings");
+
+    w = a.substr(5, 16);
+    const char* cs = w.c_str();
+    ok(std::strlen(cs) == 16 && std::string(cs) == alpha.substr(5, 16), "c_str of substring");
+    ok(cs != a.data() + 5, "c_str of substring of shared buffer detaches it");
+    is(a, alpha, "source is intact after c_str of substring");
+    ok(std::strlen(a.c_str()) == alpha.length(), "source is terminated after c_str of substring");
+    w = a.substr(10);
+    ok(w.c_str() == a.data() + 10, "c_str of substring at the end of buffer is in place");
+
+    {
+        string t(alpha.data(), alpha.length(), string::COPY);
+        string u = t.substr(5, 16);
+        const char* p = u.data();
+        t = string();
+        ok(u.c_str() == p && std::strlen(p) == 16, "c_str of substring of unique buffer terminates it in place");
+        u.append(20, 'y');
+        is(u, alpha.substr(5, 16) + std::string(20, 'y'), "append to substring of unique buffer");
+    }
+}
+
+// source is in our buffer, but not in our window: another string shares a wider part of the buffer
+static void test_beyond_window () {
+    std::string alpha = "abcdefghijklmnopqrstuvwxyz";
+    string a(alpha.data(), alpha.length(), string::COPY);
+    {
+        string c = a;
+        c.erase(3);
+        c.append(a);
+        is(c, "abc" + alpha, "append wider string sharing the buffer");
+        is(a, alpha, "append wider string sharing the buffer: source is intact");
+    }
+    {
+        string c = a;
+        c.erase(0, 3);
+        c.append(a);
+        is(c, alpha.substr(3) + alpha, "append wider string to a window with offset");
+    }
+    {
+        string c = a.substr(5, 16);
+        c.append(a.data() + 20, 6);
+        is(c, alpha.substr(5, 16) + alpha.substr(20), "append part of the buffer after the window");
+    }
+    {
+        string c = a;
+        c.erase(3);
+        c.replace(1, 1, a);
+        is(c, "a" + alpha + "c", "replace with wider string sharing the buffer");
+        is(a, alpha, "replace with wider string sharing the buffer: source is intact");
+    }
+    {
+        string b = a;
+        b.erase(5);
+        b.assign(a.data(), a.length(), string::COPY);
+        is(b, alpha, "assign copy of wider string sharing the buffer");
+        is(a, alpha, "assign copy of wider string sharing the buffer: source is intact");
+    }
+    {
+        string b = a;
+        b.erase(0, 5);
+        b.assign(a.data(), a.length(), string::COPY);
+        is(b, alpha, "assign copy of wider string to a window with offset");
+    }
+    {
+        string b = a.substr(2, 16);
+        b.assign(a.data() + 10, 16, string::COPY);
+        is(b, alpha.substr(10), "assign copy of overlapping part of the buffer");
+        b = a.substr(2, 16);
+        b.assign(a.data() + 20, 6, string::COPY);
+        is(b, alpha.substr(20), "assign small copy of the buffer after the window");
+    }
+    {
+        char* ext = (char*)std::malloc(alpha.length());
+        std::memcpy(ext, alpha.data(), alpha.length());
+        string b(ext, alpha.length(), poison_free, (void*)alpha.length());
+        b.erase(5); // the only owner of external memory, which is released by detach
+        b.assign(ext, alpha.length(), string::COPY);
+        is(b, alpha, "assign copy of external memory wider than the window");
+    }
+}
+
+// copying own part of a string over external memory, which is released by detach
+static void test_assign_external (const std::string& str, size_t pos, size_t len, const char* what) {
+    char* ext = (char*)std::malloc(str.length() + 1);
+    std::memcpy(ext, str.data(), str.length());
+    string s(ext, str.length(), poison_free, (void*)str.length());
+    s.assign(s, pos, len);
+    is(s, str.substr(pos, len), "assign %s, %d chars", what, (int)str.length());
+}
+
+// copies of string_builder don't write into the source's chunks
+static void test_builder_copy (const std::string& init, bool assign) {
+    panda::string_builder a;
+    a.append(init.data(), init.length());
+    panda::string_builder b;
+    if (assign) b = a;
+    panda::string_builder c(a);
+    if (assign) c = b;
+    c.append("world", 5);
+    b.append("world", 5);
+    const char* what = assign ? "assign" : "copy";
+    int len = init.length();
+    is(a.str(), init, "builder %s, %d chars: source", what, len);
+    is(b.str(), assign ? init + "world" : std::string("world"), "builder %s, %d chars: other", what, len);
+    is(c.str(), init + "world", "builder %s, %d chars: copy", what, len);
+    ok(c.str().length() == c.length(), "builder %s, %d chars: length", what, len);
+}
+
+int main () {
+    for (const char* const* p = SAMPLES; *p; ++p) test_self(*p);
+    test_self(std::string(100, 'x'));
+
+    test_windows();
+    test_beyond_window();
+
+    std::string alpha = "abcdefghijklmnopqrstuvwxyz";
+    test_assign_external(alpha, 1, 10, "own small part");
+    test_assign_external(alpha, 3, 20, "own part");
+    test_assign_external(std::string(100, 'x'), 1, 10, "own small part");
+    test_assign_external(std::string(100, 'x'), 3, 20, "own part");
+
+    test_builder_copy("hello ", false);
+    test_builder_copy("hello ", true);
+    test_builder_copy(std::string(300, 'y'), false);
+    test_builder_copy(std::string(300, 'y'), true);
+
+    return test::done_testing();
+}
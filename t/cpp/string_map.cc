@@ -0,0 +1,158 @@
+// panda::string_map and string_set: insert, find, erase with backward shift, rehash at load factor 0.8
+#include "test.h"
+#include <map>
+#include <vector>
+#include <cstdlib>
+#include <panda/string_map.h>
+
+using panda::string;
+using panda::string_map;
+using panda::string_set;
+using test::ok;
+using test::is_num;
+
+typedef string_map<int> map_t;
+
+static string key (int i) {
+    string ret("key");
+    ret.append_int(i);
+    return ret;
+}
+
+// all keys of model are found with their values, and nothing else
+static bool matches (const map_t& m, const std::map<int, int>& model, int max_key) {
+    if (m.size() != model.size()) return false;
+    size_t iterated = 0;
+    for (map_t::const_iterator it = m.begin(); it != m.end(); ++it) ++iterated;
+    if (iterated != model.size()) return false;
+    for (int i = 0; i < max_key; ++i) {
+        std::map<int, int>::const_iterator exp = model.find(i);
+        map_t::const_iterator it = m.find(key(i));
+        if (exp == model.end() ? it != m.end() : (it == m.end() || it->second != exp->second)) return false;
+    }
+    return true;
+}
+
+static void test_basic () {
+    map_t m;
+    ok(m.empty() && m.begin() == m.end(), "empty map");
+    ok(m.find("nokey") == m.end() && !m.erase("nokey"), "find and erase in empty map");
+
+    ok(m.insert(std::make_pair(string("a"), 1)).second, "insert");
+    ok(!m.insert(std::make_pair(string("a"), 2)).second, "insert of existing key");
+    is_num(m.find("a")->second, 1, "existing value is kept");
+    m["b"] = 2;
+    ++m["b"];
+    is_num(m["b"], 3, "operator[]");
+    is_num(m.size(), 2, "size");
+
+    const char* buf = "a and b";
+    ok(m.find(string(buf, 1)) != m.end(), "find by string in REF mode");
+    ok(m.count(string(buf + 6, 1)) == 1, "count");
+
+    map_t copy(m);
+    is_num(m.erase("a"), 1, "erase");
+    ok(m.find("a") == m.end() && copy.find("a") != copy.end(), "copy is independent");
+
+    string_set s;
+    s.insert("x");
+    s.insert(string("x"));
+    is_num(s.size(), 1, "set has unique keys");
+    panda::atomic_string_set as;
+    as.insert("y");
+    ok(as.count("y") && !as.count("x"), "atomic_string_set");
+}
+
+static void test_rehash () {
+    map_t m;
+    for (int i = 0; i < 6; ++i) m[key(i)] = i;
+    is_num(m.capacity(), map_t::MIN_CAPACITY, "6 keys fit into 8 slots");
+    m[key(6)] = 6;
+    is_num(m.capacity(), 16, "7th key exceeds load factor 0.8: table is doubled");
+    std::map<int, int> model;
+    for (int i = 0; i < 7; ++i) model[i] = i;
+    ok(matches(m, model, 10), "all keys are found after rehash");
+
+    for (int i = 7; i < 1000; ++i) {
+        m[key(i)] = i;
+        model[i] = i;
+        if (m.size() * 5 > m.capacity() * 4) break;
+    }
+    ok(m.size() * 5 <= m.capacity() * 4, "load factor stays <= 0.8");
+    ok(matches(m, model, 1000), "1000 keys");
+
+    map_t r;
+    r.reserve(100);
+    size_t cap = r.capacity();
+    ok(cap * 4 >= 100 * 5, "reserve");
+    for (int i = 0; i < 100; ++i) r[key(i)] = i;
+    is_num(r.capacity(), cap, "no rehash up to reserved size");
+}
+
+// keys with home slots at the end of 16 slots table: their probe chains wrap around to the beginning
+static void test_wrapped_chain () {
+    const size_t cap = 16;
+    const size_t homes[] = {cap - 2, cap - 1, cap - 1, cap - 1, 0}; // slots 14, 15, 0, 1, 2
+    const int cnt = sizeof(homes) / sizeof(homes[0]);
+    int  keys[cnt];
+    bool found[cnt] = {false};
+    int  max_key = 0;
+    for (int left = cnt; left; ++max_key) {
+        size_t home = key(max_key).hash() & (cap - 1);
+        for (int n = 0; n < cnt; ++n) if (!found[n] && homes[n] == home) {
+            keys[n] = max_key;
+            found[n] = true;
+            --left;
+            break;
+        }
+    }
+
+    for (int n = 0; n < cnt; ++n) { // erase each key of the chain
+        map_t m(10);
+        if (m.capacity() != cap) {
+            ok(false, "table of %d slots", (int)cap);
+            return;
+        }
+        std::map<int, int> model;
+        for (int i = 0; i < cnt; ++i) {
+            m[key(keys[i])] = i;
+            model[keys[i]] = i;
+        }
+        is_num(m.erase(key(keys[n])), 1, "erase %d of wrapped chain", n);
+        model.erase(keys[n]);
+        ok(matches(m, model, max_key), "wrapped chain after erase %d", n);
+        for (std::map<int, int>::iterator it = model.begin(); it != model.end(); ++it) m.erase(key(it->first));
+        ok(m.empty() && m.begin() == m.end(), "wrapped chain erased completely after %d", n);
+    }
+}
+
+// random inserts and erases on a small key space, checked against std::map
+static void test_random () {
+    map_t m;
+    std::map<int, int> model;
+    unsigned seed = 1;
+    bool ok_all = true;
+    for (int i = 0; i < 20000 && ok_all; ++i) {
+        seed = seed * 1103515245 + 12345;
+        int k = (seed >> 8) % 200;
+        if ((seed >> 20) % 3) {
+            m[key(k)] = i;
+            model[k] = i;
+        }
+        else {
+            if (m.erase(key(k)) != model.erase(k)) ok_all = false;
+        }
+        if (i % 100 == 0 && !matches(m, model, 200)) ok_all = false;
+    }
+    ok(ok_all && matches(m, model, 200), "random inserts and erases");
+    m.clear();
+    ok(m.empty() && m.begin() == m.end() && m.find(key(1)) == m.end(), "clear");
+}
+
+int main () {
+    test_basic();
+    test_rehash();
+    test_wrapped_chain();
+    test_random();
+    return test::done_testing();
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <string>
+#include <cstdio>
+#include <cstdarg>
+#include <cstring>
+
+// Minimal TAP producer for C++ tests in t/cpp. Binaries are built by 'make test' and run by t/*.t with the same name.
+// Every check prints "ok N - name" or "not ok N - name", done_testing() prints the plan and returns exit status.
+
+namespace test {
+
+struct state_t {
+    int count;
+    int failed;
+};
+
+inline state_t& state () {
+    static state_t s = {0, 0};
+    return s;
+}
+
+inline bool vok (bool cond, const char* fmt, va_list args) {
+    state_t& s = state();
+    if (!cond) ++s.failed;
+    std::printf("%sok %d - ", cond ? "" : "not ", ++s.count);
+    std::vprintf(fmt, args);
+    std::printf("\n");
+    std::fflush(stdout);
+    return cond;
+}
+
+inline bool ok (bool cond, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+inline bool ok (bool cond, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    bool ret = vok(cond, fmt, args);
+    va_end(args);
+    return ret;
+}
+
+// compares string content (any class with data() and length()) with <expected>, shows both on failure
+template <class S>
+inline bool is (const S& got, const std::string& expected, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+template <class S>
+inline bool is (const S& got, const std::string& expected, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    bool ret = vok(got.length() == expected.length() && std::memcmp(got.data(), expected.data(), got.length()) == 0, fmt, args);
+    va_end(args);
+    if (!ret) {
+        std::printf("#      got: '%.*s'\n", (int)got.length(), got.data());
+        std::printf("# expected: '%s'\n", expected.c_str());
+    }
+    return ret;
+}
+
+inline bool is_num (long got, long expected, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+inline bool is_num (long got, long expected, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    bool ret = vok(got == expected, fmt, args);
+    va_end(args);
+    if (!ret) std::printf("#      got: %ld\n# expected: %ld\n", got, expected);
+    return ret;
+}
+
+inline void diag (const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+inline void diag (const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    std::printf("# ");
+    std::vprintf(fmt, args);
+    std::printf("\n");
+    va_end(args);
+}
+
+inline int done_testing () {
+    state_t& s = state();
+    std::printf("1..%d\n", s.count);
+    return s.failed > 254 ? 254 : s.failed;
+}
+
+}